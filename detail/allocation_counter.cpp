@@ -0,0 +1,43 @@
+// Replaces global operator new to count allocations. See allocation_counter.hpp.
+
+#include "allocation_counter.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(_MSC_VER) && _MSC_VER<1900
+# define BOOST_AFIO_ALLOCATION_COUNTER_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+# define BOOST_AFIO_ALLOCATION_COUNTER_THREAD_LOCAL __thread
+#else
+# define BOOST_AFIO_ALLOCATION_COUNTER_THREAD_LOCAL thread_local
+#endif
+
+static std::atomic<std::size_t> allocations(0);
+static BOOST_AFIO_ALLOCATION_COUNTER_THREAD_LOCAL std::size_t thisthreadallocations, thisthreadthreshold;
+
+std::size_t total_allocations() noexcept { return allocations.load(std::memory_order_relaxed); }
+std::size_t &thread_allocations() noexcept { return thisthreadallocations; }
+std::size_t &allocation_threshold() noexcept { return thisthreadthreshold; }
+
+void *operator new(std::size_t bytes)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if(bytes>=thisthreadthreshold)
+        ++thisthreadallocations;
+    if(void *ret=std::malloc(bytes ? bytes : 1))
+        return ret;
+    throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+void *operator new[](std::size_t bytes)
+{
+    return operator new(bytes);
+}
+void operator delete[](void *p) noexcept
+{
+    operator delete(p);
+}
@@ -0,0 +1,17 @@
+/* Counts the allocations made through global operator new, so tests and benchmarks can check
+that something does not allocate or report how much it does. The counting is done by replacing
+operator new in allocation_counter.cpp, which must be compiled and linked into the program once.
+*/
+#ifndef BOOST_AFIO_ALLOCATION_COUNTER_HPP
+#define BOOST_AFIO_ALLOCATION_COUNTER_HPP
+
+#include <cstddef>
+
+// The allocations made by every thread since the program began
+std::size_t total_allocations() noexcept;
+// The allocations made by this thread of at least allocation_threshold() bytes
+std::size_t &thread_allocations() noexcept;
+// Allocations by this thread smaller than this are not counted, which lets a test pick out the allocations of big things
+std::size_t &allocation_threshold() noexcept;
+
+#endif
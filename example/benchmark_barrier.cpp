@@ -0,0 +1,58 @@
+#include "afio_pch.hpp"
+
+/* Measures how long a barrier takes to release all its outputs once its last input completes,
+as the barrier grows wider. Every input records when it ran and every output records when it
+was released, so the latency is from the last input running to the last output released.
+That is dominated by the last arrival completing every participant, so should grow no worse
+than linearly with width.
+*/
+
+#define ITERATIONS 100
+
+int main(void)
+{
+    using namespace boost::afio;
+    typedef chrono::duration<double, ratio<1, 1>> secs_type;
+    typedef chrono::high_resolution_clock clock_type;
+    auto dispatcher=make_dispatcher().get();
+    auto latest=[](atomic<clock_type::rep> &v){
+        auto now=clock_type::now().time_since_epoch().count();
+        auto old=v.load(memory_order_relaxed);
+        while(old<now && !v.compare_exchange_weak(old, now, memory_order_relaxed));
+    };
+    std::ofstream csv("afio_barrier.csv");
+    csv << "Width,Average latency,Minimum latency,Latency per op" << std::endl;
+    for(size_t width : { 8, 64, 512, 1024, 4096, 10000 })
+    {
+        double total=0, lowest=1<<30;
+        for(size_t n=0; n<ITERATIONS; n++)
+        {
+            atomic<clock_type::rep> lastinput(0), lastoutput(0);
+            // Hold every input back until the barrier is in place
+            atomic<bool> go(false);
+            auto gate=dispatcher->call(future<>(), [&go]{ while(!go) this_thread::yield(); });
+            std::vector<future<>> inputs;
+            inputs.reserve(width);
+            for(size_t i=0; i<width; i++)
+                inputs.push_back(dispatcher->call(gate, [&]{ latest(lastinput); }));
+            auto outputs=dispatcher->barrier(inputs);
+            // Immediate completions run as each output is released rather than later on a pool thread
+            std::vector<std::pair<async_op_flags, std::function<dispatcher::completion_t>>> onrelease(width, std::make_pair(async_op_flags::immediate,
+                std::function<dispatcher::completion_t>([&](size_t, future<> op) -> std::pair<bool, handle_ptr> {
+                    latest(lastoutput);
+                    return std::make_pair(true, op.get_handle(true));
+                })));
+            auto released=dispatcher->completion(outputs, onrelease);
+            go=true;
+            when_all_p(released).wait();
+            double latency=chrono::duration_cast<secs_type>(clock_type::duration(lastoutput-lastinput)).count();
+            total+=latency;
+            if(latency<lowest) lowest=latency;
+        }
+        total/=ITERATIONS;
+        std::cout << "Barrier of width " << width << " releases in " << total*1000000 << " us on average ("
+            << lowest*1000000 << " us at best), " << total*1000000000/width << " ns per op" << std::endl;
+        csv << width << "," << total << "," << lowest << "," << total/width << std::endl;
+    }
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "afio_pch.hpp"
+#include "../detail/allocation_counter.hpp"
 
 /*  My Intel Core i7 3770K running Windows 8 x64: 726124 closures/sec
     My Intel Core i7 3770K running     Linux x64: 968005 closures/sec
@@ -27,6 +28,7 @@ int main(void)
     std::cout << "Attach profiler now and hit Return" << std::endl;
     getchar();
 #endif
+    size_t allocations=total_allocations();
     begin=chrono::high_resolution_clock::now();
 #pragma omp parallel
     {
@@ -41,7 +43,9 @@ int main(void)
         this_thread::sleep_for(chrono::milliseconds(1));
     auto end=chrono::high_resolution_clock::now();
     auto diff=chrono::duration_cast<secs_type>(end-begin);
+    allocations=total_allocations()-allocations;
     std::cout << "It took " << diff.count() << " secs to execute " << (500000*threads) << " closures which is " << (500000*threads/diff.count()) << " chained closures/sec" << std::endl;
+    std::cout << "That needed " << allocations << " memory allocations which is " << ((double) allocations/(500000*threads)) << " mallocs per closure" << std::endl;
     std::cout << "\nPress Return to exit ..." << std::endl;
     getchar();
     return 0;
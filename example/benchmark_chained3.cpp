@@ -0,0 +1,50 @@
+#include "afio_pch.hpp"
+#include "../detail/allocation_counter.hpp"
+
+/* As benchmark_chained1, but with lambda continuations capturing state, first type erased
+into std::function<completion_t> and then handed to the templated completion() which
+stores them within the op itself.
+*/
+
+int main(void)
+{
+    using namespace boost::afio;
+    auto dispatcher=make_dispatcher().get();
+    typedef chrono::duration<double, ratio<1, 1>> secs_type;
+    auto begin=chrono::high_resolution_clock::now();
+    while(chrono::duration_cast<secs_type>(chrono::high_resolution_clock::now()-begin).count()<3);
+
+    atomic<size_t> count(0);
+    size_t increment=1, times=1;
+    // Captures too big for std::function's small object optimisation on most STLs
+    auto callback=[&count, increment, times](size_t, future<> op) -> std::pair<bool, handle_ptr> {
+        count.fetch_add(increment*times, memory_order_relaxed);
+        return std::make_pair(true, op.get_handle(true));
+    };
+    for(int typed=0; typed<2; typed++)
+    {
+        atomic<size_t> threads(0);
+        size_t allocations=total_allocations();
+        begin=chrono::high_resolution_clock::now();
+#pragma omp parallel
+        {
+            future<> last;
+            threads++;
+            for(size_t n=0; n<500000; n++)
+            {
+                if(typed)
+                    last=dispatcher->completion(last, callback);
+                else
+                    last=dispatcher->completion(last, std::make_pair(async_op_flags::none, std::function<dispatcher::completion_t>(callback)));
+            }
+        }
+        while(dispatcher->wait_queue_depth())
+            this_thread::sleep_for(chrono::milliseconds(1));
+        auto end=chrono::high_resolution_clock::now();
+        auto diff=chrono::duration_cast<secs_type>(end-begin);
+        allocations=total_allocations()-allocations;
+        std::cout << (typed ? "Templated completion(): " : "std::function completion(): ") << (500000*threads/diff.count()) << " chained closures/sec, "
+            << ((double) allocations/(500000*threads)) << " mallocs per closure" << std::endl;
+    }
+    return 0;
+}
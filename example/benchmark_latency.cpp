@@ -3,6 +3,8 @@
 
 #define ITERATIONS 10000
 #define CONCURRENCY 32
+#define CHAIN_LENGTH 64
+#define INLINE_CONTINUATION_DEPTH 8
 
 // Optional
 //#define MULTIPLIER 1000000 // output number of microseconds instead of seconds
@@ -75,7 +77,7 @@ int main(void)
     * MULTIPLIER
 #endif
     << std::endl << std::endl;
-  csv << "Concurrency,Handler Min,Handler Max,Handler Average,Handler Stddev,Complete Min,Complete Max,Complete Average,Complete Stddev" << std::endl;
+  csv << "Concurrency,Handler Min,Handler Max,Handler Average,Handler Stddev,Complete Min,Complete Max,Complete Average,Complete Stddev,Engine Queued p50,Engine Queued p99,Engine Queued p999,Engine Total p50,Engine Total p99,Engine Total p999" << std::endl;
   for(size_t concurrency=0; concurrency<CONCURRENCY; concurrency++)
   {
     future<> last[CONCURRENCY];
@@ -86,6 +88,7 @@ int main(void)
     threads.reserve(CONCURRENCY);
     size_t iterations=(concurrency>=8) ? ITERATIONS/10 : ITERATIONS;
     std::cout << "Running " << iterations << " iterations of concurrency " << concurrency+1 << " ..." << std::endl;
+    auto statsbefore=dispatcher->stats();
     for(size_t n=0; n<iterations; n++)
     {
       threads.clear();
@@ -155,8 +158,69 @@ int main(void)
     totalComplete*=MULTIPLIER;
     varianceComplete*=MULTIPLIER;    
 #endif
+    // The engine's own view of the same ops, as percentiles from its latency histograms
+    auto stats=dispatcher->stats()-statsbefore;
+    const op_latencies &engine=stats[detail::OpType::UserCompletion];
+    auto scaled=[](chrono::nanoseconds v){
+      return chrono::duration_cast<secs_type>(v).count()
+#ifdef MULTIPLIER
+        * MULTIPLIER
+#endif
+      ;
+    };
+    std::cout << "  engine p50/p99/p999 total latency " << scaled(engine.total.percentile(50)) << "/" << scaled(engine.total.percentile(99)) << "/" << scaled(engine.total.percentile(99.9)) << std::endl;
     csv << concurrency+1 << "," << minHandler << "," << maxHandler << "," << totalHandler << "," << varianceHandler << ","
-        << minComplete << "," << maxComplete << "," << totalComplete << "," << varianceComplete << std::endl;
+        << minComplete << "," << maxComplete << "," << totalComplete << "," << varianceComplete << ","
+        << scaled(engine.queued.percentile(50)) << "," << scaled(engine.queued.percentile(99)) << "," << scaled(engine.queued.percentile(99.9)) << ","
+        << scaled(engine.total.percentile(50)) << "," << scaled(engine.total.percentile(99)) << "," << scaled(engine.total.percentile(99.9)) << std::endl;
+  }
+
+  // Per hop latency along chains of ops, with continuations always enqueued versus run inline by the completing thread
+  csv << std::endl << "Inline continuation depth,Hop Min,Hop Max,Hop Average,Hop Stddev" << std::endl;
+  for(size_t depth : { (size_t) 0, (size_t) INLINE_CONTINUATION_DEPTH })
+  {
+    dispatcher->inline_continuation_depth(depth);
+    size_t iterations=ITERATIONS/CHAIN_LENGTH;
+    std::vector<double> hops;
+    hops.reserve(iterations*(CHAIN_LENGTH-1));
+    std::cout << "Running " << iterations << " chains of length " << CHAIN_LENGTH << " with inline continuation depth " << depth << " ..." << std::endl;
+    for(size_t n=0; n<iterations; n++)
+    {
+      // Hold the head of the chain until the whole chain is scheduled so every hop goes through completion
+      atomic<bool> go(false);
+      future<> last=dispatcher->call(future<>(), [&go]{ while(!go) this_thread::yield(); });
+      size_t first=0;
+      for(size_t i=0; i<CHAIN_LENGTH; i++)
+      {
+        last=dispatcher->completion(last, callback);
+        if(!i) first=last.id();
+      }
+      go=true;
+      last.get();
+      for(size_t i=1; i<CHAIN_LENGTH; i++)
+        hops.push_back(chrono::duration_cast<secs_type>(points[first+i-id_offset]-points[first+i-1-id_offset]-overhead).count());
+      id_offset=last.id();
+    }
+    double minHop=1<<30, maxHop=0, totalHop=0, varianceHop=0;
+    for(auto &i : hops)
+    {
+      if(i<minHop) minHop=i;
+      if(i>maxHop) maxHop=i;
+      totalHop+=i;
+    }
+    totalHop/=hops.size();
+    for(auto &i : hops)
+      varianceHop+=pow(i-totalHop, 2);
+    varianceHop/=hops.size();
+    varianceHop=sqrt(varianceHop);
+#ifdef MULTIPLIER
+    minHop*=MULTIPLIER;
+    maxHop*=MULTIPLIER;
+    totalHop*=MULTIPLIER;
+    varianceHop*=MULTIPLIER;
+#endif
+    std::cout << "  average hop latency " << totalHop << std::endl;
+    csv << depth << "," << minHop << "," << maxHop << "," << totalHop << "," << varianceHop << std::endl;
   }
   return 0;
 }
@@ -0,0 +1,84 @@
+#include "afio_pch.hpp"
+#include <random>
+
+/* Measures the penalty for random i/o whose buffers live on a different NUMA node to the
+workers doing it. The buffers are allocated and first touched from the first node, so the OS
+places them there. The same evil_random_io style mix of random reads and writes of random
+lengths at random offsets is then issued from a thread pinned to each node in turn, and with
+thread_placement::numa_node the workers of the node the ops are issued from do the i/o and a
+pass over the data. Issued from the first node everything stays local, issued from any other
+every byte copied crosses the interconnect. The pool without placement is run for comparison.
+On a machine with a single NUMA node every row should perform the same.
+*/
+
+#define FILE_SIZE (256*1024*1024)
+#define MAX_OP_BYTES (256*1024)
+#define IN_FLIGHT 64
+#define OPS 32768
+#define WORKERS_PER_NODE 4
+
+int main(void)
+{
+    using namespace boost::afio;
+    typedef chrono::duration<double, ratio<1, 1>> secs_type;
+    auto topology=detail::numa_nodes();
+    std::cout << "This machine has " << topology.size() << " NUMA nodes" << std::endl;
+
+    // Each op in flight gets its own slot of the buffer, allocated and first touched on the first node
+    detail::pin_this_thread(topology.front());
+    std::vector<char> buffer(IN_FLIGHT*MAX_OP_BYTES, 78);
+
+    std::ofstream csv("afio_numa_placement.csv");
+    csv << "Placement,Issuing node,Ops/sec,MB/sec" << std::endl;
+    for(auto placement : { thread_placement::none, thread_placement::numa_node })
+    {
+        auto pool=(thread_placement::none==placement)
+            ? std::make_shared<std_thread_pool>(WORKERS_PER_NODE*topology.size())
+            : std::make_shared<std_thread_pool>(WORKERS_PER_NODE, placement);
+        auto dispatcher=make_dispatcher("file:///", file_flags::none, file_flags::none, pool).get();
+        auto mkdir(dispatcher->dir(path_req("testdir", file_flags::create)));
+        auto mkfile(dispatcher->file(dispatcher->depends(mkdir, path_req("testdir/numa", file_flags::create|file_flags::read_write))));
+        auto sized(dispatcher->truncate(mkfile, FILE_SIZE));
+        sized.get();
+        for(size_t node=0; node<topology.size(); node++)
+        {
+            detail::pin_this_thread(topology[node]);
+            // The same sequence of ops every time
+            std::mt19937 gen(78);
+            atomic<size_t> checksum(0);
+            size_t transferred=0;
+            auto begin=chrono::high_resolution_clock::now();
+            for(size_t n=0; n<OPS; n+=IN_FLIGHT)
+            {
+                std::vector<future<>> ops;
+                ops.reserve(IN_FLIGHT);
+                for(size_t i=0; i<IN_FLIGHT; i++)
+                {
+                    size_t bytes=(gen()%(MAX_OP_BYTES/4096)+1)*4096;
+                    off_t where=(off_t)(gen()%((FILE_SIZE-bytes)/4096))*4096;
+                    char *b=buffer.data()+i*MAX_OP_BYTES;
+                    future<> op=(gen()&1) ? dispatcher->write(make_io_req(sized, b, bytes, where)) : dispatcher->read(make_io_req(sized, b, bytes, where));
+                    ops.push_back(dispatcher->call(op, [b, bytes, &checksum]{
+                        size_t sum=0;
+                        for(size_t o=0; o<bytes; o+=64)
+                            sum+=(unsigned char) b[o];
+                        checksum+=sum;
+                    }));
+                    transferred+=bytes;
+                }
+                when_all_p(ops).wait();
+            }
+            auto end=chrono::high_resolution_clock::now();
+            auto diff=chrono::duration_cast<secs_type>(end-begin);
+            const char *name=(thread_placement::none==placement) ? "none" : "numa_node";
+            std::cout << "Placement " << name << " issuing from node " << node << " did " << OPS/diff.count() << " ops/sec, "
+                << transferred/diff.count()/1024/1024 << " MB/sec (checksum " << checksum << ")" << std::endl;
+            csv << name << "," << node << "," << OPS/diff.count() << "," << transferred/diff.count()/1024/1024 << std::endl;
+        }
+        auto closed(dispatcher->close(sized));
+        auto rmfile(dispatcher->rmfile(dispatcher->depends(closed, path_req("testdir/numa"))));
+        auto rmdir(dispatcher->rmdir(dispatcher->depends(rmfile, path_req("testdir"))));
+        rmdir.get();
+    }
+    return 0;
+}
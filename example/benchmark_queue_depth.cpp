@@ -0,0 +1,79 @@
+#include "afio_pch.hpp"
+#include <random>
+
+/* Measures random 4Kb os_direct reads kept at queue depths of 128 and more by pools of just two
+and four threads, which is what NVMe devices need to reach their rated IOPS. Each queue slot is a
+chain of reads, each scheduled upon the completion of the one before, so exactly the queue depth
+of reads are outstanding until the very end. The io_uring dispatcher queues them to the ring, and
+the compat dispatcher to Linux native AIO, so neither is bounded by the number of threads. Reads of
+a file never written are satisfied without touching the device, so the file is written out first.
+Run it upon the device to be measured.
+*/
+
+#define FILE_SIZE (1024*1024*1024)
+#define BLOCK_SIZE 4096
+#define READS 262144
+
+int main(void)
+{
+    using namespace boost::afio;
+    typedef chrono::duration<double, ratio<1, 1>> secs_type;
+    std::ofstream csv("afio_queue_depth.csv");
+    csv << "Dispatcher,Threads,Queue depth,IOPS,p50 latency us,p99 latency us,Via kernel queue" << std::endl;
+    for(const char *uri : { "file:///", "file:///?compat" })
+    {
+        for(size_t threads : { 2, 4 })
+        {
+            for(size_t qd : { 128, 256 })
+            {
+                auto pool=std::make_shared<std_thread_pool>(threads);
+                auto made=make_dispatcher(uri, file_flags::os_direct, file_flags::none, pool);
+                if(made.has_error())
+                {
+                    std::cout << uri << " is not available here" << std::endl;
+                    break;
+                }
+                auto dispatcher=made.get();
+                auto mkdir(dispatcher->dir(path_req("testdir", file_flags::create)));
+                auto mkfile(dispatcher->file(dispatcher->depends(mkdir, path_req("testdir/qd", file_flags::create|file_flags::read_write))));
+                auto sized(dispatcher->truncate(mkfile, FILE_SIZE));
+                std::vector<char, detail::aligned_allocator<char, 4096>> buffer(qd*BLOCK_SIZE, 78), fill(1024*1024, 78);
+                {
+                    std::vector<future<>> writes;
+                    for(off_t where=0; where<FILE_SIZE; where+=fill.size())
+                        writes.push_back(dispatcher->write(make_io_req(sized, fill.data(), fill.size(), where)));
+                    sized=dispatcher->sync(dispatcher->barrier(writes).front());
+                    sized.get();
+                }
+                // The same offsets every time
+                std::mt19937 gen(78);
+                std::vector<future<>> slots(qd, sized);
+                auto before=dispatcher->kernel_queue_ops();
+                dispatcher->reset_stats();
+                auto begin=chrono::high_resolution_clock::now();
+                for(size_t n=0; n<READS; n++)
+                {
+                    size_t slot=n%qd;
+                    off_t where=(off_t)(gen()%(FILE_SIZE/BLOCK_SIZE))*BLOCK_SIZE;
+                    slots[slot]=dispatcher->read(make_io_req(slots[slot], buffer.data()+slot*BLOCK_SIZE, BLOCK_SIZE, where));
+                }
+                when_all_p(slots).wait();
+                auto end=chrono::high_resolution_clock::now();
+                auto diff=chrono::duration_cast<secs_type>(end-begin);
+                auto latencies=dispatcher->stats()[detail::OpType::read].total;
+                auto us=[](chrono::nanoseconds ns){ return ns.count()/1000.0; };
+                size_t viakernel=dispatcher->kernel_queue_ops()-before;
+                std::cout << uri << " with " << threads << " threads at queue depth " << qd << " did " << READS/diff.count() << " reads/sec, p50 "
+                    << us(latencies.percentile(50)) << "us, p99 " << us(latencies.percentile(99)) << "us, " << viakernel << " of " << READS << " via the kernel queue" << std::endl;
+                csv << uri << "," << threads << "," << qd << "," << READS/diff.count() << "," << us(latencies.percentile(50)) << "," << us(latencies.percentile(99)) << "," << viakernel << std::endl;
+                auto closed(dispatcher->close(sized));
+                auto rmfile(dispatcher->rmfile(dispatcher->depends(closed, path_req("testdir/qd"))));
+                auto rmdir(dispatcher->rmdir(dispatcher->depends(rmfile, path_req("testdir"))));
+                rmdir.get();
+                dispatcher.reset();
+                pool->destroy();
+            }
+        }
+    }
+    return 0;
+}
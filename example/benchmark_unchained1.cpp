@@ -1,4 +1,5 @@
 #include "afio_pch.hpp"
+#include "../detail/allocation_counter.hpp"
 
 /*  My Intel Core i7 3770K running Windows 8 x64:  1555990 closures/sec
     My Intel Core i7 3770K running     Linux x64:  1432810 closures/sec
@@ -28,6 +29,7 @@ int main(void)
     std::cout << "Attach profiler now and hit Return" << std::endl;
     getchar();
 #endif
+    size_t allocations=total_allocations();
     begin=chrono::high_resolution_clock::now();
 #pragma omp parallel for
     for(int n=0; n<5000000; n++)
@@ -36,7 +38,9 @@ int main(void)
         this_thread::sleep_for(chrono::milliseconds(1));
     auto end=chrono::high_resolution_clock::now();
     auto diff=chrono::duration_cast<secs_type>(end-begin);
+    allocations=total_allocations()-allocations;
     std::cout << "It took " << diff.count() << " secs to execute 5,000,000 closures which is " << (5000000/diff.count()) << " unchained closures/sec" << std::endl;
+    std::cout << "That needed " << allocations << " memory allocations which is " << ((double) allocations/5000000) << " mallocs per closure" << std::endl;
     std::cout << "\nPress Return to exit ..." << std::endl;
     getchar();
     return 0;
@@ -0,0 +1,58 @@
+#include "afio_pch.hpp"
+#include <thread>
+
+/* Measures how unchained closure throughput scales with the number of threads
+concurrently submitting to the same dispatcher. Before the op table was sharded
+every submission serialised on a single spinlock, so throughput flatlined (or
+worse, fell) as submitters were added.
+*/
+
+#define CLOSURES_PER_SUBMITTER 200000
+#define MAX_SUBMITTERS 64
+
+static std::pair<bool, std::shared_ptr<boost::afio::handle>> callback(size_t, boost::afio::future<> op)
+{
+    return std::make_pair(true, op.get_handle());
+};
+
+int main(void)
+{
+    using namespace boost::afio;
+    auto dispatcher=make_dispatcher().get();
+    typedef chrono::duration<double, ratio<1, 1>> secs_type;
+    auto begin=chrono::high_resolution_clock::now();
+    while(chrono::duration_cast<secs_type>(chrono::high_resolution_clock::now()-begin).count()<3);
+
+    std::vector<future<>> preconditions;
+    std::vector<std::pair<async_op_flags, dispatcher::completion_t *>> callbacks(1,
+        std::make_pair(async_op_flags::none, callback));
+    std::ofstream csv("afio_unchained_scaling.csv");
+    csv << "Submitters,Closures/sec" << std::endl;
+    for(size_t submitters=1; submitters<=MAX_SUBMITTERS; submitters*=2)
+    {
+        atomic<bool> go(false);
+        std::vector<std::thread> threads;
+        threads.reserve(submitters);
+        for(size_t n=0; n<submitters; n++)
+        {
+            threads.push_back(std::thread([&]{
+                while(!go)
+                    this_thread::yield();
+                for(size_t i=0; i<CLOSURES_PER_SUBMITTER; i++)
+                    dispatcher->completion(preconditions, callbacks);
+            }));
+        }
+        begin=chrono::high_resolution_clock::now();
+        go=true;
+        for(auto &i: threads)
+            i.join();
+        while(dispatcher->wait_queue_depth())
+            this_thread::sleep_for(chrono::milliseconds(1));
+        auto end=chrono::high_resolution_clock::now();
+        auto diff=chrono::duration_cast<secs_type>(end-begin);
+        double rate=(submitters*CLOSURES_PER_SUBMITTER)/diff.count();
+        std::cout << submitters << " submitters executed " << (submitters*CLOSURES_PER_SUBMITTER) << " closures in " << diff.count() << " secs which is " << rate << " unchained closures/sec" << std::endl;
+        csv << submitters << "," << rate << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include "afio_pch.hpp"
+#include <regex>
+#include <future>
+#include "boost/exception/diagnostic_information.hpp"
+
+/* The same search as find_in_files_afio.cpp, except written as straight line C++ 20 coroutines
+instead of a web of completion callbacks. Each directory and each file gets its own coroutine, so
+there are as many concurrent tasks as there are files, yet no thread ever blocks waiting for i/o:
+every co_await chains a completion onto the op, and the coroutine resumes upon whichever pool
+thread completes it.
+*/
+
+#if BOOST_AFIO_HAVE_COROUTINES
+//[find_in_files_coroutines
+using namespace boost::afio;
+
+static std::regex regexpr; // The precompiled regular expression
+static atomic<size_t> bytesread(0), filesread(0), filesmatched(0), outstanding(0);
+static std::promise<void> finished;
+
+// A minimal fire and forget coroutine type which counts how many are outstanding
+struct task
+{
+    struct promise_type
+    {
+        task get_return_object() { return task(); }
+        std::suspend_never initial_suspend() noexcept { ++outstanding; return {}; }
+        std::suspend_never final_suspend() noexcept
+        {
+            // Child tasks start before their parent can finish, so this can only reach zero once
+            if(!--outstanding)
+                finished.set_value();
+            return {};
+        }
+        void return_void() { }
+        void unhandled_exception()
+        {
+            std::cerr << boost::current_exception_diagnostic_information(true) << std::endl;
+        }
+    };
+};
+
+task search_file(dispatcher *dispatcher, future<> dir, path leaf, size_t length)
+{
+    auto file=dispatcher->file(path_req::relative(dir, std::move(leaf), file_flags::read));
+    std::vector<char> buffer(length+1);
+    co_await dispatcher->read(make_io_req(file, buffer.data(), length, 0));
+    buffer[length]=0;
+    if(std::regex_search(buffer.data(), regexpr))
+    {
+        std::cout << file->path() << std::endl;
+        ++filesmatched;
+    }
+    ++filesread;
+    bytesread+=length;
+}
+
+task search_dir(dispatcher *dispatcher, future<> dir)
+{
+    co_await dir;
+    bool restart=true, more;
+    do
+    {
+        auto listing=co_await dispatcher->enumerate(enumerate_req(dir, metadata_flags::size, 1000, restart));
+        restart=false;
+        more=listing.second;
+        for(auto &entry : listing.first)
+        {
+            if(entry.st_type()==
+#ifdef BOOST_AFIO_USE_LEGACY_FILESYSTEM_SEMANTICS
+              boost::afio::filesystem::file_type::directory_file)
+#else
+              boost::afio::filesystem::file_type::directory)
+#endif
+                search_dir(dispatcher, dispatcher->dir(path_req::relative(dir, entry.name())));
+            else if(entry.st_type()==
+#ifdef BOOST_AFIO_USE_LEGACY_FILESYSTEM_SEMANTICS
+              boost::afio::filesystem::file_type::regular_file)
+#else
+              boost::afio::filesystem::file_type::regular)
+#endif
+            {
+                size_t length=(size_t)entry.st_size();
+                if(length)
+                    search_file(dispatcher, dir, entry.name(), length);
+            }
+        }
+    } while(more);
+}
+//]
+
+int main(int argc, const char *argv[])
+{
+    typedef chrono::duration<double, ratio<1, 1>> secs_type;
+    if(argc<2)
+    {
+        std::cerr << "ERROR: Specify a regular expression to search all files in the current directory." << std::endl;
+        return 1;
+    }
+    try
+    {
+        regexpr=std::regex(argv[1]);
+        auto dispatcher=make_dispatcher("file:///", file_flags::will_be_sequentially_accessed).get();
+        auto begin=chrono::high_resolution_clock::now();
+        search_dir(dispatcher.get(), dispatcher->dir(path_req("")));
+        finished.get_future().wait();
+        auto end=chrono::high_resolution_clock::now();
+        auto diff=chrono::duration_cast<secs_type>(end-begin);
+        std::cout << "\n" << filesmatched << " files matched out of " << filesread
+            << " files which was " << bytesread << " bytes." << std::endl;
+        std::cout << "The search took " << diff.count() << " seconds which was " << filesread/diff.count()
+            << " files per second or " << (bytesread/diff.count()/1024/1024) << " Mb/sec." << std::endl;
+    }
+    catch(...)
+    {
+        std::cerr << boost::current_exception_diagnostic_information(true) << std::endl;
+        return 1;
+    }
+    return 0;
+}
+#else
+int main(void)
+{
+    std::cout << "This example needs a compiler with C++ 20 coroutines." << std::endl;
+    return 0;
+}
+#endif
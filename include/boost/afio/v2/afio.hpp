@@ -63,9 +63,14 @@ DEALINGS IN THE SOFTWARE.
 #include "detail/ErrorHandling.hpp"
 #include "detail/Utility.hpp"
 #include <algorithm> // Boost.ASIO needs std::min and std::max
+#include <deque>
 #include <exception>
 #include <iostream>
+#include <limits>
 #include <type_traits>
+#if BOOST_AFIO_HAVE_COROUTINES
+#include <coroutine>
+#endif
 
 /*! \brief Validate inputs at the point of instantiation.
 
@@ -103,42 +108,453 @@ for dispatch. This, being very useful for debugging, defaults to 1 except when
 /*! \def ASIO_STANDALONE
 \brief Determines if AFIO is bound against standalone ASIO or Boost.ASIO. Defaults to undefined, and therefore Boost.ASIO.
 */
+/*! \def BOOST_AFIO_DISABLE_OP_POOLING
+\brief Define to have op records and task state come straight from the heap instead of from per-thread free lists.
+Defaults to undefined except where the C++ runtime cannot run thread_local destructors.
+*/
+#if !defined(BOOST_AFIO_DISABLE_OP_POOLING) && (defined(__FreeBSD__) || defined(__APPLE__) || defined(BOOST_AFIO_USE_CXA_THREAD_ATEXIT_WORKAROUND))
+// No __cxa_thread_atexit means no way of returning a thread's cached blocks when it exits
+#define BOOST_AFIO_DISABLE_OP_POOLING 1
+#endif
+/*! \def BOOST_AFIO_OP_POOL_DEPTH
+\brief The maximum number of free blocks of each size each thread keeps for reuse. Defaults to 1024.
+*/
+#ifndef BOOST_AFIO_OP_POOL_DEPTH
+#define BOOST_AFIO_OP_POOL_DEPTH 1024
+#endif
+/*! \def BOOST_AFIO_OP_TASK_INLINE_SIZE
+\brief The bytes of storage within each op's task state for its bound arguments before they spill onto the heap. Defaults to 256.
+*/
+#ifndef BOOST_AFIO_OP_TASK_INLINE_SIZE
+#define BOOST_AFIO_OP_TASK_INLINE_SIZE 256
+#endif
+/*! \def BOOST_AFIO_INLINE_CONTINUATION_DEPTH
+\brief The depth to which the thread completing an op may run its continuations inline, unless changed with dispatcher::inline_continuation_depth(). Zero disables. Defaults to 0.
+*/
+#ifndef BOOST_AFIO_INLINE_CONTINUATION_DEPTH
+#define BOOST_AFIO_INLINE_CONTINUATION_DEPTH 0
+#endif
+/*! \def BOOST_AFIO_OP_TRACING
+\brief Define to 1 to compile in recording of the lifecycle of every op, which can then be enabled with
+enable_op_tracing() and written out as Chrome trace JSON with write_op_trace(). Defaults to 0.
+*/
+#ifndef BOOST_AFIO_OP_TRACING
+#define BOOST_AFIO_OP_TRACING 0
+#endif
+/*! \def BOOST_AFIO_OP_TRACE_RING_SIZE
+\brief The number of op trace events each thread keeps before overwriting the oldest. Must be a power of two. Defaults to 16384.
+*/
+#ifndef BOOST_AFIO_OP_TRACE_RING_SIZE
+#define BOOST_AFIO_OP_TRACE_RING_SIZE 16384
+#endif
+/*! \def BOOST_AFIO_PRIORITY_LANE_AGING
+\brief How many times queued work may be passed over in favour of more urgent work before it is run regardless. Defaults to 16.
+*/
+#ifndef BOOST_AFIO_PRIORITY_LANE_AGING
+#define BOOST_AFIO_PRIORITY_LANE_AGING 16
+#endif
+/*! \def BOOST_AFIO_FUTURE_SPIN_COUNT
+\brief How many times a thread waiting on an op checks whether it has completed before sleeping until it does. Defaults to 1024.
+*/
+#ifndef BOOST_AFIO_FUTURE_SPIN_COUNT
+#define BOOST_AFIO_FUTURE_SPIN_COUNT 1024
+#endif
+/*! \def BOOST_AFIO_IO_URING_ENTRIES
+\brief How many submission queue entries the io_uring of each Linux dispatcher has, which bounds how many reads, writes and syncs it can have in flight at once. Defaults to 256.
+*/
+#ifndef BOOST_AFIO_IO_URING_ENTRIES
+#define BOOST_AFIO_IO_URING_ENTRIES 256
+#endif
+/*! \def BOOST_AFIO_KAIO_EVENTS
+\brief How many reads and writes of `file_flags::os_direct` handles the compat dispatcher can have in flight at once using Linux native AIO. Defaults to 256.
+*/
+#ifndef BOOST_AFIO_KAIO_EVENTS
+#define BOOST_AFIO_KAIO_EVENTS 256
+#endif
+/*! \def BOOST_AFIO_THREADPOOL_IDLE_TIMEOUT
+\brief How many milliseconds a worker of an adaptive std_thread_pool above its minimum may sit idle before it exits. Defaults to 5000.
+*/
+#ifndef BOOST_AFIO_THREADPOOL_IDLE_TIMEOUT
+#define BOOST_AFIO_THREADPOOL_IDLE_TIMEOUT 5000
+#endif
+/*! \def BOOST_AFIO_THREADPOOL_STALL_TIMEOUT
+\brief How many milliseconds work may wait in an adaptive std_thread_pool without any worker starting or finishing anything, while none of the workers running work is using the CPU, before a worker is added regardless. Zero disables this. Defaults to 50.
+*/
+#ifndef BOOST_AFIO_THREADPOOL_STALL_TIMEOUT
+#define BOOST_AFIO_THREADPOOL_STALL_TIMEOUT 50
+#endif
+/*! \def BOOST_AFIO_STALL_DETECTOR_SCAN_BUDGET
+\brief Roughly how many in flight ops the stall detector of a dispatcher examines per period, which bounds the cost of each scan however many ops are in flight. Defaults to 4096.
+*/
+#ifndef BOOST_AFIO_STALL_DETECTOR_SCAN_BUDGET
+#define BOOST_AFIO_STALL_DETECTOR_SCAN_BUDGET 4096
+#endif
 
 BOOST_AFIO_V2_NAMESPACE_BEGIN
 
 // This isn't consistent on MSVC so hard code it
 typedef unsigned long long off_t;
+class handle;
 
 //! \brief The namespace containing Boost.ASIO internal details
 namespace detail
 {
+    /* A per-thread free list of fixed size blocks. A block is returned to the list of
+    whichever thread frees it, so blocks migrate towards the threads which retire ops,
+    which are usually the same pool workers which schedule the next ones.
+    */
+    template<size_t BlockSize> class thread_block_cache
+    {
+        struct node { node *next; };
+        static_assert(BlockSize>=sizeof(node), "BlockSize too small");
+        node *head;
+        size_t count;
+        // 0 = not yet constructed, 1 = alive, 2 = destroyed during thread exit
+        static int &state() { static BOOST_AFIO_THREAD_LOCAL int s; return s; }
+        thread_block_cache() : head(nullptr), count(0) { state()=1; }
+        thread_block_cache(const thread_block_cache &) = delete;
+        thread_block_cache &operator=(const thread_block_cache &) = delete;
+    public:
+        ~thread_block_cache()
+        {
+            state()=2;
+            while(head)
+            {
+                node *n=head;
+                head=n->next;
+                ::operator delete(n);
+            }
+        }
+        //! Returns this thread's cache, or null if this thread is exiting and it has already been destroyed
+        static thread_block_cache *get() noexcept
+        {
+            if(2==state())
+                return nullptr;
+            static thread_local thread_block_cache c;
+            return &c;
+        }
+        void *allocate()
+        {
+            if(!head)
+                return ::operator new(BlockSize);
+            node *n=head;
+            head=n->next;
+            --count;
+            return n;
+        }
+        void deallocate(void *p) noexcept
+        {
+            if(count>=BOOST_AFIO_OP_POOL_DEPTH)
+            {
+                ::operator delete(p);
+                return;
+            }
+            node *n=static_cast<node *>(p);
+            n->next=head;
+            head=n;
+            ++count;
+        }
+    };
+    /* An STL allocator which serves single object allocations from thread_block_cache, and
+    everything else from the heap. Used for the records and task state allocated per op.
+    */
+    template<class T> class op_pool_allocator
+    {
+        // Round up to a pointer multiple so similarly sized types share a free list
+        template<class U> struct cache_for { typedef thread_block_cache<(sizeof(U)+sizeof(void *)-1)&~(sizeof(void *)-1)> type; };
+    public:
+        typedef T value_type;
+        template<class U> struct rebind { typedef op_pool_allocator<U> other; };
+        op_pool_allocator() noexcept { }
+        template<class U> op_pool_allocator(const op_pool_allocator<U> &) noexcept { }
+        T *allocate(size_t n)
+        {
+#ifndef BOOST_AFIO_DISABLE_OP_POOLING
+            if(1==n)
+            {
+                if(auto *c=cache_for<T>::type::get())
+                    return static_cast<T *>(c->allocate());
+            }
+#endif
+            return static_cast<T *>(::operator new(n*sizeof(T)));
+        }
+        void deallocate(T *p, size_t n) noexcept
+        {
+#ifndef BOOST_AFIO_DISABLE_OP_POOLING
+            if(1==n)
+            {
+                if(auto *c=cache_for<T>::type::get())
+                {
+                    c->deallocate(p);
+                    return;
+                }
+            }
+#endif
+            ::operator delete(p);
+        }
+    };
+    template<class T, class U> inline bool operator==(const op_pool_allocator<T> &, const op_pool_allocator<U> &) noexcept { return true; }
+    template<class T, class U> inline bool operator!=(const op_pool_allocator<T> &, const op_pool_allocator<U> &) noexcept { return false; }
+
+    /* A non-copyable type erased nullary callable with BOOST_AFIO_OP_TASK_INLINE_SIZE bytes
+    of inline storage. Unlike std::function, binding the argument packs of the common ops
+    (path_req, io_req_impl, vectors of ranges etc) does not touch the heap.
+    */
+    template<class R> class inline_task
+    {
+        typedef typename std::aligned_storage<BOOST_AFIO_OP_TASK_INLINE_SIZE>::type storage_type;
+        struct vtable_type
+        {
+            R (*call)(void *);
+            void (*destroy)(void *);
+        };
+        template<class F, bool is_inline> struct impl
+        {
+            static F *get(void *s) { return static_cast<F *>(s); }
+            template<class U> static void create(void *s, U &&f) { new(s) F(std::forward<U>(f)); }
+            static R call(void *s) { return (*get(s))(); }
+            static void destroy(void *s) { get(s)->~F(); }
+        };
+        template<class F> struct impl<F, false>
+        {
+            static F *get(void *s) { return *static_cast<F **>(s); }
+            template<class U> static void create(void *s, U &&f) { *static_cast<F **>(s)=new F(std::forward<U>(f)); }
+            static R call(void *s) { return (*get(s))(); }
+            static void destroy(void *s) { delete get(s); }
+        };
+        template<class F> static bool is_empty(const F &) { return false; }
+        static bool is_empty(const std::function<R()> &f) { return !f; }
+        const vtable_type *_vtable;
+        storage_type _storage;
+        inline_task(const inline_task &) = delete;
+        inline_task &operator=(const inline_task &) = delete;
+    public:
+        //! Constructs an empty task
+        inline_task() noexcept : _vtable(nullptr) { }
+        //! Constructs a task from any nullary callable
+        template<class F> explicit inline_task(F &&f) : _vtable(nullptr) { assign(std::forward<F>(f)); }
+        ~inline_task() { reset(); }
+        //! Destroys any callable held
+        void reset() noexcept
+        {
+            if(_vtable)
+            {
+                const vtable_type *v=_vtable;
+                _vtable=nullptr;
+                v->destroy(&_storage);
+            }
+        }
+        //! Replaces any callable held with \em f, storing it inline if it fits
+        template<class F> void assign(F &&f)
+        {
+            typedef typename std::decay<F>::type callable_type;
+            static constexpr bool fits=sizeof(callable_type)<=sizeof(storage_type) && std::alignment_of<callable_type>::value<=std::alignment_of<storage_type>::value;
+            typedef impl<callable_type, fits> impl_type;
+            static const vtable_type vtable={ &impl_type::call, &impl_type::destroy };
+            reset();
+            if(is_empty(f))
+                return;
+            impl_type::create(&_storage, std::forward<F>(f));
+            _vtable=&vtable;
+        }
+        //! True if a callable is held
+        explicit operator bool() const noexcept { return _vtable!=nullptr; }
+        //! Invokes the callable held
+        R operator()() { return _vtable->call(&_storage); }
+    };
+
+    //! Sleeps the calling thread while \em *addr equals \em expected, until woken by unpark_all() or \em deadline passes. May return spuriously.
+    BOOST_AFIO_HEADERS_ONLY_FUNC_SPEC void park(const atomic<int> *addr, int expected, const chrono::steady_clock::time_point *deadline=nullptr) noexcept;
+    //! Wakes every thread sleeping in park() on \em addr
+    BOOST_AFIO_HEADERS_ONLY_FUNC_SPEC void unpark_all(const atomic<int> *addr) noexcept;
+
+    /* The shared state of the handle an op yields, set exactly once. Unlike a promise and shared_future
+    there is no mutex nor condition variable, just one atomic, so checking readiness is a single load and
+    setting it costs a system call only if somebody is actually waiting. Waiters spin for a while first,
+    as most ops complete within microseconds, and only then sleep on the atomic until it is set.
+    */
+    class handle_future_state
+    {
+        enum { pending, pending_waited, has_value, has_exception, has_error };
+        mutable atomic<int> _status;
+        std::shared_ptr<handle> _value;
+        exception_ptr _exception;
+        error_code _error;  // Only turned into an exception if one is asked for
+        handle_future_state(const handle_future_state &) = delete;
+        handle_future_state &operator=(const handle_future_state &) = delete;
+        void _set(int status) noexcept
+        {
+            if(pending_waited==_status.exchange(status, memory_order_acq_rel))
+                unpark_all(&_status);
+        }
+        // Returns the status once set, or pending if the deadline passed first
+        int _wait(const chrono::steady_clock::time_point *deadline) const noexcept
+        {
+            int s=_status.load(memory_order_acquire);
+            for(size_t n=0; s<has_value && n<BOOST_AFIO_FUTURE_SPIN_COUNT; n++)
+            {
+#ifdef BOOST_SMT_PAUSE
+                BOOST_SMT_PAUSE
+#endif
+                ;
+                s=_status.load(memory_order_acquire);
+            }
+            while(s<has_value)
+            {
+                if(deadline && chrono::steady_clock::now()>=*deadline)
+                    return pending;
+                // Tell the setter it must wake us before sleeping
+                if(pending==s && !_status.compare_exchange_weak(s, pending_waited, memory_order_acquire))
+                    continue;
+                park(&_status, pending_waited, deadline);
+                s=_status.load(memory_order_acquire);
+            }
+            return s;
+        }
+    public:
+        handle_future_state() noexcept : _status(pending) { }
+        //! True if set
+        bool is_ready() const noexcept { return _status.load(memory_order_acquire)>=has_value; }
+        //! Sets the handle, waking any waiters
+        void set_value(std::shared_ptr<handle> v) noexcept { _value=std::move(v); _set(has_value); }
+        //! Sets an exception, waking any waiters
+        void set_exception(exception_ptr e) noexcept { _exception=std::move(e); _set(has_exception); }
+        //! Sets an error, waking any waiters. No exception is made unless one is asked for.
+        void set_error(error_code ec) noexcept { _error=ec; _set(has_error); }
+        //! Waits until set
+        void wait() const noexcept { _wait(nullptr); }
+        //! Waits until set or \em deadline, returning true if set
+        bool wait_until(const chrono::steady_clock::time_point &deadline) const noexcept { return is_ready() || _wait(&deadline)>=has_value; }
+        //! Waits until set, returning the handle or rethrowing the exception
+        const std::shared_ptr<handle> &get() const
+        {
+            int s=_wait(nullptr);
+            if(has_exception==s)
+                rethrow_exception(_exception);
+            if(has_error==s)
+                throw system_error(_error);
+            return _value;
+        }
+        //! Waits until set, returning any exception, which for an error is made afresh each call
+        exception_ptr get_exception_ptr() const noexcept
+        {
+            if(has_error==_wait(nullptr))
+                return BOOST_AFIO_V2_NAMESPACE::make_exception_ptr(system_error(_error));
+            return _exception;
+        }
+        //! Waits until set, returning any error without making an exception for it
+        error_code get_error() const noexcept
+        {
+            return has_error==_wait(nullptr) ? _error : error_code();
+        }
+        //! Waits until set, returning true if set to an exception or an error
+        bool has_failed() const noexcept
+        {
+            return _wait(nullptr)>=has_exception;
+        }
+    };
+    /* A counted reference to a handle_future_state with the same interface as the shared_future<handle_ptr>
+    it replaces. The state of an op lives inside its enqueued_task, so referring to it costs no allocation.
+    */
+    class handle_future
+    {
+        std::shared_ptr<handle_future_state> _s;
+        void _check() const
+        {
+            if(!_s)
+                throw future_error(future_errc::no_state);
+        }
+    public:
+        handle_future() noexcept { }
+        explicit handle_future(std::shared_ptr<handle_future_state> s) noexcept : _s(std::move(s)) { }
+        //! Returns a future already set to \em v
+        static handle_future from_value(std::shared_ptr<handle> v)
+        {
+            auto s=std::allocate_shared<handle_future_state>(op_pool_allocator<handle_future_state>());
+            s->set_value(std::move(v));
+            return handle_future(std::move(s));
+        }
+        //! Returns a future already set to \em e
+        static handle_future from_exception(exception_ptr e)
+        {
+            auto s=std::allocate_shared<handle_future_state>(op_pool_allocator<handle_future_state>());
+            s->set_exception(std::move(e));
+            return handle_future(std::move(s));
+        }
+        bool valid() const noexcept { return !!_s; }
+        bool is_ready() const noexcept { return _s && _s->is_ready(); }
+        const std::shared_ptr<handle> &get() const { _check(); return _s->get(); }
+        exception_ptr get_exception_ptr() const { _check(); return _s->get_exception_ptr(); }
+        error_code get_error() const { _check(); return _s->get_error(); }
+        bool has_failed() const { _check(); return _s->has_failed(); }
+        void wait() const { _check(); _s->wait(); }
+        template<class Rep, class Period> future_status wait_for(const chrono::duration<Rep, Period> &duration) const
+        {
+            _check();
+            if(_s->is_ready())
+                return future_status::ready;
+            return _s->wait_until(chrono::steady_clock::now()+chrono::duration_cast<chrono::steady_clock::duration>(duration)) ? future_status::ready : future_status::timeout;
+        }
+        template<class Clock, class Duration> future_status wait_until(const chrono::time_point<Clock, Duration> &deadline) const
+        {
+            return wait_for(deadline-Clock::now());
+        }
+    };
+
+    // Where an enqueued_task keeps the result of its callable, generally a promise and a shared_future to it
+    template<class R> struct enqueued_task_state
+    {
+        typedef shared_future<R> future_type;
+        promise<R> r;
+        shared_future<R> f;
+#if BOOST_AFIO_USE_BOOST_THREAD
+        template<class A> explicit enqueued_task_state(const A &) : f(r.get_future().share()) { }
+#else
+        // Have the promise's shared state also come from the op pool
+        template<class A> explicit enqueued_task_state(const A &alloc) : r(std::allocator_arg, alloc), f(r.get_future().share()) { }
+#endif
+        template<class T> void set_value(T &&v) { r.set_value(std::forward<T>(v)); }
+        void set_value() { r.set_value(); }
+        void set_exception(exception_ptr e) { r.set_exception(e); }
+        void set_error(error_code ec) { r.set_exception(BOOST_AFIO_V2_NAMESPACE::make_exception_ptr(system_error(ec))); }
+        template<class P> future_type get_future(const std::shared_ptr<P> &) const { return f; }
+    };
+    // The handle results of ops get a handle_future_state embedded in the task state instead
+    template<> struct enqueued_task_state<std::shared_ptr<handle>> : handle_future_state
+    {
+        typedef handle_future future_type;
+        template<class A> explicit enqueued_task_state(const A &) { }
+        template<class P> future_type get_future(const std::shared_ptr<P> &owner) { return handle_future(std::shared_ptr<handle_future_state>(owner, this)); }
+    };
+
     template<class R> class enqueued_task_impl
     {
     protected:
         struct Private
         {
-            std::function<R()> task;
-            promise<R> r;
-            shared_future<R> f;
+            inline_task<R> task;
+            enqueued_task_state<R> state;
             bool autoset;
             atomic<int> done;
-            Private(std::function<R()> _task) : task(std::move(_task)), f(r.get_future().share()), autoset(true), done(0) { }
+            template<class F> Private(F &&_task) : task(std::forward<F>(_task)), state(op_pool_allocator<Private>()), autoset(true), done(0) { }
         };
         std::shared_ptr<Private> p;
         void validate() const { assert(p); /*if(!p) abort();*/ }
     public:
         //! Default constructor
-        enqueued_task_impl(std::function<R()> _task=std::function<R()>()) : p(std::make_shared<Private>(std::move(_task))) { }
+        enqueued_task_impl(std::function<R()> _task=std::function<R()>()) : p(std::allocate_shared<Private>(op_pool_allocator<Private>(), std::move(_task))) { }
         //! Returns true if valid
         bool valid() const noexcept{ return p.get()!=nullptr; }
         //! Swaps contents with another instance
         void swap(enqueued_task_impl &o) noexcept{ p.swap(o.p); }
         //! Resets the contents
         void reset() { p.reset(); }
-        //! Sets the task
-        void set_task(std::function<R()> _task) { p->task=std::move(_task); }
+        //! Sets the task. Any callable small enough is stored without allocating memory.
+        template<class F> void set_task(F &&_task) { p->task.assign(std::forward<F>(_task)); }
+        //! The type of future get_future() returns
+        typedef typename enqueued_task_state<R>::future_type future_type;
         //! Returns the shared stl_future corresponding to the stl_future return value of the task
-        const shared_future<R> &get_future() const { validate(); return p->f; }
+        future_type get_future() const { validate(); return p->state.get_future(p); }
         //! Sets the shared stl_future corresponding to the stl_future return value of the task.
         template<class T> void set_future_value(T v)
         {
@@ -146,7 +562,7 @@ namespace detail
             validate();
             if(!p->done.compare_exchange_strong(_, 1))
                 return;
-            p->r.set_value(std::move(v));
+            p->state.set_value(std::move(v));
         }
         void set_future_value()
         {
@@ -154,7 +570,7 @@ namespace detail
             validate();
             if(!p->done.compare_exchange_strong(_, 1))
                 return;
-            p->r.set_value();
+            p->state.set_value();
         }
         //! Sets the shared stl_future corresponding to the stl_future return value of the task.
         void set_future_exception(exception_ptr e)
@@ -163,7 +579,16 @@ namespace detail
             validate();
             if(!p->done.compare_exchange_strong(_, 1))
                 return;
-            p->r.set_exception(e);
+            p->state.set_exception(e);
+        }
+        //! Sets the shared stl_future to an error, which the state of an op keeps without making an exception until one is asked for.
+        void set_future_error(error_code ec)
+        {
+            int _=0;
+            validate();
+            if(!p->done.compare_exchange_strong(_, 1))
+                return;
+            p->state.set_error(ec);
         }
         //! Disables the task setting the shared stl_future return value.
         void disable_auto_set_future(bool v=true) { validate(); p->autoset=!v; }
@@ -213,7 +638,7 @@ public:
             }
         }
         // Free any bound parameters in task to save memory
-        _p->task=std::function<R()>();
+        _p->task.reset();
     }
 };
 template<> class enqueued_task<void()> : public detail::enqueued_task_impl<void>
@@ -247,9 +672,194 @@ public:
             }
         }
         // Free any bound parameters in task to save memory
-        _p->task=std::function<void()>();
+        _p->task.reset();
     }
 };
+namespace detail
+{
+    /* A copyable type erased void() callable with enough inline storage for an enqueued_task,
+    used to hand work to a thread_source without allocating memory.
+    */
+    class work_item
+    {
+        typedef std::aligned_storage<4*sizeof(void *)>::type storage_type;
+        struct vtable_type
+        {
+            void (*call)(void *);
+            void (*copy)(void *, const void *);
+            void (*move)(void *, void *);
+            void (*destroy)(void *);
+        };
+        template<class F, bool is_inline> struct impl
+        {
+            static F *get(void *s) { return static_cast<F *>(s); }
+            template<class U> static void create(void *s, U &&f) { new(s) F(std::forward<U>(f)); }
+            static void call(void *s) { (*get(s))(); }
+            static void copy(void *d, const void *s) { new(d) F(*static_cast<const F *>(s)); }
+            static void move(void *d, void *s) { new(d) F(std::move(*get(s))); get(s)->~F(); }
+            static void destroy(void *s) { get(s)->~F(); }
+        };
+        template<class F> struct impl<F, false>
+        {
+            static F *&get(void *s) { return *static_cast<F **>(s); }
+            template<class U> static void create(void *s, U &&f) { get(s)=new F(std::forward<U>(f)); }
+            static void call(void *s) { (*get(s))(); }
+            static void copy(void *d, const void *s) { get(d)=new F(**static_cast<F *const *>(s)); }
+            static void move(void *d, void *s) { get(d)=get(s); }
+            static void destroy(void *s) { delete get(s); }
+        };
+        const vtable_type *_vtable;
+        storage_type _storage;
+    public:
+        //! Constructs an empty work item
+        work_item() noexcept : _vtable(nullptr) { }
+        //! Constructs a work item from any copyable nullary callable
+        template<class F, class=typename std::enable_if<!std::is_same<typename std::decay<F>::type, work_item>::value>::type> explicit work_item(F &&f) : _vtable(nullptr)
+        {
+            typedef typename std::decay<F>::type callable_type;
+            static constexpr bool fits=sizeof(callable_type)<=sizeof(storage_type) && std::alignment_of<callable_type>::value<=std::alignment_of<storage_type>::value;
+            typedef impl<callable_type, fits> impl_type;
+            static const vtable_type vtable={ &impl_type::call, &impl_type::copy, &impl_type::move, &impl_type::destroy };
+            impl_type::create(&_storage, std::forward<F>(f));
+            _vtable=&vtable;
+        }
+        work_item(const work_item &o) : _vtable(nullptr)
+        {
+            if(o._vtable)
+            {
+                o._vtable->copy(&_storage, &o._storage);
+                _vtable=o._vtable;
+            }
+        }
+        work_item(work_item &&o) noexcept : _vtable(nullptr)
+        {
+            if(o._vtable)
+            {
+                o._vtable->move(&_storage, &o._storage);
+                _vtable=o._vtable;
+                o._vtable=nullptr;
+            }
+        }
+        work_item &operator=(const work_item &o)
+        {
+            if(this!=&o)
+            {
+                work_item temp(o);
+                *this=std::move(temp);
+            }
+            return *this;
+        }
+        work_item &operator=(work_item &&o) noexcept
+        {
+            if(this!=&o)
+            {
+                reset();
+                if(o._vtable)
+                {
+                    o._vtable->move(&_storage, &o._storage);
+                    _vtable=o._vtable;
+                    o._vtable=nullptr;
+                }
+            }
+            return *this;
+        }
+        ~work_item() { reset(); }
+        //! Destroys any callable held
+        void reset() noexcept
+        {
+            if(_vtable)
+            {
+                const vtable_type *v=_vtable;
+                _vtable=nullptr;
+                v->destroy(&_storage);
+            }
+        }
+        //! True if a callable is held
+        explicit operator bool() const noexcept { return _vtable!=nullptr; }
+        //! Invokes the callable held
+        void operator()() { _vtable->call(&_storage); }
+    };
+
+    //! The lanes a thread source services work from, most urgent first
+    enum class work_lane : unsigned char
+    {
+        latency_critical,
+        normal,
+        background
+    };
+    /* Queues of work, one per lane. pop() takes from the most urgent lane with work, except
+    that work passed over BOOST_AFIO_PRIORITY_LANE_AGING times for more urgent work is taken
+    next regardless, so a steady stream of urgent work can delay, but never starve, the rest.
+    Each lane has its own lock, so work pushed to one lane doesn't contend with work taken from
+    another, and keeps a count of its work so the most urgent lane can be found without locking.
+    */
+    class work_lanes
+    {
+        static constexpr size_t lanes_count=3;
+        struct lane_t
+        {
+            spinlock<bool> lock;
+            std::deque<work_item> q;
+            atomic<size_t> count, passed_over;
+            char padding[64];  // keep neighbouring lane locks out of each other's cache lines
+            lane_t() : count(0), passed_over(0) { }
+        };
+        lane_t lanes[lanes_count];
+    public:
+        void push(work_item &&item, work_lane lane)
+        {
+            lane_t &l=lanes[(size_t) lane];
+            lock_guard<decltype(l.lock)> g(l.lock);
+            l.q.push_back(std::move(item));
+            l.count.fetch_add(1, memory_order_relaxed);
+        }
+        //! True if no lane more urgent than \em lane has work waiting
+        bool none_before(work_lane lane) const noexcept
+        {
+            for(size_t n=0; n<(size_t) lane; n++)
+                if(lanes[n].count.load(memory_order_relaxed))
+                    return false;
+            return true;
+        }
+        bool pop(work_item &out)
+        {
+            for(;;)
+            {
+                size_t lane=lanes_count;
+                for(size_t n=0; n<lanes_count; n++)
+                {
+                    if(!lanes[n].count.load(memory_order_relaxed))
+                        continue;
+                    if(lane==lanes_count)
+                        lane=n;
+                    else if(lanes[n].passed_over.load(memory_order_relaxed)>=BOOST_AFIO_PRIORITY_LANE_AGING)
+                    {
+                        lane=n;
+                        break;
+                    }
+                }
+                if(lane==lanes_count)
+                    return false;
+                lane_t &l=lanes[lane];
+                {
+                    lock_guard<decltype(l.lock)> g(l.lock);
+                    // Another thread may have taken the last of it since we looked
+                    if(l.q.empty())
+                        continue;
+                    out=std::move(l.q.front());
+                    l.q.pop_front();
+                    l.count.fetch_sub(1, memory_order_relaxed);
+                }
+                for(size_t n=lane+1; n<lanes_count; n++)
+                    if(lanes[n].count.load(memory_order_relaxed))
+                        lanes[n].passed_over.fetch_add(1, memory_order_relaxed);
+                l.passed_over.store(0, memory_order_relaxed);
+                return true;
+            }
+        }
+    };
+}
+
 /*! \class thread_source
 \brief Abstract base class for a source of thread workers
 
@@ -259,47 +869,185 @@ may be reference count deleted before static data deinit occurs.
 */
 class thread_source : public std::enable_shared_from_this<thread_source>
 {
+    detail::work_lanes lanes;
+    atomic<bool> lanes_used;
+    // Until work is first enqueued to a lane other than normal there is nothing to order, so work
+    // goes straight to the thread source. After that everything goes onto its lane, with a token
+    // per item enqueued in its place which runs whichever item is most urgent when it executes.
+    void int_enqueue_lane(detail::work_item &&item, detail::work_lane lane)
+    {
+        if(detail::work_lane::normal==lane && !lanes_used.load(memory_order_relaxed))
+            int_enqueue(std::move(item));
+        else
+        {
+            lanes_used.store(true, memory_order_relaxed);
+            lanes.push(std::move(item), lane);
+            int_enqueue(detail::work_item([this]{
+                detail::work_item i;
+                if(lanes.pop(i))
+                    i();
+            }));
+        }
+    }
 protected:
     asio::io_service &service;
-    thread_source(asio::io_service &_service) : service(_service) { }
+    thread_source(asio::io_service &_service) : lanes_used(false), service(_service) { }
     BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC ~thread_source() { }
     thread_source &operator=(const thread_source &) = delete;
+    //! Schedules some work for execution. Thread sources which schedule work themselves override this, the default posts it to the io_service.
+    BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC void int_enqueue(detail::work_item &&item)
+    {
+        service.post(std::move(item));
+    }
+    //! Schedules a batch of work for execution. Thread sources which can schedule a batch more cheaply than item by item override this.
+    BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC void int_enqueue(std::vector<detail::work_item> &items)
+    {
+        for(auto &i: items)
+            int_enqueue(std::move(i));
+    }
 public:
     //! Returns the underlying io_service
     asio::io_service &io_service() { return service; }
+    //! True if no work more urgent than \em lane is waiting for a thread, so work from that lane could be run now without jumping the queue
+    bool none_more_urgent(detail::work_lane lane) const noexcept { return !lanes_used.load(memory_order_relaxed) || lanes.none_before(lane); }
     //! Sends a task to the thread pool for execution \tparam "class R" The return type of the enqueued task
     template<class R> void enqueue(enqueued_task<R> task)
     {
-        service.post(task);
+        int_enqueue(detail::work_item(std::move(task)));
     }
     //! Sends some callable entity to the thread pool for execution \return An enqueued task for the enqueued callable \tparam "class F" Any callable type with signature R(void) \param f Any instance of a callable type
-    template<class F> shared_future<typename std::result_of<F()>::type> enqueue(F f)
+    template<class F> typename enqueued_task<typename std::result_of<F()>::type()>::future_type enqueue(F f)
     {
         typedef typename std::result_of<F()>::type R;
         enqueued_task<R()> out(std::move(f));
         auto ret(out.get_future());
-        service.post(out);
+        int_enqueue(detail::work_item(std::move(out)));
         return ret;
     }
+    //! Sends a task to the thread pool for execution from the given lane \tparam "class R" The return type of the enqueued task
+    template<class R> void enqueue(enqueued_task<R> task, detail::work_lane lane)
+    {
+        int_enqueue_lane(detail::work_item(std::move(task)), lane);
+    }
+    //! Sends a sequence of tasks to the thread pool for execution in one go \tparam "class Iterator" An iterator over enqueued_task<> \param first The first task \param last One past the last task \param lane The lane to execute the tasks from
+    template<class Iterator> void enqueue(Iterator first, Iterator last, detail::work_lane lane=detail::work_lane::normal)
+    {
+        if(detail::work_lane::normal!=lane || lanes_used.load(memory_order_relaxed))
+        {
+            for(; first!=last; ++first)
+                int_enqueue_lane(detail::work_item(*first), lane);
+            return;
+        }
+        std::vector<detail::work_item> items;
+        items.reserve(std::distance(first, last));
+        for(; first!=last; ++first)
+            items.push_back(detail::work_item(*first));
+        if(!items.empty())
+            int_enqueue(items);
+    }
+};
+
+/*! \enum thread_placement
+\brief Where the workers of a std_thread_pool run
+\ingroup process_threadpool
+*/
+enum class thread_placement
+{
+    none,       //!< Wherever the OS schedules them
+    core,       //!< Each worker is pinned to one CPU, round robin across the CPUs of each NUMA node in turn
+    numa_node   //!< Each NUMA node gets its own workers pinned to its CPUs, and work runs on the node it was enqueued from where possible
+};
+
+namespace detail {
+    //! The CPUs of each NUMA node. Machines or platforms without NUMA support report a single node with every CPU.
+    BOOST_AFIO_HEADERS_ONLY_FUNC_SPEC std::vector<std::vector<unsigned>> numa_nodes();
+    //! Restricts the calling thread to running on \em cpus, returning false if this platform cannot
+    BOOST_AFIO_HEADERS_ONLY_FUNC_SPEC bool pin_this_thread(const std::vector<unsigned> &cpus) noexcept;
+    //! Returns the CPU the calling thread is running upon, or -1 if this platform cannot tell
+    BOOST_AFIO_HEADERS_ONLY_FUNC_SPEC int this_thread_cpu() noexcept;
+    //! The CPU time consumed by the thread which constructed this, which any thread may read
+    class thread_cpu_clock
+    {
+        intptr_t _h;  // A clockid_t on POSIX, a HANDLE on Windows
+        bool _valid;
+        thread_cpu_clock(const thread_cpu_clock &)=delete;
+        thread_cpu_clock &operator=(const thread_cpu_clock &)=delete;
+    public:
+        BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC thread_cpu_clock() noexcept;
+        BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC ~thread_cpu_clock();
+        //! Returns the CPU time consumed so far, or a negative duration if this platform cannot tell
+        BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC chrono::nanoseconds now() const noexcept;
+    };
+    struct blocking_syscall;
+}
+
+/*! \struct thread_pool_bounds
+\brief The limits within which an adaptive std_thread_pool sizes itself
+\ingroup process_threadpool
+*/
+struct thread_pool_bounds
+{
+    size_t min;                         //!< Workers are spawned lazily up to this many as work arrives, and never exit through idleness below it
+    size_t max;                         //!< Workers beyond min are spawned only while every worker is blocked in a syscall or work stalls, up to this many
+    chrono::milliseconds idle_timeout;  //!< How long a worker beyond min may sit idle before it exits
+    chrono::milliseconds stall_timeout; //!< How long work may wait without any worker starting or finishing anything, and none running work using the CPU, before a worker is added. Zero never adds one.
+    //! Constructs a set of bounds, where a min of zero is taken to be one
+    thread_pool_bounds(size_t _min, size_t _max, chrono::milliseconds _idle_timeout=chrono::milliseconds(BOOST_AFIO_THREADPOOL_IDLE_TIMEOUT), chrono::milliseconds _stall_timeout=chrono::milliseconds(BOOST_AFIO_THREADPOOL_STALL_TIMEOUT)) : min(_min ? _min : 1), max(_max<min ? min : _max), idle_timeout(_idle_timeout), stall_timeout(_stall_timeout) { }
+};
+
+/*! \struct thread_pool_worker_stats
+\brief What one worker of an adaptive std_thread_pool is doing, as returned by std_thread_pool::worker_stats()
+\ingroup process_threadpool
+*/
+struct thread_pool_worker_stats
+{
+    chrono::nanoseconds blocked;    //!< How long the worker has spent blocked in file i/o syscalls
+    chrono::nanoseconds cpu;        //!< How much CPU time the worker has used, or a negative duration if this platform cannot tell
+    bool running;                   //!< True if the worker is running work right now
 };
 
 /*! \class std_thread_pool
 \brief A very simple thread pool based on std::thread or boost::thread
 
 This instantiates a `asio::io_service` and a latchable `asio::io_service::work` to keep any threads working until the instance is destructed.
-*/
-class std_thread_pool : public thread_source {
+
+On multi socket machines, memory is local to one NUMA node and is slower to reach from the CPUs of the
+others. Constructing the pool with thread_placement::numa_node gives each node its own `asio::io_service`
+and \em no workers pinned to that node's CPUs. Work enqueued by one of the pool's own workers, such as the
+next op of a chain, then runs on the same node, and work enqueued by any other thread runs on the node of
+the CPU that thread is running upon. Buffers touched first by that thread were most likely allocated there too.
+Only if a node has more than twice as much work waiting as it has workers does work spill over to the least
+loaded node. Anything posted straight to io_service() runs on the first node.
+
+Constructing the pool with a thread_pool_bounds instead makes it adaptive. No threads exist until work is
+enqueued, and workers are then spawned one at a time whenever more work is waiting than there are idle workers,
+up to the minimum. Past the minimum, a worker is added only when every worker is blocked inside a file i/o
+syscall while work is waiting, as more CPU bound workers than CPUs gains nothing, up to the maximum. Workers
+stuck in anything else, such as a completion waiting upon work queued behind it, are caught by a monitor thread
+started along with the first worker. It adds a worker whenever work has waited the stall timeout without any
+worker starting or finishing anything, so long as none of the workers running work used the CPU meanwhile, again
+up to the maximum. Long running CPU bound work therefore never grows the pool. Platforms which cannot tell how
+much CPU a thread has used never grow the pool upon a stall. Workers beyond the minimum exit after sitting idle
+for the idle timeout. Anything posted straight to io_service() is run by whichever workers are waiting inside it,
+of which there is always at least one once any has been spawned. worker_stats() reports how long each worker
+has spent blocked in file i/o syscalls.
+*/
+class BOOST_AFIO_DECL std_thread_pool : public thread_source {
     class worker
     {
         std_thread_pool *pool;
+        size_t node;
+        std::vector<unsigned> cpus;
     public:
-        explicit worker(std_thread_pool *p) : pool(p) { }
+        explicit worker(std_thread_pool *p, size_t _node=0, std::vector<unsigned> _cpus=std::vector<unsigned>()) : pool(p), node(_node), cpus(std::move(_cpus)) { }
         void operator()()
         {
             detail::set_threadname("boost::afio::std_thread_pool worker");
+            if(!cpus.empty())
+                detail::pin_this_thread(cpus);
             try
             {
-                pool->service.run();
+                pool->int_run(node);
             }
             catch(...)
             {
@@ -308,53 +1056,217 @@ class std_thread_pool : public thread_source {
         }
     };
     friend class worker;
+    struct node_t
+    {
+        asio::io_service *service;
+        std::unique_ptr<asio::io_service> ownservice;  // For every node but the first, which uses the pool's own
+        std::unique_ptr<asio::io_service::work> working;
+        std::vector<unsigned> cpus;
+        size_t workers;
+        atomic<size_t> posted, ran;  // posted-ran estimates the work waiting
+        char padding[64];
+        node_t() : service(nullptr), workers(0), posted(0), ran(0) { }
+    };
+    // What one worker of an adaptive pool is doing, kept on its stack while it lives
+    struct worker_record
+    {
+        atomic<unsigned long long> blockedns;  // Only written by its worker
+        atomic<bool> running;                  // Only written by its worker
+        detail::thread_cpu_clock cpu;
+        chrono::nanoseconds lastcpu;           // Only used by the monitor
+        worker_record() : blockedns(0), running(false), lastcpu(0) { }
+    };
+    struct current_worker
+    {
+        std_thread_pool *pool;
+        size_t node;
+        worker_record *record;  // Only in adaptive mode
+    };
+    static current_worker &int_current()
+    {
+        static BOOST_AFIO_THREAD_LOCAL current_worker c;
+        return c;
+    }
+    // In adaptive mode every item is wrapped so the pool knows how much is waiting and how much is running
+    struct adaptive_item
+    {
+        std_thread_pool *pool;
+        detail::work_item item;
+        void operator()()
+        {
+            // Anyone else running the io_service isn't a worker
+            worker_record *record=int_current().record;
+            pool->queued.fetch_sub(1, memory_order_relaxed);
+            pool->running.fetch_add(1, memory_order_relaxed);
+            pool->progress.fetch_add(1, memory_order_relaxed);
+            if(record)
+                record->running.store(true, memory_order_relaxed);
+            item();
+            if(record)
+                record->running.store(false, memory_order_relaxed);
+            pool->running.fetch_sub(1, memory_order_relaxed);
+            pool->progress.fetch_add(1, memory_order_relaxed);
+        }
+    };
+    friend struct adaptive_item;
+    friend struct detail::blocking_syscall;
 
     asio::io_service service;
     std::unique_ptr<asio::io_service::work> working;
-    std::vector< std::unique_ptr<thread> > workers;
+    mutable mutex workerslock;  // Adaptive workers spawn and retire from inside the pool, so workers, retired, records and the monitor need protecting
+    std::vector< std::unique_ptr<thread> > workers, retired;
+    thread_placement placement;
+    std::vector<std::unique_ptr<node_t>> nodes;  // Only populated if placement is not none
+    std::vector<size_t> cputonode;
+    size_t nextcpu;
+    // Only used in adaptive mode
+    bool adaptive;
+    thread_pool_bounds bounds;
+    atomic<size_t> alive, queued, running, blocked, inservice, idlers, progress;
+    std::vector<worker_record *> records;
+    unsigned long long retiredblockedns;  // The time blocked of workers which have exited
+    atomic<bool> stopping, monitorstarted, monitorasleep;
+    mutex idlelock, monitorlock;
+    condition_variable idlecv, monitorcv;
+    thread monitor;
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void int_run(size_t node);
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void int_run_adaptive();
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void int_monitor();
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC bool int_running_off_cpu(chrono::steady_clock::duration period);
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC size_t int_node_for_enqueue();
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC bool int_maybe_grow(bool stalled=false) noexcept;
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC static std_thread_pool *int_blocking_begin() noexcept;
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void int_blocking_end(chrono::steady_clock::time_point began) noexcept;
+protected:
+    using thread_source::int_enqueue;
+    BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC void int_enqueue(detail::work_item &&item) override;
 public:
     /*! \brief Constructs a thread pool of \em no workers
     \param no The number of worker threads to create
     */
-    explicit std_thread_pool(size_t no) : thread_source(service), working(detail::make_unique<asio::io_service::work>(service))
-    {
-        add_workers(no);
-    }
-    //! Adds more workers to the thread pool \param no The number of worker threads to add
-    void add_workers(size_t no)
+    explicit std_thread_pool(size_t no) : std_thread_pool(no, thread_placement::none)
     {
-        workers.reserve(workers.size()+no);
-        for(size_t n=0; n<no; n++)
-            workers.push_back(detail::make_unique<thread>(worker(this)));
     }
+    /*! \brief Constructs a thread pool of workers placed upon the CPUs of this machine
+    \param no The number of worker threads to create, or with thread_placement::numa_node the number per NUMA node
+    \param placement Where to run the worker threads
+    */
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC std_thread_pool(size_t no, thread_placement placement);
+    /*! \brief Constructs an adaptive thread pool which spawns workers as needed within \em bounds
+    \param bounds The limits within which the number of workers is kept
+    */
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC explicit std_thread_pool(thread_pool_bounds bounds);
+    //! Adds more workers to the thread pool, which if adaptive raises its minimum and spawns them now \param no The number of worker threads to add, or with thread_placement::numa_node the number per NUMA node
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void add_workers(size_t no);
+    //! Returns the number of NUMA nodes the workers are spread across, which is one unless constructed with thread_placement::numa_node
+    size_t numa_nodes() const noexcept { return thread_placement::numa_node==placement ? nodes.size() : 1; }
+    //! True if this pool sizes itself within a thread_pool_bounds
+    bool is_adaptive() const noexcept { return adaptive; }
+    //! Returns the number of worker threads currently running
+    size_t size() const noexcept { return adaptive ? alive.load(memory_order_relaxed) : workers.size(); }
+    //! Returns the total time the workers of an adaptive pool, past and present, have spent blocked in file i/o syscalls, or zero if not adaptive
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC chrono::nanoseconds blocked_time() const;
+    //! Returns what each worker of an adaptive pool is doing, or nothing if not adaptive
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC std::vector<thread_pool_worker_stats> worker_stats() const;
     //! Destroys the thread pool, waiting for worker threads to exit beforehand.
-    void destroy()
-    {
-        if(!service.stopped())
-        {
-            // Tell the threads there is no more work to do
-            working.reset();
-            for(auto &i: workers) { i->join(); }
-            workers.clear();
-            // For some reason ASIO occasionally thinks there is still more work to do
-            if(!service.stopped())
-                service.run();
-            service.stop();
-            service.reset();
-        }
-    }
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void destroy();
     ~std_thread_pool() final
     {
         destroy();
     }
 };
+/*! \class work_stealing_thread_pool
+\brief A thread pool with a work queue per worker, where idle workers steal work from busy ones
+
+Work enqueued by one of this pool's own workers goes onto that worker's own queue, and a worker
+always executes its own most recently queued work first. As every continuation scheduled by an
+op completing on a worker is enqueued by that worker, a dependent chain of ops such as a read
+after an open tends to stay on one core with its data still in cache. Work enqueued by any other
+thread goes onto a shared queue. Workers with nothing of their own to do take from the shared
+queue first, and then steal the oldest work queued by the other workers.
+
+Idle workers sleep inside the `asio::io_service`, so anything else posted to that (e.g. IOCP
+completions on Windows) continues to be serviced.
+
+To have a dispatcher use one of these, pass it to make_dispatcher():
+\code
+auto dispatcher=make_dispatcher("file:///", file_flags::none, file_flags::none,
+  std::make_shared<work_stealing_thread_pool>(8)).get();
+\endcode
+*/
+class BOOST_AFIO_DECL work_stealing_thread_pool : public thread_source
+{
+    struct worker_queue
+    {
+        spinlock<bool> lock;
+        std::deque<detail::work_item> q;
+        char padding[64]; // keep neighbouring queue locks out of each other's cache lines
+    };
+    struct current_worker
+    {
+        work_stealing_thread_pool *pool;
+        size_t idx;
+    };
+    static current_worker &int_current()
+    {
+        static BOOST_AFIO_THREAD_LOCAL current_worker c;
+        return c;
+    }
+    asio::io_service service;
+    std::unique_ptr<asio::io_service::work> working;
+    std::vector<std::unique_ptr<worker_queue>> queues;
+    worker_queue injected;
+    std::vector<std::unique_ptr<thread>> workers;
+    atomic<size_t> queued, idle;
+    atomic<bool> stopping;
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC bool int_pop(size_t idx, detail::work_item &out);
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void int_run(size_t idx);
+protected:
+    BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC void int_enqueue(detail::work_item &&item) override;
+    BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC void int_enqueue(std::vector<detail::work_item> &items) override;
+public:
+    /*! \brief Constructs a work stealing thread pool of \em no workers
+    \param no The number of worker threads to create
+    */
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC explicit work_stealing_thread_pool(size_t no);
+    //! Returns the number of worker threads
+    size_t size() const noexcept { return queues.size(); }
+    //! Destroys the thread pool, executing any remaining work and waiting for worker threads to exit beforehand.
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void destroy();
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC ~work_stealing_thread_pool() final;
+};
+
 /*! \brief Returns the process threadpool
 
-On first use, this instantiates a default std_thread_pool running `BOOST_AFIO_MAX_NON_ASYNC_QUEUE_DEPTH` threads which will remain until its shared count reaches zero.
+On first use, this instantiates a default adaptive std_thread_pool which will remain until its shared count reaches zero.
+Its workers are spawned as work arrives, up to `BOOST_AFIO_MIN_NON_ASYNC_QUEUE_DEPTH` (by default the number of CPUs,
+but no fewer than eight), and beyond that while all are blocked in syscalls or work stalls up to `BOOST_AFIO_MAX_NON_ASYNC_QUEUE_DEPTH`.
 \ingroup process_threadpool
 */
 BOOST_AFIO_HEADERS_ONLY_FUNC_SPEC std::shared_ptr<std_thread_pool> process_threadpool();
 
+#if BOOST_AFIO_OP_TRACING
+/*! \brief Starts or stops recording the lifecycle of every op.
+
+Each thread records when ops are scheduled, dequeued for execution, enter and leave their syscalls,
+and complete into a ring buffer of its own, so recording costs a clock read and a few stores per event.
+Only available if BOOST_AFIO_OP_TRACING is defined to 1.
+\param enable Whether to record.
+\ingroup process_threadpool
+*/
+BOOST_AFIO_HEADERS_ONLY_FUNC_SPEC void enable_op_tracing(bool enable=true);
+/*! \brief Writes every op lifecycle event still held in the per-thread ring buffers as Chrome trace JSON.
+
+Load the output into `chrome://tracing` or Perfetto. Each op appears as an async slice named after its
+type spanning scheduling to completion, with a nested `queued` slice spanning scheduling to dequeue, and
+its syscalls appear as slices upon the thread which made them. Best called when no ops are in flight.
+Only available if BOOST_AFIO_OP_TRACING is defined to 1.
+\param out The stream to write to.
+\ingroup process_threadpool
+*/
+BOOST_AFIO_HEADERS_ONLY_FUNC_SPEC void write_op_trace(std::ostream &out);
+#endif
+
 
 class dispatcher;
 using dispatcher_ptr = std::shared_ptr<dispatcher>;
@@ -372,6 +1284,10 @@ namespace detail {
     class async_file_io_dispatcher_linux;
     class async_file_io_dispatcher_qnx;
     struct immediate_async_ops;
+    struct async_op_batch;
+    struct async_file_io_dispatcher_op;
+    template<class F, class... Args> struct async_op_closure;
+    class op_strand;
     template<bool for_writing> class io_req_impl;
 }
 
@@ -706,6 +1622,7 @@ enum class file_flags : size_t
 
     os_direct=(1<<16),      //!< Bypass the OS file buffers (only really useful for writing large files, or a lot of random reads and writes. Note you must 4Kb align everything if this is on). Be VERY careful mixing this with memory mapped files.
     os_lockable=(1<<17),    // Deliberately undocumented
+    strand=(1<<18),         //!< Run reads, writes, syncs, truncates and zeros of this handle one at a time in the order they become ready to run, so a log style writer need not chain each write upon the last. Only honoured on POSIX.
 
     always_sync=(1<<24),    //!< Ask the OS to not complete until the data is on the physical storage. Some filing systems do much better with this than `sync_on_close`.
     sync_on_close=(1<<25),  //!< Automatically initiate an asynchronous flush just before file close, and fuse both operations so both must complete for close to complete.
@@ -724,10 +1641,22 @@ BOOST_AFIO_DECLARE_CLASS_ENUM_AS_BITFIELD(file_flags)
 enum class async_op_flags : size_t
 {
     none=0,                 //!< No flags set
-    immediate=1             //!< Call chained completion immediately instead of scheduling for later. Make SURE your completion can not block!
+    immediate=1,            //!< Call chained completion immediately instead of scheduling for later. Make SURE your completion can not block!
+    latency_critical=2,     //!< Schedule ahead of normal and background ops waiting for a thread, e.g. for metadata ops serving an interactive request
+    background=4            //!< Schedule behind normal and latency critical ops waiting for a thread, e.g. for bulk copies
 };
 BOOST_AFIO_DECLARE_CLASS_ENUM_AS_BITFIELD(async_op_flags)
 
+/*! \enum admission_policy
+\brief What scheduling an op does when the dispatcher already has as many ops in flight as permitted
+\ingroup async_op_flags
+*/
+enum class admission_policy
+{
+    block,          //!< Block the scheduling thread until enough ops have completed
+    would_block     //!< Don't schedule the op, instead returning a future errored with `EWOULDBLOCK`
+};
+
 namespace detail {
     /*! \enum OpType
     \brief The type of operation
@@ -789,6 +1718,227 @@ namespace detail {
     BOOST_AFIO_DECLARE_CLASS_ENUM_AS_BITFIELD(unit_testing_flags)
 }
 
+/*! \class latency_histogram
+\brief A log linear histogram of latencies, as recorded per type of op by the dispatcher.
+
+Each power of two range of nanoseconds is split into `sub_buckets` equal buckets, so any latency
+reported is accurate to within 1/`sub_buckets` of its true value. Histograms may be added together, and
+subtracted from later snapshots of the same source to yield just what was recorded in between.
+*/
+class latency_histogram
+{
+public:
+    //! Each power of two range of latencies is split into 2^sub_bucket_bits buckets
+    static constexpr size_t sub_bucket_bits=3;
+    //! The number of buckets per power of two range of latencies
+    static constexpr size_t sub_buckets=(size_t) 1<<sub_bucket_bits;
+    //! The largest power of two of nanoseconds distinguished, about 73 minutes. Longer latencies share the last bucket.
+    static constexpr size_t max_bits=42;
+    //! The total number of buckets
+    static constexpr size_t buckets=(max_bits-sub_bucket_bits+2)*sub_buckets;
+private:
+    unsigned long long _counts[buckets];
+    unsigned long long _count, _sum;
+public:
+    //! Constructs an empty histogram
+    latency_histogram() : _count(0), _sum(0)
+    {
+        for(auto &i: _counts)
+            i=0;
+    }
+    //! Returns the bucket recording a latency of \em ns nanoseconds
+    static size_t bucket(unsigned long long ns) noexcept
+    {
+        if(ns<sub_buckets)
+            return (size_t) ns;
+        size_t topbit=0;
+        for(size_t shift=32; shift; shift>>=1)
+            if(ns>>(topbit+shift))
+                topbit+=shift;
+        if(topbit>max_bits)
+            return buckets-1;
+        return (topbit-sub_bucket_bits+1)*sub_buckets+(size_t)((ns>>(topbit-sub_bucket_bits))&(sub_buckets-1));
+    }
+    //! Returns the lowest latency in nanoseconds recorded by \em idx bucket
+    static unsigned long long bucket_value(size_t idx) noexcept
+    {
+        if(idx<sub_buckets)
+            return idx;
+        size_t topbit=idx/sub_buckets+sub_bucket_bits-1;
+        return (unsigned long long)(sub_buckets+idx%sub_buckets)<<(topbit-sub_bucket_bits);
+    }
+    //! Returns the highest latency in nanoseconds recorded by \em idx bucket. The last bucket is unbounded, so it returns the longest representable chrono::nanoseconds.
+    static unsigned long long bucket_highest_value(size_t idx) noexcept
+    {
+        return idx+1<buckets ? bucket_value(idx+1)-1 : (unsigned long long) (std::numeric_limits<chrono::nanoseconds::rep>::max)();
+    }
+    //! Records a latency
+    void record(chrono::nanoseconds latency) noexcept
+    {
+        unsigned long long ns=latency.count()>0 ? (unsigned long long) latency.count() : 0;
+        ++_counts[bucket(ns)];
+        ++_count;
+        _sum+=ns;
+    }
+    //! Records \em count latencies in \em idx bucket totalling \em sum nanoseconds
+    void record(size_t idx, unsigned long long count, unsigned long long sum) noexcept
+    {
+        _counts[idx]+=count;
+        _count+=count;
+        _sum+=sum;
+    }
+    //! Returns how many latencies were recorded by \em idx bucket
+    unsigned long long count(size_t idx) const noexcept { return _counts[idx]; }
+    //! Returns how many latencies were recorded
+    unsigned long long count() const noexcept { return _count; }
+    //! Returns the mean latency recorded
+    chrono::nanoseconds mean() const noexcept { return chrono::nanoseconds(_count ? (chrono::nanoseconds::rep)(_sum/_count) : 0); }
+    /*! \brief Returns the latency which \em p percent of those recorded did not exceed.
+
+    For example percentile(99) is the p99 latency. The highest latency of the bucket the percentile falls into
+    is returned, so percentiles are never understated. Returns zero if nothing was recorded.
+    \param p The percentile, from 0 to 100.
+    */
+    chrono::nanoseconds percentile(double p) const noexcept
+    {
+        if(!_count)
+            return chrono::nanoseconds(0);
+        double t=p*_count/100;
+        unsigned long long target=(unsigned long long) t;
+        if(target<t)
+            ++target;
+        if(!target)
+            target=1;
+        unsigned long long seen=0;
+        for(size_t n=0; n<buckets; n++)
+            if((seen+=_counts[n])>=target)
+                return chrono::nanoseconds((chrono::nanoseconds::rep) bucket_highest_value(n));
+        return chrono::nanoseconds((chrono::nanoseconds::rep) bucket_highest_value(buckets-1));
+    }
+    //! Returns the lowest latency recorded, to within bucket accuracy
+    chrono::nanoseconds lowest() const noexcept
+    {
+        for(size_t n=0; n<buckets; n++)
+            if(_counts[n])
+                return chrono::nanoseconds((chrono::nanoseconds::rep) bucket_value(n));
+        return chrono::nanoseconds(0);
+    }
+    //! Returns the highest latency recorded, to within bucket accuracy
+    chrono::nanoseconds highest() const noexcept { return percentile(100); }
+    //! Adds the latencies recorded by another histogram to this one
+    latency_histogram &operator+=(const latency_histogram &o) noexcept
+    {
+        for(size_t n=0; n<buckets; n++)
+            _counts[n]+=o._counts[n];
+        _count+=o._count;
+        _sum+=o._sum;
+        return *this;
+    }
+    //! Removes the latencies recorded by an earlier snapshot of the same histogram from this one
+    latency_histogram &operator-=(const latency_histogram &o) noexcept
+    {
+        for(size_t n=0; n<buckets; n++)
+            _counts[n]-=o._counts[n];
+        _count-=o._count;
+        _sum-=o._sum;
+        return *this;
+    }
+};
+
+/*! \struct op_latencies
+\brief The latencies recorded for a type of op by the dispatcher.
+*/
+struct op_latencies
+{
+    latency_histogram queued;       //!< From scheduling until a thread started executing the op, including waiting for its precondition
+    latency_histogram executing;    //!< From a thread starting to execute the op until it completed
+    latency_histogram total;        //!< From scheduling until completion
+    //! Adds the latencies recorded by another to this one
+    op_latencies &operator+=(const op_latencies &o) noexcept
+    {
+        queued+=o.queued;
+        executing+=o.executing;
+        total+=o.total;
+        return *this;
+    }
+    //! Removes the latencies recorded by an earlier snapshot from this one
+    op_latencies &operator-=(const op_latencies &o) noexcept
+    {
+        queued-=o.queued;
+        executing-=o.executing;
+        total-=o.total;
+        return *this;
+    }
+};
+
+/*! \class dispatcher_stats
+\brief A snapshot of the latencies of the ops completed by a dispatcher, as returned by dispatcher::stats().
+
+Subtract an earlier snapshot from a later one to get the latencies of just the ops completed in between:
+\code
+auto before=dispatcher->stats();
+// ... do some i/o ...
+auto diff=dispatcher->stats()-before;
+std::cout << "p99 write latency " << diff[detail::OpType::write].total.percentile(99).count() << "ns" << std::endl;
+\endcode
+*/
+class dispatcher_stats
+{
+    std::vector<op_latencies> _ops;
+public:
+    //! Constructs an empty snapshot
+    dispatcher_stats() : _ops((size_t) detail::OpType::Last) { }
+    //! Returns the latencies recorded for a type of op
+    op_latencies &operator[](detail::OpType optype) { return _ops[(size_t) optype]; }
+    //! Returns the latencies recorded for a type of op
+    const op_latencies &operator[](detail::OpType optype) const { return _ops[(size_t) optype]; }
+    //! Returns the latencies recorded for all types of op combined
+    op_latencies all() const
+    {
+        op_latencies ret;
+        for(auto &i: _ops)
+            ret+=i;
+        return ret;
+    }
+    //! Adds the latencies recorded by another snapshot to this one
+    dispatcher_stats &operator+=(const dispatcher_stats &o)
+    {
+        for(size_t n=0; n<_ops.size(); n++)
+            _ops[n]+=o._ops[n];
+        return *this;
+    }
+    //! Removes the latencies recorded by an earlier snapshot from this one
+    dispatcher_stats &operator-=(const dispatcher_stats &o)
+    {
+        for(size_t n=0; n<_ops.size(); n++)
+            _ops[n]-=o._ops[n];
+        return *this;
+    }
+    //! Returns the latencies recorded since an earlier snapshot
+    dispatcher_stats operator-(const dispatcher_stats &o) const
+    {
+        dispatcher_stats ret(*this);
+        ret-=o;
+        return ret;
+    }
+};
+
+/*! \struct stalled_op
+\brief An op found by the stall detector of a dispatcher to have been in flight for longer than its threshold.
+*/
+struct stalled_op
+{
+    size_t id;                                  //!< The id of the op
+    detail::OpType optype;                      //!< The type of the op
+    chrono::steady_clock::duration age;         //!< How long ago the op was scheduled
+    chrono::steady_clock::duration running;     //!< How long ago a thread started executing the op, or zero if none has yet
+    path handle_path;                           //!< The path of the handle the op was scheduled upon, if any
+    size_t depth;                               //!< How many ops deep the chain of preconditions leading to this op was when it was scheduled
+    size_t dependents;                          //!< How many ops are chained directly onto this op
+    std::string stack;                          //!< Where the op was scheduled from, if BOOST_AFIO_OP_STACKBACKTRACEDEPTH is defined and the op was sampled
+    stalled_op() : id(0), optype(detail::OpType::Unknown), age(0), running(0), depth(0), dependents(0) { }
+};
+
 class handle;
 //! A type alias to a shared pointer to handle
 using handle_ptr = std::shared_ptr<handle>;
@@ -1155,6 +2305,8 @@ protected:
     handle(dispatcher *parent, file_flags flags) : _parent(parent), _opened(chrono::system_clock::now()), _flags(flags), bytesread(0), byteswritten(0), byteswrittenatlastfsync(0) { }
     //! Calling this directly can cause misoperation. Best to avoid unless you have inspected the source code for the consequences.
     BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC void close() BOOST_AFIO_HEADERS_ONLY_VIRTUAL_UNDEFINED_SPEC
+    //! The strand which ops upon this handle run through if opened with `file_flags::strand`, or null if this platform has none
+    BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC detail::op_strand *int_strand() noexcept { return nullptr; }
 public:
     BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC ~handle() { }
     //! Returns the parent of this io handle
@@ -1430,13 +2582,14 @@ namespace detail
 template<> class future<void>
 {
     // Temporary friends until lightweight future promise comes in
+    friend class dispatcher;
     friend struct detail::barrier_count_completed_state;
     template<bool rethrow, class Iterator> friend inline stl_future<std::vector<handle_ptr>> detail::when_all_ops(Iterator first, Iterator last);
     template<bool rethrow, class Iterator> friend inline stl_future<handle_ptr> detail::when_any_ops(Iterator first, Iterator last);
 
     dispatcher *_parent;              //!< The parent dispatcher
     size_t _id;                                          //!< A unique id for this operation
-    shared_future<handle_ptr> _h;  //!< A stl_future handle to the item being operated upon
+    detail::handle_future _h;  //!< The shared state of the handle to the item being operated upon
 public:
     future(future<void> &&o, stl_future<void> &&result) : future<void>(std::move(o)) { }
     // NOTE TO SELF: MAKE THE CONSTRUCTORS AND MEMBER FUNCTIONS constexpr WHEN I MERGE LIGHTWEIGHT FUTURE-PROMISES
@@ -1457,17 +2610,17 @@ public:
     /*! Constructs an instance.
     \param parent The dispatcher this op belongs to.
     \param id The unique non-zero id of this op.
-    \param handle A shared_ptr to shared state between all instances of this reference.
+    \param handle The shared state between all instances of this reference.
     \param check_handle Whether to have validation additionally check if a handle is not null
     \param validate Whether to check the inputs and shared state for valid (and not errored) values
     */
-    future(dispatcher *parent, size_t id, shared_future<handle_ptr> handle, bool check_handle=true, bool validate=true) : _parent(parent), _id(id), _h(std::move(handle)) { if(validate) _validate(check_handle); }
+    future(dispatcher *parent, size_t id, detail::handle_future handle, bool check_handle=true, bool validate=true) : _parent(parent), _id(id), _h(std::move(handle)) { if(validate) _validate(check_handle); }
     /*! Constructs an instance.
     \param _handle A shared_ptr to shared state between all instances of this reference.
     \param check_handle Whether to have validation additionally check if a handle is not null
     \param validate Whether to check the inputs and shared state for valid (and not errored) values
     */
-    future(handle_ptr _handle, bool check_handle=true, bool validate=true) : _parent(_handle->parent()), _id((size_t)-1) { promise<handle_ptr> p; p.set_value(std::move(_handle)); _h=p.get_future(); if(validate) _validate(check_handle); }
+    future(handle_ptr _handle, bool check_handle=true, bool validate=true) : _parent(_handle->parent()), _id((size_t)-1), _h(detail::handle_future::from_value(std::move(_handle))) { if(validate) _validate(check_handle); }
     /*! Constructs an instance.
     \param parent The dispatcher this op belongs to.
     \param id The unique non-zero id of this op.
@@ -1485,7 +2638,7 @@ public:
     //! \brief True if monad is not empty
     bool is_ready() const noexcept
     {
-      return valid() || _h.wait_for(chrono::seconds(0)) == future_status::ready;
+      return valid() || _h.is_ready();
     }
     //! \brief True if monad contains a value_type
     bool has_value() const noexcept { return is_ready() && !has_exception(); }
@@ -1505,7 +2658,9 @@ public:
     {
       if (!is_ready())
         return false;
-      return !!get_exception();
+      if (only_exception)
+        return !_h.get_error() && _h.has_failed();
+      return _h.has_failed();
     }
 
     //! The parent dispatcher of this future
@@ -1517,11 +2672,9 @@ public:
     {
         if(!_parent && !_id)
             return handle_ptr();
-        // std::shared_future in older libstdc++ does not have a const get().
         if(!return_null_if_errored)
-            return const_cast<future *>(this)->_h.get();
-        auto e=get_exception_ptr(_h);
-        return e ? handle_ptr() : const_cast<future *>(this)->_h.get();
+            return _h.get();
+        return _h.has_failed() ? handle_ptr() : _h.get();
     }
     //! Retrieves the handle or exception from the shared state, rethrowing any exception but setting _ec if there is an error. Returns a null shared pointer if this future is invalid.
     handle_ptr get_handle(error_type &ec) const
@@ -1529,7 +2682,7 @@ public:
       if (!_parent && !_id)
         return handle_ptr();
       ec = get_error();
-      return ec ? handle_ptr() : const_cast<future *>(this)->_h.get();
+      return ec ? handle_ptr() : _h.get();
     }
     //! Dereferences the handle from the shared state. Same as *h.get_handle().
     const handle &operator *() const { return *get_handle(); }
@@ -1551,7 +2704,11 @@ public:
     {
       if (!valid())
         throw future_error(future_errc::no_state);
-      auto e = get_exception_ptr(_h);
+      // Ops failing with an error need no exception made and rethrown to find it
+      error_type ec = _h.get_error();
+      if (ec)
+        return ec;
+      auto e = _h.get_exception_ptr();
       if (e)
       {
         try
@@ -1574,7 +2731,7 @@ public:
     {
       if (!valid())
         throw future_error(future_errc::no_state);
-      return get_exception_ptr(_h);
+      return _h.get_exception_ptr();
     }
     //! Waits for the future to become ready. Throws a `future_errc::no_state` if this future is invalid.
     void wait() const
@@ -1609,10 +2766,10 @@ public:
     {
         if(!valid()) return false;
         // If h is valid and ready and contains an exception, throw it now
-        if(_h.valid() && BOOST_AFIO_V2_NAMESPACE::is_ready(_h))
+        if(_h.is_ready())
         {
             if(check_handle)
-                if(!const_cast<shared_future<handle_ptr> &>(_h).get().get())
+                if(!_h.get().get())
                     return false;
         }
         return true;
@@ -1667,12 +2824,12 @@ public:
   /*! Constructs an instance.
   \param parent The dispatcher this op belongs to.
   \param id The unique non-zero id of this op.
-  \param handle A shared_future to shared state between all instances of this reference.
+  \param handle The shared state between all instances of this reference.
   \param result A future to any result from the operation.
   \param check_handle Whether to have validation additionally check if a handle is not null
   \param validate Whether to check the inputs and shared state for valid (and not errored) values
   */
-  future(dispatcher *parent, size_t id, shared_future<handle_ptr> handle, stl_future<T> result, bool check_handle = true, bool validate = true) : future<void>(parent, id, std::move(handle), check_handle, validate), _result(std::move(result)) { }
+  future(dispatcher *parent, size_t id, detail::handle_future handle, stl_future<T> result, bool check_handle = true, bool validate = true) : future<void>(parent, id, std::move(handle), check_handle, validate), _result(std::move(result)) { }
   /*! Constructs an instance from an existing future<void>
   \param o The future<void>
   \param result The future<T> to add
@@ -1786,6 +2943,114 @@ namespace detail
     template<class T, class... Args> struct vs2013_variadic_overload_resolution_workaround<std::vector<T>, Args...>;
 #endif
     template<class Impl, class Handle> handle_ptr decode_relative_path(path_req &req, bool force_absolute=false);
+
+    /* A copyable type erased completion handler with half of an op's BOOST_AFIO_OP_TASK_INLINE_SIZE
+    of inline storage, so that bound into the op along with everything else it still fits inline.
+    Unlike std::function<completion_t>, a lambda capturing a few pointers does not touch the heap.
+    */
+    class inline_completion
+    {
+        typedef std::pair<bool, handle_ptr> result_type;
+        typedef std::aligned_storage<BOOST_AFIO_OP_TASK_INLINE_SIZE/2>::type storage_type;
+        struct vtable_type
+        {
+            result_type (*call)(void *, size_t, future<>);
+            void (*copy)(void *, const void *);
+            void (*move)(void *, void *);
+            void (*destroy)(void *);
+        };
+        template<class F, bool is_inline> struct impl
+        {
+            static F *get(void *s) { return static_cast<F *>(s); }
+            template<class U> static void create(void *s, U &&f) { new(s) F(std::forward<U>(f)); }
+            static result_type call(void *s, size_t id, future<> op) { return (*get(s))(id, std::move(op)); }
+            static void copy(void *d, const void *s) { new(d) F(*static_cast<const F *>(s)); }
+            static void move(void *d, void *s) { new(d) F(std::move(*get(s))); get(s)->~F(); }
+            static void destroy(void *s) { get(s)->~F(); }
+        };
+        template<class F> struct impl<F, false>
+        {
+            static F *&get(void *s) { return *static_cast<F **>(s); }
+            template<class U> static void create(void *s, U &&f) { get(s)=new F(std::forward<U>(f)); }
+            static result_type call(void *s, size_t id, future<> op) { return (*get(s))(id, std::move(op)); }
+            static void copy(void *d, const void *s) { get(d)=new F(**static_cast<F *const *>(s)); }
+            static void move(void *d, void *s) { get(d)=get(s); }
+            static void destroy(void *s) { delete get(s); }
+        };
+        const vtable_type *_vtable;
+        mutable storage_type _storage;  // Each op invokes its own copy in place, however the callable was declared
+    public:
+        //! Constructs an empty completion
+        inline_completion() noexcept : _vtable(nullptr) { }
+        //! Constructs a completion from any copyable callable matching `completion_t`
+        template<class F, class=typename std::enable_if<!std::is_same<typename std::decay<F>::type, inline_completion>::value>::type> explicit inline_completion(F &&f) : _vtable(nullptr)
+        {
+            typedef typename std::decay<F>::type callable_type;
+            static constexpr bool fits=sizeof(callable_type)<=sizeof(storage_type) && std::alignment_of<callable_type>::value<=std::alignment_of<storage_type>::value;
+            typedef impl<callable_type, fits> impl_type;
+            static const vtable_type vtable={ &impl_type::call, &impl_type::copy, &impl_type::move, &impl_type::destroy };
+            impl_type::create(&_storage, std::forward<F>(f));
+            _vtable=&vtable;
+        }
+        inline_completion(const inline_completion &o) : _vtable(nullptr)
+        {
+            if(o._vtable)
+            {
+                o._vtable->copy(&_storage, &o._storage);
+                _vtable=o._vtable;
+            }
+        }
+        inline_completion(inline_completion &&o) noexcept : _vtable(nullptr)
+        {
+            if(o._vtable)
+            {
+                o._vtable->move(&_storage, &o._storage);
+                _vtable=o._vtable;
+                o._vtable=nullptr;
+            }
+        }
+        inline_completion &operator=(const inline_completion &o)
+        {
+            if(this!=&o)
+            {
+                inline_completion temp(o);
+                *this=std::move(temp);
+            }
+            return *this;
+        }
+        inline_completion &operator=(inline_completion &&o) noexcept
+        {
+            if(this!=&o)
+            {
+                reset();
+                if(o._vtable)
+                {
+                    o._vtable->move(&_storage, &o._storage);
+                    _vtable=o._vtable;
+                    o._vtable=nullptr;
+                }
+            }
+            return *this;
+        }
+        ~inline_completion() { reset(); }
+        //! Destroys any callable held
+        void reset() noexcept
+        {
+            if(_vtable)
+            {
+                const vtable_type *v=_vtable;
+                _vtable=nullptr;
+                v->destroy(&_storage);
+            }
+        }
+        //! True if a callable is held
+        explicit operator bool() const noexcept { return _vtable!=nullptr; }
+        //! Invokes the callable held in place
+        result_type operator()(size_t id, future<> op) const { return _vtable->call(&_storage, id, std::move(op)); }
+    };
+    // True if F can be called as a completion_t, which rules out the pairs and vectors of pairs taken by the other completion() overloads
+    template<class F, class=void> struct is_completion : std::false_type { };
+    template<class F> struct is_completion<F, typename std::enable_if<std::is_convertible<decltype(std::declval<F &>()(size_t(0), std::declval<future<>>())), std::pair<bool, handle_ptr>>::value>::type> : std::true_type { };
 }
 
 /*! \class dispatcher
@@ -1818,6 +3083,7 @@ class BOOST_AFIO_DECL dispatcher : public std::enable_shared_from_this<dispatche
     friend class detail::async_file_io_dispatcher_windows;
     friend class detail::async_file_io_dispatcher_linux;
     friend class detail::async_file_io_dispatcher_qnx;
+    template<class F, class... Args> friend struct detail::async_op_closure;
 
     detail::dispatcher_p *p;
     BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void int_directory_cached_handle_path_changed(path oldpath, path newpath, handle_ptr h);
@@ -1844,6 +3110,103 @@ public:
     BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC size_t wait_queue_depth() const;
     //! Returns the number of open items in this dispatcher
     BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC size_t fd_count() const;
+    //! Returns how many ops this dispatcher has completed through a kernel i/o queue, io_uring or Linux native AIO, rather than as blocking syscalls upon its thread source
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC size_t kernel_queue_ops() const;
+    /*! \brief Sets how deeply continuations may be executed inline by the thread completing their precondition.
+
+    Normally when an op completes every op chained onto it is enqueued to the thread source, costing
+    a queue round trip and often a thread wake per hop. With a non-zero depth the completing thread
+    instead executes the first non-immediate continuation itself and enqueues only the rest. Nesting
+    is bounded per thread to \em depth so long chains cannot exhaust the stack. Note that continuations
+    may then run on whichever thread completed their precondition, including your own thread if that
+    precondition was an immediate op. Defaults to BOOST_AFIO_INLINE_CONTINUATION_DEPTH (zero, disabled).
+    \param depth The maximum nesting of inline continuations, or zero to always enqueue.
+    */
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void inline_continuation_depth(size_t depth);
+    //! Returns how deeply continuations may be executed inline by the thread completing their precondition
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC size_t inline_continuation_depth() const;
+    /*! \brief Sets the priority with which ops of a given type are scheduled when not specified per op.
+
+    The thread source services ops waiting for a thread from three lanes: async_op_flags::latency_critical,
+    normal, and async_op_flags::background. Ops in a less urgent lane are only run when no more urgent op is
+    waiting, except that an op passed over BOOST_AFIO_PRIORITY_LANE_AGING times is run next regardless so it
+    cannot be starved. For example to keep directory enumerations responsive during a bulk copy:
+    \code
+    dispatcher->op_priority(detail::OpType::enumerate, async_op_flags::latency_critical);
+    dispatcher->op_priority(detail::OpType::write, async_op_flags::background);
+    \endcode
+    \param optype The type of op.
+    \param priority One of async_op_flags::latency_critical, async_op_flags::background, or async_op_flags::none for normal.
+    */
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void op_priority(detail::OpType optype, async_op_flags priority);
+    //! Returns the priority with which ops of a given type are scheduled when not specified per op
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC async_op_flags op_priority(detail::OpType optype) const;
+    /*! \brief Limits how many ops may be in flight at once, so a producer scheduling faster than the
+    storage can keep up gets pushed back on instead of exhausting memory.
+
+    When scheduling a non-immediate op would take the number of ops in flight, as reported by
+    wait_queue_depth(), to \em maxops, or the number of ops in flight upon a single handle to
+    \em maxopsperhandle, then \em policy decides what happens. Ops are only counted against a handle
+    if their precondition has already yielded that handle when they are scheduled. If
+    admission_policy::block is used, take care that it is not ops executing within the thread
+    source which get blocked, otherwise every thread could end up waiting on ops which then never run.
+    Limits are soft: threads scheduling concurrently may overshoot them slightly.
+    Configure this before scheduling any ops.
+    \param maxops The maximum ops in flight in this dispatcher, or zero for no limit.
+    \param maxopsperhandle The maximum ops in flight upon any one handle, or zero for no limit.
+    \param policy Whether to block, or to return futures errored with `EWOULDBLOCK`, when a limit is reached.
+    */
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void admission_control(size_t maxops, size_t maxopsperhandle=0, admission_policy policy=admission_policy::block);
+    /*! \brief Sets a callback invoked once the ops in flight fall to \em ops after an admission control limit was reached.
+
+    The callback is invoked at most once per time a limit is reached, from whichever thread completed the op
+    taking the ops in flight down to the watermark, so it must not block. Configure this before scheduling any ops.
+    \param ops The number of ops in flight at or below which to invoke the callback.
+    \param callback The callback, or an empty function to disable.
+    */
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void admission_low_watermark(size_t ops, std::function<void()> callback);
+    /*! \brief Cancels an op which has not yet started executing.
+
+    The op completes with an error of `ECANCELED` instead of executing, and so do any ops chained
+    onto it which have not yet started either. Ops which have already started, and barrier ops, cannot be cancelled.
+    \return True if the op had not yet started and so will never execute.
+    \param op The op to cancel.
+    */
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC bool cancel(const future<> &op);
+    /*! \brief Sets a deadline after which an op which has not yet started executing is dropped instead.
+
+    The deadline is checked when the op is dequeued for execution. If it has passed the op completes
+    with an error of `ETIMEDOUT`, and any ops chained onto it which have not yet started are cancelled.
+    \return True if the op had not yet started and so the deadline was set.
+    \param op The op to set a deadline upon.
+    \param when The point after which the op should not be started.
+    */
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC bool deadline(const future<> &op, chrono::steady_clock::time_point when);
+    /*! \brief Returns a snapshot of the latencies of every op completed since construction or the last reset_stats().
+
+    Latencies are always recorded, per type of op, into histograms private to each thread completing ops so
+    recording never writes to a cache line shared with other threads. Taking a snapshot sums those up, so it is
+    cheap enough to do every second or so but not per op. Ops cancelled or dropped before starting are not recorded.
+    \return A snapshot of this dispatcher's op latencies.
+    */
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC dispatcher_stats stats() const;
+    //! Resets the latencies returned by stats() to nothing, by subtracting all those recorded up until now from future snapshots
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void reset_stats();
+    //! The type of callback invoked by the stall detector
+    typedef void stall_handler_t(const stalled_op &);
+    /*! \brief Starts a watchdog thread which periodically scans the ops in flight, reporting any in flight for longer than \em threshold.
+
+    Each op is reported at most once, from the watchdog thread, so the callback can log it or raise an alarm
+    but should not block for long. Ops waiting on a precondition which is itself still in flight are not
+    reported, so a hung mount reports the ops actually stuck on it rather than everything queued up behind them.
+    Each period the watchdog examines whole op table shards until it has looked at BOOST_AFIO_STALL_DETECTOR_SCAN_BUDGET
+    ops, so with very many ops in flight it takes a few periods to get around them all but a scan never takes long.
+    Calling this again replaces the previous configuration. It must not be called from within the callback.
+    \param threshold How long an op may be in flight before it is reported.
+    \param callback The callback, or an empty function to stop the watchdog.
+    \param period How often to scan.
+    */
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void stall_detector(chrono::steady_clock::duration threshold, std::function<stall_handler_t> callback, chrono::steady_clock::duration period=chrono::seconds(1));
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
     /* \brief Returns an op ref for a given \b currently scheduled op id, throwing an exception if id not scheduled at the point of call.
     Can be used to retrieve exception state from some op id, or one's own shared stl_future.
@@ -1934,6 +3297,45 @@ public:
     \qexample{completion_example1}
     */
     inline future<> completion(const future<> &req, const std::pair<async_op_flags, std::function<dispatcher::completion_t>> &callback);
+    /* \brief Schedule a batch of asynchronous invocations of a callable when each of the supplied operations complete.
+
+    Unlike the overloads taking `std::function<completion_t>`, the callable is stored within each op's own state,
+    so a lambda capturing a few pointers costs no memory allocation to schedule nor to invoke. Larger callables
+    still work, they just spill onto the heap.
+    \tparam "class F" Any copyable callable matching `completion_t`.
+    \return A batch of op handles
+    \param ops A batch of precondition op handles.
+    \param callback A callable matching `completion_t`, a copy of which is invoked after each precondition completes.
+    \param flags The op flags to use for every invocation.
+    \ingroup dispatcher__completion
+    \qbk{distinguish, batch inline callable}
+    \complexity{Amortised O(N) to dispatch. Amortised O(N/threadpool) to complete.}
+    \exceptionmodelstd
+    \qexample{completion_example1}
+    */
+    template<class F, class=typename std::enable_if<detail::is_completion<F>::value>::type> inline std::vector<future<>> completion(const std::vector<future<>> &ops, F &&callback, async_op_flags flags=async_op_flags::none)
+    {
+        return int_completion(ops, flags, detail::inline_completion(std::forward<F>(callback)));
+    }
+    /* \brief Schedule the asynchronous invocation of a callable when the supplied single operation completes.
+
+    Unlike the overloads taking `std::function<completion_t>`, the callable is stored within the op's own state,
+    so a lambda capturing a few pointers costs no memory allocation to schedule nor to invoke.
+    \tparam "class F" Any copyable callable matching `completion_t`.
+    \return An op handle
+    \param req A precondition op handle
+    \param callback A callable matching `completion_t`.
+    \param flags The op flags to use.
+    \ingroup dispatcher__completion
+    \qbk{distinguish, single inline callable}
+    \complexity{Amortised O(1) to dispatch. Amortised O(1) to complete.}
+    \exceptionmodelstd
+    \qexample{completion_example1}
+    */
+    template<class F, class=typename std::enable_if<detail::is_completion<F>::value>::type> inline future<> completion(const future<> &req, F &&callback, async_op_flags flags=async_op_flags::none)
+    {
+        return std::move(int_completion(std::vector<future<>>(1, req), flags, detail::inline_completion(std::forward<F>(callback))).front());
+    }
 
     /* \brief Schedule a batch of asynchronous invocations of the specified bound functions when their supplied preconditions complete.
 
@@ -2376,10 +3778,25 @@ public:
     \exceptionmodel{Should not throw any exception except for out of memory.}
     */
     void complete_async_op(size_t id, exception_ptr e) { complete_async_op(id, handle_ptr(), e); }
+    /*! \brief Completes an operation with an error code, usually used when an operation was previously deferred.
+
+    No exception is made for the error unless one is asked for, such as by calling `get()` upon the op's future,
+    so this is much cheaper than completing with an exception for failures which are routine. `get_error()` upon the op's
+    future returns the error code as is.
+
+    \ingroup dispatcher__misc
+    \qbk{distinguish, error code}
+    \complexity{O(N) where N is the number of completions dependent on this op.}
+    \exceptionmodel{Should not throw any exception except for out of memory.}
+    */
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void complete_async_op(size_t id, error_code ec);
 protected:
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void int_complete_async_op(size_t id, handle_ptr h, exception_ptr e, error_code ec);
     template<class F> BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC handle_ptr int_get_handle_to_containing_dir(F *parent, size_t id, path_req req, completion_returntype(F::*dofile)(size_t, future<>, path_req));
     BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC completion_returntype invoke_user_completion_fast(size_t id, future<> h, completion_t *callback);
     BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC completion_returntype invoke_user_completion_slow(size_t id, future<> h, std::function<completion_t> callback);
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC completion_returntype invoke_user_completion_inline(size_t id, future<> h, const detail::inline_completion &callback);
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC std::vector<future<>> int_completion(const std::vector<future<>> &ops, async_op_flags flags, const detail::inline_completion &callback);
 
     template<class F> BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC std::vector<future<>> chain_async_ops(int optype, const std::vector<future<>> &preconditions, async_op_flags flags, completion_returntype(F::*f)(size_t, future<>, future<>));
     template<class F, class T> BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC std::vector<future<>> chain_async_ops(int optype, const std::vector<future<>> &preconditions, const std::vector<T> &container, async_op_flags flags, completion_returntype(F::*f)(size_t, future<>, T));
@@ -2390,16 +3807,28 @@ protected:
 
     template<class T> BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC dispatcher::completion_returntype dobarrier(size_t id, future<> h, T);
     template<class F, class... Args> BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC handle_ptr invoke_async_op_completions(size_t id, future<> h, completion_returntype(F::*f)(size_t, future<>, Args...), Args... args);
+    template<class F, class Flush, class... Args> BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC std::shared_ptr<detail::async_file_io_dispatcher_op> prepare_async_op(size_t thisid, int optype, const future<> &precondition, async_op_flags flags, size_t pending, Flush &&flush, completion_returntype(F::*f)(size_t, future<>, Args...), Args... args);
     template<class F, class... Args> BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC future<> chain_async_op(detail::immediate_async_ops &immediates, int optype, const future<> &precondition, async_op_flags flags, completion_returntype(F::*f)(size_t, future<>, Args...), Args... args);
+    template<class F, class... Args> BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC future<> chain_async_op(detail::async_op_batch &batch, int optype, const future<> &precondition, async_op_flags flags, completion_returntype(F::*f)(size_t, future<>, Args...), Args... args);
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void submit_async_ops(detail::async_op_batch &batch);
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC bool int_strand_op(const std::shared_ptr<detail::async_file_io_dispatcher_op> &op, const handle_ptr &h);
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC bool int_strand_op(const std::shared_ptr<detail::async_file_io_dispatcher_op> &op, const detail::handle_future &precondition);
 };
 /*! \brief Instatiates the best available async_file_io_dispatcher implementation for this system for the given uri.
 
 Note that the number of threads in the threadpool supplied is the maximum non-async op queue depth (e.g. file opens, closes etc.).
 For fast SSDs, there isn't much gain after eight-sixteen threads, so the process threadpool is set to eight by default.
 For slow hard drives, or worse, SANs, a queue depth of 64 or higher might deliver significant benefits.
+On Linux kernels providing io_uring, reads, writes, syncs and zeroing are instead queued to the kernel,
+so their queue depth is bounded by `BOOST_AFIO_IO_URING_ENTRIES` rather than by the threadpool.
 
 URIs currently supported by AFIO:
 - <b>`__fileurl__`</b> The dispatcher will refer to the local filesystem of this machine.
+- <b>`file:///?compat`</b> As above, but always the portable POSIX dispatcher, which does i/o as blocking
+syscalls upon the threadpool except reads and writes of `file_flags::os_direct` handles, which use Linux native AIO.
+Not available on Windows.
+- <b>`file:///?io_uring`</b> As `__fileurl__`, but always the io_uring dispatcher, failing with the error
+io_uring_setup() failed with rather than falling back onto the compat dispatcher. Only available on Linux.
 
 \return A shared_ptr to the best available async_file_io_dispatcher implementation for this system for the given uri.
 \param uri Where to open the dispatcher upon.
@@ -2420,94 +3849,80 @@ BOOST_AFIO_HEADERS_ONLY_FUNC_SPEC outcome<dispatcher_ptr> make_dispatcher(std::s
 
 namespace detail
 {
+    // Returns the dispatcher to attach completions to a sequence of ops with, or null if neither any op nor this thread has one
+    inline dispatcher *when_ops_dispatcher(const std::vector<future<>> &ops)
+    {
+        for(auto &op : ops)
+            if(op.parent())
+                return op.parent();
+        return current_dispatcher().get();
+    }
     struct when_all_state : std::enable_shared_from_this<when_all_state>
     {
+        atomic<size_t> togo;
         promise<std::vector<handle_ptr>> out;
-        std::vector<shared_future<handle_ptr>> in;
+        std::vector<handle_future> in;
+        when_all_state(size_t count) : togo(count) { }
     };
-    template<bool rethrow> inline void when_all_ops_do(std::shared_ptr<when_all_state> state)
+    // Every op gets a completion counting down, and whichever is last gathers the results, so no thread ever waits
+    template<bool rethrow> inline std::pair<bool, handle_ptr> when_all_ops_do(std::shared_ptr<when_all_state> state, size_t id, future<> h)
     {
-        // If we're on Boost.Thread, coalesce all wait ops into a single
-#if BOOST_AFIO_USE_BOOST_THREAD
-        boost::wait_for_all(state->in.begin(), state->in.end());
-#endif
+        if(1!=state->togo.fetch_sub(1, memory_order_acq_rel))
+            return std::make_pair(true, handle_ptr());
         std::vector<handle_ptr> ret;
         ret.reserve(state->in.size());
         for(auto &i: state->in)
         {
-            auto e(get_exception_ptr(i));
-            if(e)
+            if(i.has_failed())
             {
                 if(rethrow)
                 {
-                    state->out.set_exception(e);
-                    return;
+                    state->out.set_exception(i.get_exception_ptr());
+                    return std::make_pair(true, handle_ptr());
                 }
                 ret.push_back(handle_ptr());
             }
             else
                 ret.push_back(i.get());
         }
-        state->out.set_value(ret);
+        state->out.set_value(std::move(ret));
+        return std::make_pair(true, handle_ptr());
     }
     template<bool rethrow, class Iterator> inline stl_future<std::vector<handle_ptr>> when_all_ops(Iterator first, Iterator last)
     {
-        auto state=std::make_shared<when_all_state>();
-        state->in.reserve(std::distance(first, last));
-        for(; first!=last; ++first)
-            state->in.push_back(first->_h);
+        std::vector<future<>> ops(first, last);
+        auto state=std::make_shared<when_all_state>(ops.size());
+        state->in.reserve(ops.size());
+        for(auto &op : ops)
+            state->in.push_back(op._h);
         auto ret=state->out.get_future();
-        process_threadpool()->enqueue([BOOST_AFIO_LAMBDA_MOVE_CAPTURE(state)] { when_all_ops_do<rethrow>(std::move(state)); });
+        dispatcher *d=when_ops_dispatcher(ops);
+        if(!d)
+        {
+            state->out.set_exception(BOOST_AFIO_V2_NAMESPACE::make_exception_ptr(std::invalid_argument("Inputs are invalid.")));
+            return ret;
+        }
+        d->completion(ops, [state](size_t id, future<> h) { return when_all_ops_do<rethrow>(state, id, std::move(h)); }, async_op_flags::immediate);
         return ret;
     }
     struct when_any_state : std::enable_shared_from_this<when_any_state>
     {
         atomic<size_t> count;
         promise<handle_ptr> out;
-        std::vector<shared_future<handle_ptr>> in;
+        std::vector<handle_future> in;
         when_any_state() : count(0) { }
     };
-#if BOOST_AFIO_USE_BOOST_THREAD
-    // Boost.Thread has wait_for_any() which lets us be more efficient here and wait directly on the futures
-    template<bool rethrow> inline void when_any_ops_do(std::shared_ptr<when_any_state> state)
-    {
-        auto &i=*boost::wait_for_any(state->in.begin(), state->in.end());
-        auto e(get_exception_ptr(i));
-        if(e)
-        {
-            if(rethrow)
-            {
-                state->out.set_exception(e);
-                return;
-            }
-            state->out.set_value(handle_ptr());
-        }
-        else
-            state->out.set_value(i.get());
-    }
-    template<bool rethrow, class Iterator> inline stl_future<handle_ptr> when_any_ops(Iterator first, Iterator last)
-    {
-        auto state=std::make_shared<when_any_state>();
-        state->in.reserve(std::distance(first, last));
-        for(; first!=last; ++first)
-            state->in.push_back(first->h);
-        auto ret=state->out.get_future();
-        process_threadpool()->enqueue([BOOST_AFIO_LAMBDA_MOVE_CAPTURE(state)]{ when_any_ops_do<rethrow>(std::move(state)); });
-        return ret;
-    }
-#else
-    // Without wait_for_any, schedule a completion onto every op and the first to fire wins
+    // Schedule a completion onto every op and the first to fire wins
     template<bool rethrow> inline std::pair<bool, handle_ptr> when_any_ops_do(std::shared_ptr<when_any_state> state, size_t idx, size_t id, future<> h)
     {
         auto &i=state->in[idx];
         if(0==state->count.fetch_add(1, memory_order_relaxed))  // Will be zero exactly once
         {
-            auto e(get_exception_ptr(i));
-            if(e)
+            if(i.has_failed())
             {
                 if(rethrow)
                 {
-                    state->out.set_exception(e);
+                    state->out.set_exception(i.get_exception_ptr());
                     return std::make_pair(true, handle_ptr());
                 }
                 state->out.set_value(handle_ptr());
@@ -2520,21 +3935,25 @@ namespace detail
     template<bool rethrow, class Iterator> inline stl_future<handle_ptr> when_any_ops(Iterator first, Iterator last)
     {
         auto state=std::make_shared<when_any_state>();
-        auto dispatcher=first->parent();
         std::vector<future<>> ops(first, last);
         state->in.reserve(ops.size());
         for(auto &op : ops)
             state->in.push_back(op._h);
         auto ret=state->out.get_future();
+        dispatcher *d=when_ops_dispatcher(ops);
+        if(!d)
+        {
+            state->out.set_exception(BOOST_AFIO_V2_NAMESPACE::make_exception_ptr(std::invalid_argument("Inputs are invalid.")));
+            return ret;
+        }
         typedef std::function<typename dispatcher::completion_t> ft;
         std::vector<std::pair<async_op_flags, ft>> completions;
         completions.reserve(ops.size());
         for(size_t n=0; n<ops.size(); n++)
           completions.push_back(std::make_pair(async_op_flags::immediate, std::bind(&when_any_ops_do<rethrow>, state, n, std::placeholders::_1, std::placeholders::_2)));
-        dispatcher->completion(ops, completions);
+        d->completion(ops, completions);
         return ret;
     }
-#endif
     template<bool is_all> struct select_when_ops_return_type
     {
         typedef stl_future<std::vector<handle_ptr>> type; // when_all_p()
@@ -3595,6 +5014,72 @@ template<class C, class... Args> inline future<typename std::result_of<C(Args...
     return call(req, std::function<rettype()>(std::bind<rettype>(callback, args...)));
 }
 
+#if BOOST_AFIO_HAVE_COROUTINES
+namespace detail
+{
+    /* Suspends a coroutine until an op completes by chaining an immediate completion onto it which
+    resumes the coroutine, so no thread ever blocks. The completion only captures this, so it is
+    stored inline within the op and a co_await allocates nothing beyond the op itself. If the op had already completed the completion
+    runs before the dispatcher returns, in which case we don't suspend at all rather than resuming
+    from within await_suspend(), as a loop over many ready futures would otherwise recurse.
+    */
+    template<class F> struct future_awaiter
+    {
+        F f;
+        std::coroutine_handle<> waiter;
+        atomic<int> state;  // 0 while registering, 1 once suspended, 2 if completed while registering
+        explicit future_awaiter(F _f) : f(std::forward<F>(_f)), state(0) { }
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> h)
+        {
+            waiter=h;
+            dispatcher *d=f.parent();
+            if(!d)
+                d=current_dispatcher().get();
+            d->completion(f, [this](size_t, future<> op) -> std::pair<bool, handle_ptr> {
+                handle_ptr ret(op.get_handle(true));
+                int expected=0;
+                // Once resumed we may no longer exist, so touch nothing of ours afterwards
+                if(!state.compare_exchange_strong(expected, 2))
+                    waiter.resume();
+                return std::make_pair(true, std::move(ret));
+            }, async_op_flags::immediate);
+            int expected=0;
+            return state.compare_exchange_strong(expected, 1);
+        }
+        auto await_resume() -> decltype(f.get()) { return f.get(); }
+    };
+}
+
+/*! \brief Suspends the calling coroutine until the op completes, then returns the same as `get()` would.
+
+The coroutine is resumed upon whichever thread completes the op, so a few threads can service
+very many concurrent coroutines. Because that thread is busy running the coroutine until it
+next suspends or finishes, avoid blocking calls between co_awaits. For example:
+\code
+task copy_header(dispatcher_ptr dispatcher, path src) // task is any coroutine return type
+{
+    char buffer[4096];
+    auto fh=dispatcher->file(path_req(src, file_flags::read));
+    auto rd=dispatcher->read(make_io_req(fh, buffer, sizeof(buffer), 0));
+    co_await rd;  // rethrows any error
+    ...
+}
+\endcode
+Only available if BOOST_AFIO_HAVE_COROUTINES is defined to 1, which it is if C++20 coroutines are available.
+\ingroup future
+*/
+template<class T> inline detail::future_awaiter<future<T> &> operator co_await(future<T> &f)
+{
+    return detail::future_awaiter<future<T> &>(f);
+}
+//! \overload
+template<class T> inline detail::future_awaiter<future<T>> operator co_await(future<T> &&f)
+{
+    return detail::future_awaiter<future<T>>(std::move(f));
+}
+#endif
+
 inline future<> dispatcher::adopt(handle_ptr h)
 {
     std::vector<handle_ptr> i;
@@ -3756,6 +5241,19 @@ inline future<> dispatcher::depends(future<> precondition, future<> op)
 
 namespace detail
 {
+  // Set by the synchronous functions below, which wait upon the op they schedule straight away. The
+  // next op scheduled by this thread runs on it at once if nothing holds it back, saving two context
+  // switches, and still goes through filters and completions as usual.
+  inline bool &run_next_op_inline()
+  {
+    static BOOST_AFIO_THREAD_LOCAL bool v;
+    return v;
+  }
+  struct inline_op_scope
+  {
+    inline_op_scope() { run_next_op_inline()=true; }
+    ~inline_op_scope() { run_next_op_inline()=false; }
+  };
   template<class T> struct async_dir
   {
     T path;
@@ -4081,6 +5579,7 @@ template<class T, typename=typename std::enable_if<detail::is_not_handle<T>::val
 */
 template<class T> inline handle_ptr dir(future<> _precondition, T _path, file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   return detail::async_dir<T>(std::move(_path), _flags)(std::move(_precondition)).get_handle();
 }
 /*! \brief Synchronous directory creation and open after an optional precondition.
@@ -4103,6 +5602,7 @@ template<class T> inline handle_ptr dir(future<> _precondition, T _path, file_fl
 */
 template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::value>::type> inline handle_ptr dir(T _path, file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   return detail::async_dir<T>(std::move(_path), _flags)(future<>()).get_handle();
 }
 /*! \brief Synchronous directory creation and open after an optional precondition.
@@ -4127,6 +5627,7 @@ template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::v
 */
 template<class T> inline handle_ptr dir(error_code &_ec, future<> _precondition, T _path, file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   return detail::async_dir<T>(std::move(_path), _flags)(std::move(_precondition)).get_handle(_ec);
 }
 /*! \brief Synchronous directory creation and open after an optional precondition.
@@ -4150,6 +5651,7 @@ template<class T> inline handle_ptr dir(error_code &_ec, future<> _precondition,
 */
 template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::value>::type> inline handle_ptr dir(error_code &_ec, T _path, file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   return detail::async_dir<T>(std::move(_path), _flags)(future<>()).get_handle(_ec);
 }
 
@@ -4222,6 +5724,7 @@ template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::v
 */
 template<class T=path> inline void rmdir(future<> _precondition, T _path = path(), file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   detail::async_rmdir<T>(std::move(_path), _flags)(std::move(_precondition)).get_handle();
 }
 /*! \brief Synchronous directory deletion after an optional precondition.
@@ -4243,6 +5746,7 @@ template<class T=path> inline void rmdir(future<> _precondition, T _path = path(
 */
 template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::value>::type> inline void rmdir(T _path, file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   detail::async_rmdir<T>(std::move(_path), _flags)(future<>()).get_handle();
 }
 /*! \brief Synchronous directory deletion after an optional precondition.
@@ -4268,6 +5772,7 @@ template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::v
 */
 template<class T=path> inline void rmdir(error_code &_ec, future<> _precondition, T _path = path(), file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   detail::async_rmdir<T>(std::move(_path), _flags)(std::move(_precondition)).get_handle(_ec);
 }
 /*! \brief Synchronous directory deletion after an optional precondition.
@@ -4290,6 +5795,7 @@ template<class T=path> inline void rmdir(error_code &_ec, future<> _precondition
 */
 template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::value>::type> inline void rmdir(error_code &_ec, T _path, file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   detail::async_rmdir<T>(std::move(_path), _flags)(future<>()).get_handle(_ec);
 }
 
@@ -4361,6 +5867,7 @@ template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::v
 */
 template<class T> inline handle_ptr file(future<> _precondition, T _path, file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   return detail::async_file<T>(std::move(_path), _flags)(std::move(_precondition)).get_handle();
 }
 /*! \brief Synchronous file creation and open after an optional precondition.
@@ -4383,6 +5890,7 @@ template<class T> inline handle_ptr file(future<> _precondition, T _path, file_f
 */
 template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::value>::type> inline handle_ptr file(T _path, file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   return detail::async_file<T>(std::move(_path), _flags)(future<>()).get_handle();
 }
 /*! \brief Synchronous file creation and open after an optional precondition.
@@ -4408,6 +5916,7 @@ template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::v
 */
 template<class T> inline handle_ptr file(error_code &_ec, future<> _precondition, T _path, file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   return detail::async_file<T>(std::move(_path), _flags)(std::move(_precondition)).get_handle(_ec);
 }
 /*! \brief Synchronous file creation and open after an optional precondition.
@@ -4431,6 +5940,7 @@ template<class T> inline handle_ptr file(error_code &_ec, future<> _precondition
 */
 template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::value>::type> inline handle_ptr file(error_code &_ec, T _path, file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   return detail::async_file<T>(std::move(_path), _flags)(future<>()).get_handle(_ec);
 }
 
@@ -4503,6 +6013,7 @@ template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::v
 */
 template<class T=path> inline void rmfile(future<> _precondition, T _path = path(), file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   detail::async_rmfile<T>(std::move(_path), _flags)(std::move(_precondition)).get_handle();
 }
 /*! \brief Synchronous file deletion after an optional precondition.
@@ -4524,6 +6035,7 @@ template<class T=path> inline void rmfile(future<> _precondition, T _path = path
 */
 template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::value>::type> inline void rmfile(T _path, file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   detail::async_rmfile<T>(std::move(_path), _flags)(future<>()).get_handle();
 }
 /*! \brief Synchronous file deletion after an optional precondition.
@@ -4549,6 +6061,7 @@ template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::v
 */
 template<class T=path> inline void rmfile(error_code &_ec, future<> _precondition, T _path = path(), file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   detail::async_rmfile<T>(std::move(_path), _flags)(std::move(_precondition)).get_handle(_ec);
 }
 /*! \brief Synchronous file deletion after an optional precondition.
@@ -4571,6 +6084,7 @@ template<class T=path> inline void rmfile(error_code &_ec, future<> _preconditio
 */
 template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::value>::type> inline void rmfile(error_code &_ec, T _path, file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   detail::async_rmfile<T>(std::move(_path), _flags)(future<>()).get_handle(_ec);
 }
 
@@ -4646,6 +6160,7 @@ template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::v
 */
 template<class T> inline handle_ptr symlink(future<> _precondition, T _path, future<> _target = future<>(), file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   return detail::async_symlink<T>(std::move(_path), _flags, std::move(_target))(std::move(_precondition)).get_handle();
 }
 /*! \brief Synchronous symlink creation and open after a precondition.
@@ -4669,6 +6184,7 @@ template<class T> inline handle_ptr symlink(future<> _precondition, T _path, fut
 */
 template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::value>::type> inline handle_ptr symlink(T _path, future<> _target = future<>(), file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   return detail::async_symlink<T>(std::move(_path), _flags, std::move(_target))(future<>()).get_handle();
 }
 /*! \brief Synchronous symlink creation and open after a precondition.
@@ -4695,6 +6211,7 @@ template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::v
 */
 template<class T> inline handle_ptr symlink(error_code &_ec, future<> _precondition, T _path, future<> _target = future<>(), file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   return detail::async_symlink<T>(std::move(_path), _flags, std::move(_target))(std::move(_precondition)).get_handle(_ec);
 }
 /*! \brief Synchronous symlink creation and open after a precondition.
@@ -4719,6 +6236,7 @@ template<class T> inline handle_ptr symlink(error_code &_ec, future<> _precondit
 */
 template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::value>::type> inline handle_ptr symlink(error_code &_ec, T _path, future<> _target = future<>(), file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   return detail::async_symlink<T>(std::move(_path), _flags, std::move(_target))(future<>()).get_handle(_ec);
 }
 
@@ -4791,6 +6309,7 @@ template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::v
 */
 template<class T=path> inline void rmsymlink(future<> _precondition, T _path = path(), file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   detail::async_rmsymlink<T>(std::move(_path), _flags)(std::move(_precondition)).get_handle();
 }
 /*! \brief Synchronous symlink deletion after an optional precondition.
@@ -4812,6 +6331,7 @@ template<class T=path> inline void rmsymlink(future<> _precondition, T _path = p
 */
 template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::value>::type> inline void rmsymlink(T _path, file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   detail::async_rmsymlink<T>(std::move(_path), _flags)(future<>()).get_handle();
 }
 /*! \brief Synchronous symlink deletion after an optional precondition.
@@ -4837,6 +6357,7 @@ template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::v
 */
 template<class T=path> inline void rmsymlink(error_code &_ec, future<> _precondition, T _path = path(), file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   detail::async_rmsymlink<T>(std::move(_path), _flags)(std::move(_precondition)).get_handle(_ec);
 }
 /*! \brief Synchronous symlink deletion after an optional precondition.
@@ -4859,6 +6380,7 @@ template<class T=path> inline void rmsymlink(error_code &_ec, future<> _precondi
 */
 template<class T, typename = typename std::enable_if<detail::is_not_handle<T>::value>::type> inline void rmsymlink(error_code &_ec, T _path, file_flags _flags = file_flags::none)
 {
+  detail::inline_op_scope inlined;
   detail::async_rmsymlink<T>(std::move(_path), _flags)(future<>()).get_handle(_ec);
 }
 
@@ -4891,6 +6413,7 @@ inline future<> async_sync(future<> _precondition)
 */
 inline void sync(future<> _precondition)
 {
+  detail::inline_op_scope inlined;
   detail::async_sync()(std::move(_precondition)).get_handle();
 }
 /*! \brief Synchronous content synchronisation with physical storage after a preceding operation.
@@ -4906,6 +6429,7 @@ inline void sync(future<> _precondition)
 */
 inline void sync(error_code &_ec, future<> _precondition)
 {
+  detail::inline_op_scope inlined;
   detail::async_sync()(std::move(_precondition)).get_handle(_ec);
 }
 
@@ -4940,6 +6464,7 @@ inline future<> async_zero(future<> _precondition, std::vector<std::pair<off_t,
 */
 inline void zero(future<> _precondition, std::vector<std::pair<off_t, off_t>> ranges)
 {
+  detail::inline_op_scope inlined;
   detail::async_zero(std::move(ranges))(std::move(_precondition)).get_handle();
 }
 /*! \brief Synchronous zeroing and deallocation of physical storage ("hole punching") after a preceding operation.
@@ -4957,6 +6482,7 @@ inline void zero(future<> _precondition, std::vector<std::pair<off_t, off_t>> ra
 */
 inline void zero(error_code &_ec, future<> _precondition, std::vector<std::pair<off_t, off_t>> ranges)
 {
+  detail::inline_op_scope inlined;
   detail::async_zero(std::move(ranges))(std::move(_precondition)).get_handle(_ec);
 }
 
@@ -4989,6 +6515,7 @@ inline future<> async_close(future<> _precondition)
 */
 inline void close(future<> _precondition)
 {
+  detail::inline_op_scope inlined;
   detail::async_close()(std::move(_precondition)).get_handle();
 }
 /*! \brief Synchronous file or directory handle close after a preceding operation.
@@ -5005,6 +6532,7 @@ inline void close(future<> _precondition)
 */
 inline void close(error_code &_ec, future<> _precondition)
 {
+  detail::inline_op_scope inlined;
   detail::async_close()(std::move(_precondition)).get_handle(_ec);
 }
 
@@ -5067,6 +6595,7 @@ template<class T> inline future<> async_read(future<> _precondition, T &&v, size
 */
 template<class T> inline void read(future<> _precondition, T &&v, off_t _where)
 {
+  detail::inline_op_scope inlined;
   detail::async_read(std::forward<T>(v), _where)(std::move(_precondition)).get_handle();
 }
 /*! \brief Synchronous data read after a preceding operation, where offset and total data read must not exceed the present file size.
@@ -5087,6 +6616,7 @@ template<class T> inline void read(future<> _precondition, T &&v, off_t _where)
 */
 template<class T> inline void read(future<> _precondition, T &&v, size_t _length, off_t _where)
 {
+  detail::inline_op_scope inlined;
   detail::async_read(std::forward<T>(v), _length, _where)(std::move(_precondition)).get_handle();
 }
 /*! \brief Synchronous data read after a preceding operation, where offset and total data read must not exceed the present file size.
@@ -5107,6 +6637,7 @@ template<class T> inline void read(future<> _precondition, T &&v, size_t _length
 */
 template<class T> inline void read(error_code &_ec, future<> _precondition, T &&v, off_t _where)
 {
+  detail::inline_op_scope inlined;
   detail::async_read(std::forward<T>(v), _where)(std::move(_precondition)).get_handle(_ec);
 }
 /*! \brief Synchronous data read after a preceding operation, where offset and total data read must not exceed the present file size.
@@ -5128,6 +6659,7 @@ template<class T> inline void read(error_code &_ec, future<> _precondition, T &&
 */
 template<class T> inline void read(error_code &_ec, future<> _precondition, T &&v, size_t _length, off_t _where)
 {
+  detail::inline_op_scope inlined;
   detail::async_read(std::forward<T>(v), _length, _where)(std::move(_precondition)).get_handle(_ec);
 }
 
@@ -5190,6 +6722,7 @@ template<class T> inline future<> async_write(future<> _precondition, T &&v, siz
 */
 template<class T> inline void write(future<> _precondition, T &&v, off_t _where)
 {
+  detail::inline_op_scope inlined;
   detail::async_write(std::forward<T>(v), _where)(std::move(_precondition)).get_handle();
 }
 /*! \brief Synchronous data write after a preceding operation, where offset and total data written must not exceed the present file size.
@@ -5210,6 +6743,7 @@ template<class T> inline void write(future<> _precondition, T &&v, off_t _where)
 */
 template<class T> inline void write(future<> _precondition, T &&v, size_t _length, off_t _where)
 {
+  detail::inline_op_scope inlined;
   detail::async_write(std::forward<T>(v), _length, _where)(std::move(_precondition)).get_handle();
 }
 /*! \brief Synchronous data write after a preceding operation, where offset and total data written must not exceed the present file size.
@@ -5230,6 +6764,7 @@ template<class T> inline void write(future<> _precondition, T &&v, size_t _lengt
 */
 template<class T> inline void write(error_code &_ec, future<> _precondition, T &&v, off_t _where)
 {
+  detail::inline_op_scope inlined;
   detail::async_write(std::forward<T>(v), _where)(std::move(_precondition)).get_handle(_ec);
 }
 /*! \brief Synchronous data write after a preceding operation, where offset and total data written must not exceed the present file size.
@@ -5251,6 +6786,7 @@ template<class T> inline void write(error_code &_ec, future<> _precondition, T &
 */
 template<class T> inline void write(error_code &_ec, future<> _precondition, T &&v, size_t _length, off_t _where)
 {
+  detail::inline_op_scope inlined;
   detail::async_write(std::forward<T>(v), _length, _where)(std::move(_precondition)).get_handle(_ec);
 }
 
@@ -5285,6 +6821,7 @@ inline future<> async_truncate(future<> _precondition, off_t newsize)
 */
 inline void truncate(future<> _precondition, off_t newsize)
 {
+  detail::inline_op_scope inlined;
   auto h=detail::async_truncate(newsize)(std::move(_precondition)).get_handle();
 }
 /*! \brief Synchronous file length truncation after a preceding operation.
@@ -5302,6 +6839,7 @@ inline void truncate(future<> _precondition, off_t newsize)
 */
 inline void truncate(error_code &_ec, future<> _precondition, off_t newsize)
 {
+  detail::inline_op_scope inlined;
   auto h=detail::async_truncate(newsize)(std::move(_precondition)).get_handle(_ec);
 }
 
@@ -5362,6 +6900,7 @@ birthtim, sparse, compressed.]
 inline std::pair<std::vector<directory_entry>, bool> enumerate(future<> _precondition, size_t _maxitems = 2, bool _restart = true, path _glob = path(),
   metadata_flags _metadata = metadata_flags::None, enumerate_req::filter _filtering = enumerate_req::filter::fastdeleted)
 {
+  detail::inline_op_scope inlined;
   return detail::async_enumerate(_maxitems, _restart, std::move(_glob), _metadata, _filtering)(std::move(_precondition)).get();
 }
 /*! \brief Synchronous directory enumeration after a preceding operation.
@@ -5392,6 +6931,7 @@ birthtim, sparse, compressed.]
 inline std::pair<std::vector<directory_entry>, bool> enumerate(error_code &_ec, future<> _precondition, size_t _maxitems = 2, bool _restart = true, path _glob = path(),
   metadata_flags _metadata = metadata_flags::None, enumerate_req::filter _filtering = enumerate_req::filter::fastdeleted)
 {
+  detail::inline_op_scope inlined;
   auto ret= detail::async_enumerate(_maxitems, _restart, std::move(_glob), _metadata, _filtering)(std::move(_precondition));
   if(!(_ec=ret.get_error()))
     return ret.get();
@@ -5453,6 +6993,7 @@ birthtim, sparse, compressed.]
 inline std::pair<std::vector<directory_entry>, bool> enumerate(future<> _precondition, path _glob, size_t _maxitems = 2, bool _restart = true,
   metadata_flags _metadata = metadata_flags::None, enumerate_req::filter _filtering = enumerate_req::filter::fastdeleted)
 {
+  detail::inline_op_scope inlined;
   return detail::async_enumerate(_maxitems, _restart, std::move(_glob), _metadata, _filtering)(std::move(_precondition)).get();
 }
 /*! \brief Synchronous directory enumeration after a preceding operation.
@@ -5483,6 +7024,7 @@ birthtim, sparse, compressed.]
 inline std::pair<std::vector<directory_entry>, bool> enumerate(error_code &_ec, future<> _precondition, path _glob, size_t _maxitems = 2, bool _restart = true,
   metadata_flags _metadata = metadata_flags::None, enumerate_req::filter _filtering = enumerate_req::filter::fastdeleted)
 {
+  detail::inline_op_scope inlined;
   auto ret = detail::async_enumerate(_maxitems, _restart, std::move(_glob), _metadata, _filtering)(std::move(_precondition));
   if (!(_ec = ret.get_error()))
     return ret.get();
@@ -5544,6 +7086,7 @@ birthtim, sparse, compressed.]
 inline std::pair<std::vector<directory_entry>, bool> enumerate(future<> _precondition, metadata_flags _metadata, size_t _maxitems = 2,
   bool _restart = true, path _glob = path(), enumerate_req::filter _filtering = enumerate_req::filter::fastdeleted)
 {
+  detail::inline_op_scope inlined;
   return detail::async_enumerate(_maxitems, _restart, std::move(_glob), _metadata, _filtering)(std::move(_precondition)).get();
 }
 /*! \brief Synchronous directory enumeration after a preceding operation.
@@ -5574,6 +7117,7 @@ birthtim, sparse, compressed.]
 inline std::pair<std::vector<directory_entry>, bool> enumerate(error_code &_ec, future<> _precondition, metadata_flags _metadata, size_t _maxitems = 2,
   bool _restart = true, path _glob = path(), enumerate_req::filter _filtering = enumerate_req::filter::fastdeleted)
 {
+  detail::inline_op_scope inlined;
   auto ret = detail::async_enumerate(_maxitems, _restart, std::move(_glob), _metadata, _filtering)(std::move(_precondition));
   if (!(_ec = ret.get_error()))
     return ret.get();
@@ -5622,6 +7166,7 @@ into single extents.]
 */
 inline std::vector<std::pair<off_t, off_t>> extents(future<> _precondition)
 {
+  detail::inline_op_scope inlined;
   return detail::async_extents()(std::move(_precondition)).get();
 }
 /*! \brief Synchronous extent enumeration after a preceding operation.
@@ -5645,6 +7190,7 @@ into single extents.]
 */
 inline std::vector<std::pair<off_t, off_t>> extents(error_code &_ec, future<> _precondition)
 {
+  detail::inline_op_scope inlined;
   auto ret = detail::async_extents()(std::move(_precondition));
   if (!(_ec = ret.get_error()))
     return ret.get();
@@ -5697,6 +7243,7 @@ is fetched separately.]
 */
 inline statfs_t statfs(future<> _precondition, fs_metadata_flags req)
 {
+  detail::inline_op_scope inlined;
   return detail::async_statfs(req)(std::move(_precondition)).get();
 }
 /*! \brief Synchronous volume enumeration after a preceding operation.
@@ -5722,6 +7269,7 @@ is fetched separately.]
 */
 inline statfs_t statfs(error_code &_ec, future<> _precondition, fs_metadata_flags req)
 {
+  detail::inline_op_scope inlined;
   auto ret = detail::async_statfs(req)(std::move(_precondition));
   if (!(_ec = ret.get_error()))
     return ret.get();
@@ -471,6 +471,42 @@ BOOST_AFIO_V2_NAMESPACE_END
 # endif
 #endif
 
+// Whether future<> can be co_awaited, which needs C++20 coroutines
+#ifndef BOOST_AFIO_HAVE_COROUTINES
+# if defined(__cpp_impl_coroutine) && defined(__has_include)
+#  if __has_include(<coroutine>)
+#   define BOOST_AFIO_HAVE_COROUTINES 1
+#  endif
+# endif
+#endif
+#ifndef BOOST_AFIO_HAVE_COROUTINES
+# define BOOST_AFIO_HAVE_COROUTINES 0
+#endif
+
+// Whether the Linux dispatcher can be built upon io_uring, which needs the kernel's headers
+#ifndef BOOST_AFIO_HAVE_IO_URING
+# if defined(__linux__) && defined(__has_include)
+#  if __has_include(<linux/io_uring.h>)
+#   define BOOST_AFIO_HAVE_IO_URING 1
+#  endif
+# endif
+#endif
+#ifndef BOOST_AFIO_HAVE_IO_URING
+# define BOOST_AFIO_HAVE_IO_URING 0
+#endif
+
+// Whether the compat dispatcher can use Linux native AIO for O_DIRECT handles
+#ifndef BOOST_AFIO_HAVE_KAIO
+# if defined(__linux__) && defined(__has_include)
+#  if __has_include(<linux/aio_abi.h>) && __has_include(<sys/eventfd.h>)
+#   define BOOST_AFIO_HAVE_KAIO 1
+#  endif
+# endif
+#endif
+#ifndef BOOST_AFIO_HAVE_KAIO
+# define BOOST_AFIO_HAVE_KAIO 0
+#endif
+
 #ifndef BOOST_AFIO_THREAD_LOCAL
 # ifdef __cpp_thread_local
 #  define BOOST_AFIO_THREAD_LOCAL thread_local
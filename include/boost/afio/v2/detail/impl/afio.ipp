@@ -4,11 +4,19 @@ Provides a threadpool and asynchronous file i/o infrastructure based on Boost.AS
 File Created: Mar 2013
 */
 
-//#define BOOST_AFIO_USE_CONCURRENT_UNORDERED_MAP
 //#define BOOST_AFIO_MAX_NON_ASYNC_QUEUE_DEPTH 1
 
+// Define this to how many workers the process threadpool may grow to while its workers are blocked in syscalls
 #ifndef BOOST_AFIO_MAX_NON_ASYNC_QUEUE_DEPTH
-#define BOOST_AFIO_MAX_NON_ASYNC_QUEUE_DEPTH 8
+#define BOOST_AFIO_MAX_NON_ASYNC_QUEUE_DEPTH 64
+#endif
+// Define this to how many workers the process threadpool keeps once spawned. Zero means the number of CPUs.
+#ifndef BOOST_AFIO_MIN_NON_ASYNC_QUEUE_DEPTH
+#define BOOST_AFIO_MIN_NON_ASYNC_QUEUE_DEPTH 0
+#endif
+// Define this to how many shards the table of in flight ops is split into. Must be a power of two.
+#ifndef BOOST_AFIO_OP_TABLE_SHARDS
+#define BOOST_AFIO_OP_TABLE_SHARDS 64
 #endif
 //#define USE_POSIX_ON_WIN32 // Useful for testing
 
@@ -31,6 +39,11 @@ File Created: Mar 2013
     #define BOOST_AFIO_OP_STACKBACKTRACEDEPTH 8
   #endif
 #endif
+// Define this to have only one in every N ops scheduled by each thread take that backtrace, or to zero for none.
+// Backtraces are only symbolised when printed, so this bounds the cost of keeping them on under load.
+#ifndef BOOST_AFIO_OP_STACKBACKTRACESAMPLE
+  #define BOOST_AFIO_OP_STACKBACKTRACESAMPLE 1
+#endif
 // Right now only Windows, Linux and FreeBSD supported
 #if (!defined(__linux__) && !defined(__FreeBSD__) && !defined(WIN32)) || defined(BOOST_AFIO_COMPILING_FOR_GCOV)
 #  undef BOOST_AFIO_OP_STACKBACKTRACEDEPTH
@@ -199,6 +212,20 @@ BOOST_AFIO_V2_NAMESPACE_END
 #ifdef __linux__
 # include <sys/statfs.h>
 # include <mntent.h>
+# include <sched.h>
+# include <pthread.h>
+# include <linux/futex.h>
+# if BOOST_AFIO_HAVE_IO_URING
+#  include <linux/io_uring.h>
+# endif
+# if BOOST_AFIO_HAVE_KAIO
+#  include <linux/aio_abi.h>
+#  include <sys/eventfd.h>
+#  include <sys/ioctl.h>
+#  ifndef BLKSSZGET  // <linux/fs.h> clashes with <sys/mount.h>
+#   define BLKSSZGET _IO(0x12, 104)
+#  endif
+# endif
 #endif
 #include <limits.h>
 // Does this POSIX provides at(dirh) support?
@@ -299,15 +326,31 @@ BOOST_AFIO_V2_NAMESPACE_END
 #endif
 
 #ifdef BOOST_AFIO_OP_STACKBACKTRACEDEPTH
+BOOST_AFIO_V2_NAMESPACE_BEGIN
+// Just the raw return addresses, so capturing one neither allocates nor looks up any symbols
+struct stack_type
+{
+  void *frames[BOOST_AFIO_OP_STACKBACKTRACEDEPTH];
+  size_t count;
+  stack_type() : count(0) { }
+  void *const *begin() const { return frames; }
+  void *const *end() const { return frames+count; }
+  bool empty() const { return !count; }
+};
+// Whether the next op scheduled by this thread should take a backtrace
+inline bool sample_stack()
+{
+  static BOOST_AFIO_THREAD_LOCAL size_t scheduled;
+  return BOOST_AFIO_OP_STACKBACKTRACESAMPLE && !(scheduled++ % (BOOST_AFIO_OP_STACKBACKTRACESAMPLE ? BOOST_AFIO_OP_STACKBACKTRACESAMPLE : 1));
+}
+BOOST_AFIO_V2_NAMESPACE_END
 #  ifdef WIN32
 BOOST_AFIO_V2_NAMESPACE_BEGIN
-typedef std::vector<void *> stack_type;
 inline void collect_stack(stack_type &stack)
 {
   windows_nt_kernel::init();
   using namespace windows_nt_kernel;
-  stack.resize(BOOST_AFIO_OP_STACKBACKTRACEDEPTH);
-  stack.resize(RtlCaptureStackBackTrace(0, (ULONG) stack.size(), &stack.front(), nullptr));
+  stack.count=RtlCaptureStackBackTrace(0, BOOST_AFIO_OP_STACKBACKTRACEDEPTH, stack.frames, nullptr);
 }
 inline void print_stack(std::ostream &s, const stack_type &stack)
 {
@@ -350,7 +393,6 @@ BOOST_AFIO_V2_NAMESPACE_END
 #      endif
 #    endif
 BOOST_AFIO_V2_NAMESPACE_BEGIN
-typedef std::vector<void *> stack_type;
 inline void collect_stack(stack_type &stack)
 {
 #ifdef UNW_LOCAL_ONLY
@@ -358,18 +400,16 @@ inline void collect_stack(stack_type &stack)
   unw_context_t uc;
   unw_cursor_t cursor;
   unw_getcontext(&uc);
-  stack.reserve(BOOST_AFIO_OP_STACKBACKTRACEDEPTH);
   unw_init_local(&cursor, &uc);
-  size_t n=0;
-  while(unw_step(&cursor)>0 && n++<BOOST_AFIO_OP_STACKBACKTRACEDEPTH)
+  stack.count=0;
+  while(unw_step(&cursor)>0 && stack.count<BOOST_AFIO_OP_STACKBACKTRACEDEPTH)
   {
       unw_word_t ip;
       unw_get_reg(&cursor, UNW_REG_IP, &ip);
-      stack.push_back((void *) ip);
+      stack.frames[stack.count++]=(void *) ip;
   }
 #else
-  stack.resize(BOOST_AFIO_OP_STACKBACKTRACEDEPTH);
-  stack.resize(backtrace(&stack.front(), stack.size()));
+  stack.count=backtrace(stack.frames, BOOST_AFIO_OP_STACKBACKTRACEDEPTH);
 #endif
 }
 extern "C" const char *__progname;
@@ -495,58 +535,1079 @@ inline ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
         if(-1==(transferred=_write(fd, iov->iov_base, (unsigned) iov->iov_len))) return -1;
     return (ssize_t)(at);
 }
-BOOST_AFIO_V2_NAMESPACE_END
+BOOST_AFIO_V2_NAMESPACE_END
+
+#elif !defined(IOV_MAX) || defined(__APPLE__)  // Android lacks preadv() and pwritev()
+BOOST_AFIO_V2_NAMESPACE_BEGIN
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+struct iovec {
+    void  *iov_base;    /* Starting address */
+    size_t iov_len;     /* Number of bytes to transfer */
+};
+typedef ptrdiff_t ssize_t;
+#endif
+inline ssize_t preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    off_t at=offset;
+    ssize_t transferred;
+    for(; iovcnt; iov++, iovcnt--, at+=(off_t) transferred)
+        if(-1==(transferred=pread(fd, iov->iov_base, (unsigned) iov->iov_len, at))) return -1;
+    return (ssize_t)(at-offset);
+}
+inline ssize_t pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    off_t at=offset;
+    ssize_t transferred;
+    for(; iovcnt; iov++, iovcnt--, at+=(off_t) transferred)
+        if(-1==(transferred=pwrite(fd, iov->iov_base, (unsigned) iov->iov_len, at))) return -1;
+    return (ssize_t)(at-offset);
+}
+BOOST_AFIO_V2_NAMESPACE_END
+
+#endif
+
+
+BOOST_AFIO_V2_NAMESPACE_BEGIN
+
+namespace detail {
+    BOOST_AFIO_HEADERS_ONLY_FUNC_SPEC std::vector<std::vector<unsigned>> numa_nodes()
+    {
+        std::vector<std::vector<unsigned>> ret;
+#if defined(WIN32)
+        ULONG highest=0;
+        if(GetNumaHighestNodeNumber(&highest))
+        {
+            for(ULONG node=0; node<=highest; node++)
+            {
+                ULONGLONG mask=0;
+                std::vector<unsigned> cpus;
+                if(GetNumaNodeProcessorMask((UCHAR) node, &mask))
+                    for(unsigned cpu=0; cpu<64; cpu++)
+                        if(mask&(1ULL<<cpu))
+                            cpus.push_back(cpu);
+                if(!cpus.empty())
+                    ret.push_back(std::move(cpus));
+            }
+        }
+#elif defined(__linux__)
+        // Only CPUs we are allowed to run upon are of any use
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if(-1==sched_getaffinity(0, sizeof(allowed), &allowed))
+            for(unsigned cpu=0; cpu<CPU_SETSIZE; cpu++)
+                CPU_SET(cpu, &allowed);
+        for(unsigned node=0;; node++)
+        {
+            char buffer[4096];
+            sprintf(buffer, "/sys/devices/system/node/node%u/cpulist", node);
+            FILE *ih=fopen(buffer, "r");
+            if(!ih)
+                break;
+            size_t length=fread(buffer, 1, sizeof(buffer)-1, ih);
+            fclose(ih);
+            buffer[length]=0;
+            // A list of CPUs and ranges of CPUs, e.g. 0-7,16-23
+            std::vector<unsigned> cpus;
+            for(char *s=buffer; *s>='0' && *s<='9';)
+            {
+                unsigned first=(unsigned) strtoul(s, &s, 10), last=first;
+                if('-'==*s)
+                    last=(unsigned) strtoul(s+1, &s, 10);
+                for(unsigned cpu=first; cpu<=last && cpu<CPU_SETSIZE; cpu++)
+                    if(CPU_ISSET(cpu, &allowed))
+                        cpus.push_back(cpu);
+                if(','==*s)
+                    ++s;
+            }
+            if(!cpus.empty())
+                ret.push_back(std::move(cpus));
+        }
+        if(ret.empty())
+        {
+            std::vector<unsigned> cpus;
+            for(unsigned cpu=0; cpu<CPU_SETSIZE; cpu++)
+                if(CPU_ISSET(cpu, &allowed))
+                    cpus.push_back(cpu);
+            if(!cpus.empty())
+                ret.push_back(std::move(cpus));
+        }
+#endif
+        if(ret.empty())
+        {
+            std::vector<unsigned> cpus;
+            for(unsigned cpu=0; cpu<thread::hardware_concurrency(); cpu++)
+                cpus.push_back(cpu);
+            if(cpus.empty())
+                cpus.push_back(0);
+            ret.push_back(std::move(cpus));
+        }
+        return ret;
+    }
+    BOOST_AFIO_HEADERS_ONLY_FUNC_SPEC bool pin_this_thread(const std::vector<unsigned> &cpus) noexcept
+    {
+#if defined(WIN32)
+        DWORD_PTR mask=0;
+        for(auto cpu: cpus)
+            if(cpu<sizeof(mask)*8)
+                mask|=(DWORD_PTR) 1<<cpu;
+        return mask && SetThreadAffinityMask(GetCurrentThread(), mask);
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for(auto cpu: cpus)
+            if(cpu<CPU_SETSIZE)
+                CPU_SET(cpu, &set);
+        return !pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+        (void) cpus;
+        return false;
+#endif
+    }
+    BOOST_AFIO_HEADERS_ONLY_FUNC_SPEC int this_thread_cpu() noexcept
+    {
+#if defined(WIN32)
+        return (int) GetCurrentProcessorNumber();
+#elif defined(__linux__)
+        return sched_getcpu();
+#else
+        return -1;
+#endif
+    }
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC thread_cpu_clock::thread_cpu_clock() noexcept : _h(0), _valid(false)
+    {
+#if defined(WIN32)
+        HANDLE h=OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, GetCurrentThreadId());
+        if(h)
+        {
+            _h=(intptr_t) h;
+            _valid=true;
+        }
+#elif defined(__linux__)
+        clockid_t id;
+        if(!pthread_getcpuclockid(pthread_self(), &id))
+        {
+            _h=(intptr_t) id;
+            _valid=true;
+        }
+#endif
+    }
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC thread_cpu_clock::~thread_cpu_clock()
+    {
+#if defined(WIN32)
+        if(_valid)
+            CloseHandle((HANDLE) _h);
+#endif
+    }
+    BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC chrono::nanoseconds thread_cpu_clock::now() const noexcept
+    {
+        if(!_valid)
+            return chrono::nanoseconds(-1);
+#if defined(WIN32)
+        FILETIME created, exited, kernel, user;
+        if(!GetThreadTimes((HANDLE) _h, &created, &exited, &kernel, &user))
+            return chrono::nanoseconds(-1);
+        auto ticks=[](const FILETIME &t){ return ((unsigned long long) t.dwHighDateTime<<32)|t.dwLowDateTime; };
+        // FILETIME counts in units of 100ns
+        return chrono::nanoseconds((long long)(ticks(kernel)+ticks(user))*100);
+#elif defined(__linux__)
+        struct timespec ts;
+        if(clock_gettime((clockid_t) _h, &ts))
+            return chrono::nanoseconds(-1);
+        return chrono::nanoseconds((long long) ts.tv_sec*1000000000LL+ts.tv_nsec);
+#else
+        return chrono::nanoseconds(-1);
+#endif
+    }
+#ifndef __linux__
+    // Without futexes sleepers wait on one of a fixed set of condition variables chosen by address
+    struct parking_bucket
+    {
+        mutex lock;
+        condition_variable cv;
+    };
+    static inline parking_bucket &parking_bucket_for(const void *addr) noexcept
+    {
+        static parking_bucket buckets[64];
+        return buckets[(reinterpret_cast<size_t>(addr)/sizeof(void *))%64];
+    }
+#endif
+    BOOST_AFIO_HEADERS_ONLY_FUNC_SPEC void park(const atomic<int> *addr, int expected, const chrono::steady_clock::time_point *deadline) noexcept
+    {
+#ifdef __linux__
+        struct timespec ts, *pts=nullptr;
+        if(deadline)
+        {
+            auto left=chrono::duration_cast<chrono::nanoseconds>(*deadline-chrono::steady_clock::now()).count();
+            if(left<=0)
+                return;
+            ts.tv_sec=(time_t)(left/1000000000);
+            ts.tv_nsec=(long)(left%1000000000);
+            pts=&ts;
+        }
+        // FUTEX_WAIT takes a timeout relative to CLOCK_MONOTONIC, which is what steady_clock uses
+        syscall(SYS_futex, reinterpret_cast<const int *>(addr), FUTEX_WAIT_PRIVATE, expected, pts, nullptr, 0);
+#else
+        parking_bucket &b=parking_bucket_for(addr);
+        unique_lock<mutex> g(b.lock);
+        // unpark_all() takes the same lock, so a change to *addr cannot slip in between checking and sleeping
+        if(addr->load(memory_order_acquire)!=expected)
+            return;
+        if(deadline)
+            b.cv.wait_until(g, *deadline);
+        else
+            b.cv.wait(g);
+#endif
+    }
+    BOOST_AFIO_HEADERS_ONLY_FUNC_SPEC void unpark_all(const atomic<int> *addr) noexcept
+    {
+#ifdef __linux__
+        syscall(SYS_futex, reinterpret_cast<const int *>(addr), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#else
+        parking_bucket &b=parking_bucket_for(addr);
+        lock_guard<mutex> g(b.lock);
+        b.cv.notify_all();
+#endif
+    }
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC std_thread_pool::std_thread_pool(size_t no, thread_placement _placement) : thread_source(service), working(detail::make_unique<asio::io_service::work>(service)), placement(_placement), nextcpu(0),
+    adaptive(false), bounds(no, no), alive(0), queued(0), running(0), blocked(0), inservice(0), idlers(0), progress(0), retiredblockedns(0), stopping(false), monitorstarted(false), monitorasleep(false)
+{
+    if(thread_placement::none!=placement)
+    {
+        auto topology=detail::numa_nodes();
+        for(size_t n=0; n<topology.size(); n++)
+        {
+            auto node=detail::make_unique<node_t>();
+            if(!n || thread_placement::numa_node!=placement)
+                node->service=&service;
+            else
+            {
+                node->ownservice=detail::make_unique<asio::io_service>();
+                node->service=node->ownservice.get();
+                node->working=detail::make_unique<asio::io_service::work>(*node->service);
+            }
+            for(auto cpu: topology[n])
+            {
+                if(cputonode.size()<=cpu)
+                    cputonode.resize(cpu+1, 0);
+                cputonode[cpu]=n;
+            }
+            node->cpus=std::move(topology[n]);
+            nodes.push_back(std::move(node));
+        }
+    }
+    add_workers(no);
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC std_thread_pool::std_thread_pool(thread_pool_bounds _bounds) : thread_source(service), working(detail::make_unique<asio::io_service::work>(service)), placement(thread_placement::none), nextcpu(0),
+    adaptive(true), bounds(_bounds), alive(0), queued(0), running(0), blocked(0), inservice(0), idlers(0), progress(0), retiredblockedns(0), stopping(false), monitorstarted(false), monitorasleep(false)
+{
+    // Workers and the monitor are spawned by int_enqueue() as work arrives
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void std_thread_pool::add_workers(size_t no)
+{
+    switch(placement)
+    {
+    case thread_placement::none:
+        if(adaptive)
+        {
+            lock_guard<mutex> g(workerslock);
+            bounds.min+=no;
+            if(bounds.max<bounds.min)
+                bounds.max=bounds.min;
+            for(; alive.load(memory_order_relaxed)<bounds.min; ++alive)
+                workers.push_back(detail::make_unique<thread>(worker(this)));
+            break;
+        }
+        workers.reserve(workers.size()+no);
+        for(size_t n=0; n<no; n++)
+            workers.push_back(detail::make_unique<thread>(worker(this)));
+        break;
+    case thread_placement::core:
+    {
+        size_t cpus=0;
+        for(auto &i: nodes)
+            cpus+=i->cpus.size();
+        workers.reserve(workers.size()+no);
+        for(size_t n=0; n<no; n++, nextcpu++)
+        {
+            size_t idx=nextcpu%cpus, node=0;
+            for(; idx>=nodes[node]->cpus.size(); idx-=nodes[node++]->cpus.size());
+            workers.push_back(detail::make_unique<thread>(worker(this, 0, std::vector<unsigned>(1, nodes[node]->cpus[idx]))));
+        }
+        break;
+    }
+    case thread_placement::numa_node:
+        workers.reserve(workers.size()+no*nodes.size());
+        for(size_t node=0; node<nodes.size(); node++)
+        {
+            nodes[node]->workers+=no;
+            for(size_t n=0; n<no; n++)
+                workers.push_back(detail::make_unique<thread>(worker(this, node, nodes[node]->cpus)));
+        }
+        break;
+    }
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void std_thread_pool::int_run(size_t node)
+{
+    if(adaptive)
+    {
+        int_run_adaptive();
+        return;
+    }
+    if(thread_placement::numa_node!=placement)
+    {
+        service.run();
+        return;
+    }
+    current_worker &c=int_current();
+    c.pool=this;
+    c.node=node;
+    node_t &n=*nodes[node];
+    // Count what runs so int_node_for_enqueue() can estimate how much work each node has waiting
+    while(n.service->run_one())
+        n.ran.fetch_add(1, memory_order_relaxed);
+}
+
+// Work enqueued by our own workers stays on their node, and work enqueued by anyone else goes to the
+// node of the CPU they are running upon, unless that node is already swamped
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC size_t std_thread_pool::int_node_for_enqueue()
+{
+    size_t home=0;
+    current_worker &c=int_current();
+    if(this==c.pool)
+        home=c.node;
+    else
+    {
+        int cpu=detail::this_thread_cpu();
+        if(cpu>=0 && (size_t) cpu<cputonode.size())
+            home=cputonode[cpu];
+    }
+    auto waiting=[](const node_t &n) -> size_t {
+        size_t posted=n.posted.load(memory_order_relaxed), ran=n.ran.load(memory_order_relaxed);
+        // Anything posted straight to the io_service runs without being posted by us
+        return posted>ran ? posted-ran : 0;
+    };
+    if(waiting(*nodes[home])<=2*nodes[home]->workers)
+        return home;
+    size_t best=home, bestwaiting=(size_t) -1;
+    for(size_t n=0; n<nodes.size(); n++)
+    {
+        size_t w=waiting(*nodes[n])/(nodes[n]->workers ? nodes[n]->workers : 1);
+        if(w<bestwaiting)
+        {
+            best=n;
+            bestwaiting=w;
+        }
+    }
+    return best;
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void std_thread_pool::int_run_adaptive()
+{
+    worker_record record;
+    {
+        lock_guard<mutex> g(workerslock);
+        records.push_back(&record);
+    }
+    current_worker &c=int_current();
+    c.pool=this;
+    c.node=0;
+    c.record=&record;
+    for(;;)
+    {
+        if(service.poll_one())
+            continue;
+        if(stopping)
+            break;
+        // Workers beyond the minimum wait where int_enqueue() can wake them and exit if nothing comes, so long
+        // as some other worker waits inside the io_service for anything posted straight to it
+        if(alive.load(memory_order_relaxed)>bounds.min && inservice)
+        {
+            bool woken;
+            {
+                unique_lock<mutex> g(idlelock);
+                // Pairs with the increment of queued followed by the check of idlers in int_enqueue()
+                ++idlers;
+                woken=idlecv.wait_for(g, bounds.idle_timeout, [this]{ return stopping || queued; });
+                --idlers;
+            }
+            if(woken)
+                continue;
+            size_t a=alive.load(memory_order_relaxed);
+            if(a>bounds.min && alive.compare_exchange_strong(a, a-1, memory_order_relaxed))
+            {
+                // Whoever next spawns a worker or destroys the pool joins us
+                lock_guard<mutex> g(workerslock);
+                auto me=this_thread::get_id();
+                for(auto it=workers.begin(); it!=workers.end(); ++it)
+                    if((*it)->get_id()==me)
+                    {
+                        retired.push_back(std::move(*it));
+                        workers.erase(it);
+                        break;
+                    }
+                break;
+            }
+            continue;
+        }
+        ++inservice;
+        size_t ran=service.run_one();
+        --inservice;
+        if(!ran)
+            break;
+    }
+    c.pool=nullptr;
+    c.record=nullptr;
+    lock_guard<mutex> g(workerslock);
+    records.erase(std::find(records.begin(), records.end(), &record));
+    retiredblockedns+=record.blockedns.load(memory_order_relaxed);
+}
+
+// Workers stuck in something other than a syscall we know blocks never ask for help, so this watches for work
+// waiting a whole stall timeout without any worker starting or finishing anything. Workers busy running long
+// CPU bound work look just the same, so the pool only grows if none of them used the CPU meanwhile.
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void std_thread_pool::int_monitor()
+{
+    detail::set_threadname("boost::afio::std_thread_pool monitor");
+    unique_lock<mutex> g(monitorlock);
+    while(!stopping)
+    {
+        // Sleep until int_enqueue() finds us asleep rather than waking periodically while there is nothing to do
+        monitorasleep=true;
+        monitorcv.wait(g, [this]{ return stopping || queued; });
+        monitorasleep=false;
+        size_t last=progress.load(memory_order_relaxed);
+        auto began=chrono::steady_clock::now();
+        int_running_off_cpu(chrono::steady_clock::duration(0));
+        while(!stopping && queued)
+        {
+            monitorcv.wait_for(g, bounds.stall_timeout, [this]{ return !!stopping; });
+            size_t now=progress.load(memory_order_relaxed);
+            auto ended=chrono::steady_clock::now();
+            // Sampled every time around so each sample covers just the one period
+            bool offcpu=int_running_off_cpu(ended-began);
+            if(!stopping && now==last && queued && offcpu)
+            {
+                g.unlock();
+                int_maybe_grow(true);
+                g.lock();
+            }
+            last=now;
+            began=ended;
+        }
+    }
+}
+
+// Samples the CPU time of every worker, returning true if none of those running work used more than a tenth of
+// period since the last sample. Returns false if the CPU time of any of them cannot be told.
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC bool std_thread_pool::int_running_off_cpu(chrono::steady_clock::duration period)
+{
+    auto limit=chrono::duration_cast<chrono::nanoseconds>(period)/10;
+    bool ret=true;
+    lock_guard<mutex> g(workerslock);
+    for(auto *record: records)
+    {
+        auto cpu=record->cpu.now();
+        if(record->running.load(memory_order_relaxed) && (cpu.count()<0 || cpu-record->lastcpu>limit))
+            ret=false;
+        record->lastcpu=cpu;
+    }
+    return ret;
+}
+
+// Called by int_enqueue(), by a worker about to block in a syscall, and by the monitor if work has stalled.
+// Returns false if there are no workers at all.
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC bool std_thread_pool::int_maybe_grow(bool stalled) noexcept
+{
+    size_t a=alive.load(memory_order_relaxed), q=queued.load(memory_order_relaxed);
+    if(!q || a>=bounds.max)
+        return a>0;
+    if(stalled)
+    {
+        // Whatever the workers are doing, none of them is getting anywhere
+    }
+    else if(a<bounds.min)
+    {
+        // Lazily spawn up to the minimum while there is more waiting than there are idle workers to run it
+        size_t r=running.load(memory_order_relaxed);
+        if(q<=(a>r ? a-r : 0))
+            return true;
+    }
+    else if(blocked.load(memory_order_relaxed)<a)
+        return true;
+    // Only one of any racing callers gets to spawn
+    if(!alive.compare_exchange_strong(a, a+1, memory_order_relaxed))
+        return true;
+    try
+    {
+        std::vector<std::unique_ptr<thread>> finished;
+        {
+            lock_guard<mutex> g(workerslock);
+            if(stopping)
+            {
+                --alive;
+                return a>0;
+            }
+            workers.push_back(detail::make_unique<thread>(worker(this)));
+            finished.swap(retired);
+        }
+        for(auto &i: finished)
+            i->join();
+        return true;
+    }
+    catch(...)
+    {
+        --alive;
+        return a>0;
+    }
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC std_thread_pool *std_thread_pool::int_blocking_begin() noexcept
+{
+    std_thread_pool *pool=int_current().pool;
+    if(!pool || !pool->adaptive)
+        return nullptr;
+    ++pool->blocked;
+    pool->int_maybe_grow();
+    return pool;
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void std_thread_pool::int_blocking_end(chrono::steady_clock::time_point began) noexcept
+{
+    // Only the worker ever writes its record, so there is no need for an atomic add
+    worker_record *record=int_current().record;
+    if(record)
+        record->blockedns.store(record->blockedns.load(memory_order_relaxed)+chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now()-began).count(), memory_order_relaxed);
+    --blocked;
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC chrono::nanoseconds std_thread_pool::blocked_time() const
+{
+    lock_guard<mutex> g(workerslock);
+    unsigned long long ret=retiredblockedns;
+    for(auto *record: records)
+        ret+=record->blockedns.load(memory_order_relaxed);
+    return chrono::nanoseconds(ret);
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC std::vector<thread_pool_worker_stats> std_thread_pool::worker_stats() const
+{
+    std::vector<thread_pool_worker_stats> ret;
+    lock_guard<mutex> g(workerslock);
+    ret.reserve(records.size());
+    for(auto *record: records)
+    {
+        thread_pool_worker_stats s;
+        s.blocked=chrono::nanoseconds(record->blockedns.load(memory_order_relaxed));
+        s.cpu=record->cpu.now();
+        s.running=record->running.load(memory_order_relaxed);
+        ret.push_back(s);
+    }
+    return ret;
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void std_thread_pool::destroy()
+{
+    if(!service.stopped())
+    {
+        {
+            lock_guard<mutex> g(workerslock);
+            stopping=true;
+        }
+        {
+            lock_guard<mutex> g(idlelock);
+            idlecv.notify_all();
+        }
+        {
+            lock_guard<mutex> g(monitorlock);
+            monitorcv.notify_all();
+        }
+        if(monitor.joinable())
+            monitor.join();
+        // Tell the threads there is no more work to do
+        working.reset();
+        for(auto &i: nodes) { i->working.reset(); }
+        // Adaptive workers may still be spawning or retiring until they see stopping
+        for(;;)
+        {
+            std::vector<std::unique_ptr<thread>> tojoin;
+            {
+                lock_guard<mutex> g(workerslock);
+                tojoin.swap(workers);
+                for(auto &i: retired)
+                    tojoin.push_back(std::move(i));
+                retired.clear();
+            }
+            if(tojoin.empty())
+                break;
+            for(auto &i: tojoin) { i->join(); }
+        }
+        alive=0;
+        // For some reason ASIO occasionally thinks there is still more work to do
+        for(auto &i: nodes)
+        {
+            if(i->ownservice && !i->ownservice->stopped())
+                i->ownservice->run();
+        }
+        if(!service.stopped())
+            service.run();
+        service.stop();
+        service.reset();
+    }
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void std_thread_pool::int_enqueue(detail::work_item &&item)
+{
+    if(adaptive)
+    {
+        // The monitor is only needed once there is work, and not at all if it would never add a worker
+        if(!monitorstarted.load(memory_order_acquire) && bounds.stall_timeout.count())
+        {
+            lock_guard<mutex> g(workerslock);
+            if(!monitorstarted.load(memory_order_relaxed) && !stopping)
+            {
+                monitor=thread([this]{ int_monitor(); });
+                monitorstarted.store(true, memory_order_release);
+            }
+        }
+        ++queued;
+        service.post(adaptive_item{this, std::move(item)});
+        if(idlers)
+        {
+            lock_guard<mutex> g(idlelock);
+            idlecv.notify_one();
+        }
+        // Pairs with the monitor setting monitorasleep before checking queued
+        if(monitorasleep)
+        {
+            lock_guard<mutex> g(monitorlock);
+            monitorcv.notify_one();
+        }
+        if(!int_maybe_grow())
+            BOOST_AFIO_THROW(std::runtime_error("std_thread_pool failed to spawn any worker threads"));
+        return;
+    }
+    if(thread_placement::numa_node!=placement || nodes.size()<2)
+    {
+        service.post(std::move(item));
+        return;
+    }
+    node_t &n=*nodes[int_node_for_enqueue()];
+    n.posted.fetch_add(1, memory_order_relaxed);
+    n.service->post(std::move(item));
+}
+
+std::shared_ptr<std_thread_pool> process_threadpool()
+{
+    // This is basically how many file i/o operations can occur at once
+    // Obviously the kernel also has a limit
+    static std::weak_ptr<std_thread_pool> shared;
+    static spinlock<bool> lock;
+    std::shared_ptr<std_thread_pool> ret(shared.lock());
+    if(!ret)
+    {
+        lock_guard<decltype(lock)> lockh(lock);
+        ret=shared.lock();
+        if(!ret)
+        {
+            // Machines with few CPUs still need enough workers that a few blocked ones don't hold up everything else
+            size_t workers=BOOST_AFIO_MIN_NON_ASYNC_QUEUE_DEPTH ? BOOST_AFIO_MIN_NON_ASYNC_QUEUE_DEPTH : std::max(thread::hardware_concurrency(), 8U);
+            if(workers>BOOST_AFIO_MAX_NON_ASYNC_QUEUE_DEPTH)
+                workers=BOOST_AFIO_MAX_NON_ASYNC_QUEUE_DEPTH;
+            shared=ret=std::make_shared<std_thread_pool>(thread_pool_bounds(workers, BOOST_AFIO_MAX_NON_ASYNC_QUEUE_DEPTH));
+        }
+    }
+    return ret;
+}
+
+#if BOOST_AFIO_OP_TRACING
+namespace detail {
+    enum class op_trace_event : unsigned char
+    {
+        scheduled,
+        dequeued,
+        syscall_begin,
+        syscall_end,
+        completed
+    };
+    /* Each entry is a seqlock, as the owning thread overwrites the oldest entries while they may be
+    being read. seq is 2n+1 while the n-th entry of the ring is being written into it and 2n+2 once
+    it has been, so readers can tell both a torn entry and one overwritten since they looked.
+    */
+    struct op_trace_entry
+    {
+        atomic<size_t> seq;
+        atomic<chrono::steady_clock::rep> when;
+        atomic<size_t> id, precondition;
+        atomic<unsigned> event_optype;  // event<<8|optype
+        op_trace_entry() : seq(0), when(0), id(0), precondition(0), event_optype(0) { }
+        void write(size_t n, chrono::steady_clock::rep _when, size_t _id, size_t _precondition, op_trace_event event, OpType optype) noexcept
+        {
+            seq.store(2*n+1, memory_order_relaxed);
+            atomic_thread_fence(memory_order_release);
+            when.store(_when, memory_order_relaxed);
+            id.store(_id, memory_order_relaxed);
+            precondition.store(_precondition, memory_order_relaxed);
+            event_optype.store((unsigned) event<<8|(unsigned char) optype, memory_order_relaxed);
+            seq.store(2*n+2, memory_order_release);
+        }
+        // Returns false if the n-th entry of the ring is no longer here, or is being overwritten
+        bool read(size_t n, chrono::steady_clock::rep &_when, size_t &_id, size_t &_precondition, op_trace_event &event, unsigned char &optype) const noexcept
+        {
+            if(seq.load(memory_order_acquire)!=2*n+2)
+                return false;
+            _when=when.load(memory_order_relaxed);
+            _id=id.load(memory_order_relaxed);
+            _precondition=precondition.load(memory_order_relaxed);
+            unsigned eo=event_optype.load(memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            if(seq.load(memory_order_relaxed)!=2*n+2)
+                return false;
+            event=(op_trace_event)(eo>>8);
+            optype=(unsigned char) eo;
+            return true;
+        }
+    };
+    // Written only by its owning thread. Readers see every entry before written, bar any since overwritten.
+    struct op_trace_ring
+    {
+        size_t tid;
+        atomic<size_t> written;
+        op_trace_entry entries[BOOST_AFIO_OP_TRACE_RING_SIZE];
+        op_trace_ring(size_t _tid) : tid(_tid), written(0) { }
+    };
+    static_assert(!(BOOST_AFIO_OP_TRACE_RING_SIZE&(BOOST_AFIO_OP_TRACE_RING_SIZE-1)), "BOOST_AFIO_OP_TRACE_RING_SIZE must be a power of two");
+    struct op_trace_registry
+    {
+        atomic<bool> enabled;
+        spinlock<bool> lock;
+        // Kept after their threads exit so their events can still be written out, until a new thread reuses and empties them
+        std::vector<std::unique_ptr<op_trace_ring>> rings;
+        std::vector<op_trace_ring *> unowned;
+        size_t lasttid;
+        op_trace_registry() : enabled(false), lasttid(0) { }
+        op_trace_ring *acquire()
+        {
+            lock_guard<decltype(lock)> g(lock);
+            if(unowned.empty())
+            {
+                rings.push_back(detail::make_unique<op_trace_ring>(++lasttid));
+                return rings.back().get();
+            }
+            // Threads come and go with adaptive pools, so reuse the ring of an exited thread rather than growing without bound.
+            // Its previous thread's events are dropped, as they would otherwise be written out under the new thread's id.
+            op_trace_ring *ret=unowned.back();
+            unowned.pop_back();
+            ret->tid=++lasttid;
+            ret->written.store(0, memory_order_relaxed);
+            return ret;
+        }
+        void release(op_trace_ring *ring)
+        {
+            lock_guard<decltype(lock)> g(lock);
+            unowned.push_back(ring);
+        }
+    };
+    inline op_trace_registry &op_trace()
+    {
+        static op_trace_registry r;
+        return r;
+    }
+    // Hands this thread's ring back to the registry when the thread exits
+    class op_trace_ring_owner
+    {
+        op_trace_ring *_ring;
+        // 0 = not yet constructed, 1 = alive, 2 = destroyed during thread exit
+        static int &state() { static BOOST_AFIO_THREAD_LOCAL int s; return s; }
+        op_trace_ring_owner() : _ring(nullptr) { state()=1; }
+        op_trace_ring_owner(const op_trace_ring_owner &) = delete;
+        op_trace_ring_owner &operator=(const op_trace_ring_owner &) = delete;
+    public:
+        ~op_trace_ring_owner()
+        {
+            state()=2;
+            if(_ring)
+                op_trace().release(_ring);
+        }
+        //! Returns this thread's ring, or null if this thread is exiting and has already handed it back
+        static op_trace_ring *get()
+        {
+            if(2==state())
+                return nullptr;
+            static thread_local op_trace_ring_owner o;
+            if(!o._ring)
+                o._ring=op_trace().acquire();
+            return o._ring;
+        }
+    };
+    inline void op_trace_record(op_trace_event event, OpType optype, size_t id, size_t precondition=0)
+    {
+        if(!op_trace().enabled.load(memory_order_relaxed))
+            return;
+        op_trace_ring *r=op_trace_ring_owner::get();
+        if(!r)
+            return;
+        size_t n=r->written.load(memory_order_relaxed);
+        r->entries[n&(BOOST_AFIO_OP_TRACE_RING_SIZE-1)].write(n, chrono::steady_clock::now().time_since_epoch().count(), id, precondition, event, optype);
+        r->written.store(n+1, memory_order_release);
+    }
+    // Records the syscall(s) made during its lifetime
+    struct op_trace_syscall
+    {
+        OpType optype;
+        size_t id;
+        op_trace_syscall(OpType _optype, size_t _id) : optype(_optype), id(_id) { op_trace_record(op_trace_event::syscall_begin, optype, id); }
+        ~op_trace_syscall() { op_trace_record(op_trace_event::syscall_end, optype, id); }
+    };
+}
+
+BOOST_AFIO_HEADERS_ONLY_FUNC_SPEC void enable_op_tracing(bool enable)
+{
+    detail::op_trace().enabled=enable;
+}
+
+BOOST_AFIO_HEADERS_ONLY_FUNC_SPEC void write_op_trace(std::ostream &out)
+{
+    typedef chrono::duration<double, ratio<1, 1000000>> us_type;
+    detail::op_trace_registry &r=detail::op_trace();
+    lock_guard<decltype(r.lock)> g(r.lock);
+    // Timestamps are large, so print them fixed point or they lose their sub millisecond part
+    auto oldflags=out.flags(std::ios::fixed);
+    auto oldprecision=out.precision(3);
+    auto restore=detail::Undoer([&out, oldflags, oldprecision]{ out.flags(oldflags); out.precision(oldprecision); });
+    bool first=true;
+    auto event=[&out, &first](const char *ph, const char *name, size_t tid, chrono::steady_clock::rep when) -> std::ostream & {
+        out << (first ? "\n" : ",\n") << "{\"ph\":\"" << ph << "\",\"cat\":\"afio\",\"name\":\"" << name << "\",\"pid\":1,\"tid\":" << tid
+            << ",\"ts\":" << chrono::duration_cast<us_type>(chrono::steady_clock::duration(when)).count();
+        first=false;
+        return out;
+    };
+    out << "{\"traceEvents\":[";
+    for(auto &ring: r.rings)
+    {
+        out << (first ? "\n" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << ring->tid << ",\"args\":{\"name\":\"afio thread " << ring->tid << "\"}}";
+        first=false;
+        size_t end=ring->written.load(memory_order_acquire);
+        size_t begin=end>BOOST_AFIO_OP_TRACE_RING_SIZE ? end-BOOST_AFIO_OP_TRACE_RING_SIZE : 0;
+        for(size_t n=begin; n<end; n++)
+        {
+            chrono::steady_clock::rep when;
+            size_t id, precondition;
+            detail::op_trace_event ev;
+            unsigned char optype;
+            // Skip any entry the owning thread has overwritten since we looked
+            if(!ring->entries[n&(BOOST_AFIO_OP_TRACE_RING_SIZE-1)].read(n, when, id, precondition, ev, optype))
+                continue;
+            const char *name=optype<(unsigned char) detail::OpType::Last ? detail::optypes[optype] : "unknown";
+            switch(ev)
+            {
+            case detail::op_trace_event::scheduled:
+                event("b", name, ring->tid, when) << ",\"id\":" << id << ",\"args\":{\"precondition\":" << precondition << "}}";
+                event("b", "queued", ring->tid, when) << ",\"id\":" << id << "}";
+                break;
+            case detail::op_trace_event::dequeued:
+                event("e", "queued", ring->tid, when) << ",\"id\":" << id << "}";
+                break;
+            case detail::op_trace_event::syscall_begin:
+                event("B", name, ring->tid, when) << ",\"args\":{\"id\":" << id << "}}";
+                break;
+            case detail::op_trace_event::syscall_end:
+                event("E", name, ring->tid, when) << "}";
+                break;
+            case detail::op_trace_event::completed:
+                event("e", name, ring->tid, when) << ",\"id\":" << id << "}";
+                break;
+            }
+        }
+    }
+    out << "\n]}" << std::endl;
+}
+#endif
+
+namespace detail {
+    // Lets an adaptive std_thread_pool know one of its workers is blocked in a syscall for the lifetime of this
+    struct blocking_syscall
+    {
+        std_thread_pool *pool;
+        chrono::steady_clock::time_point began;
+        blocking_syscall() noexcept : pool(std_thread_pool::int_blocking_begin())
+        {
+            if(pool)
+                began=chrono::steady_clock::now();
+        }
+        blocking_syscall(const blocking_syscall &)=delete;
+        ~blocking_syscall()
+        {
+            if(pool)
+                pool->int_blocking_end(began);
+        }
+    };
+}
+#if BOOST_AFIO_OP_TRACING
+#define BOOST_AFIO_TRACE_OP(...) detail::op_trace_record(__VA_ARGS__)
+#define BOOST_AFIO_TRACE_SYSCALL(optype, id) detail::op_trace_syscall op_trace_syscall_(optype, id)
+#else
+#define BOOST_AFIO_TRACE_OP(...)
+#define BOOST_AFIO_TRACE_SYSCALL(optype, id)
+#endif
+// Marks the rest of the scope as blocked in a syscall, for any adaptive std_thread_pool running it
+#define BOOST_AFIO_BLOCKING_SYSCALL detail::blocking_syscall blocking_syscall_
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC work_stealing_thread_pool::work_stealing_thread_pool(size_t no) : thread_source(service), working(detail::make_unique<asio::io_service::work>(service)), queued(0), idle(0), stopping(false)
+{
+    if(!no)
+        no=1;
+    queues.reserve(no);
+    for(size_t n=0; n<no; n++)
+        queues.push_back(detail::make_unique<worker_queue>());
+    workers.reserve(no);
+    for(size_t n=0; n<no; n++)
+        workers.push_back(detail::make_unique<thread>([this, n]{ int_run(n); }));
+}
 
-#elif !defined(IOV_MAX) || defined(__APPLE__)  // Android lacks preadv() and pwritev()
-BOOST_AFIO_V2_NAMESPACE_BEGIN
-#ifndef IOV_MAX
-#define IOV_MAX 1024
-struct iovec {
-    void  *iov_base;    /* Starting address */
-    size_t iov_len;     /* Number of bytes to transfer */
-};
-typedef ptrdiff_t ssize_t;
-#endif
-inline ssize_t preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC work_stealing_thread_pool::~work_stealing_thread_pool()
 {
-    off_t at=offset;
-    ssize_t transferred;
-    for(; iovcnt; iov++, iovcnt--, at+=(off_t) transferred)
-        if(-1==(transferred=pread(fd, iov->iov_base, (unsigned) iov->iov_len, at))) return -1;
-    return (ssize_t)(at-offset);
+    destroy();
 }
-inline ssize_t pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void work_stealing_thread_pool::destroy()
 {
-    off_t at=offset;
-    ssize_t transferred;
-    for(; iovcnt; iov++, iovcnt--, at+=(off_t) transferred)
-        if(-1==(transferred=pwrite(fd, iov->iov_base, (unsigned) iov->iov_len, at))) return -1;
-    return (ssize_t)(at-offset);
+    if(!workers.empty())
+    {
+        stopping=true;
+        // Wake everybody up, and let them exit once all the queues are drained
+        working.reset();
+        for(size_t n=0; n<workers.size(); n++)
+            service.post([]{});
+        for(auto &i: workers) { i->join(); }
+        workers.clear();
+        // Anything enqueued by the very last work executed still needs doing
+        detail::work_item item;
+        while(int_pop(0, item))
+            item();
+        if(!service.stopped())
+            service.run();
+        service.stop();
+        service.reset();
+    }
 }
-BOOST_AFIO_V2_NAMESPACE_END
 
-#endif
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void work_stealing_thread_pool::int_enqueue(detail::work_item &&item)
+{
+    // Work from one of my own workers stays with that worker for cache locality
+    current_worker &c=int_current();
+    worker_queue &q=(this==c.pool) ? *queues[c.idx] : injected;
+    {
+        lock_guard<decltype(q.lock)> g(q.lock);
+        q.q.push_back(std::move(item));
+    }
+    // Pairs with the increment of idle followed by the check of queued in int_run()
+    ++queued;
+    if(idle)
+        service.post([]{});
+}
 
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void work_stealing_thread_pool::int_enqueue(std::vector<detail::work_item> &items)
+{
+    current_worker &c=int_current();
+    worker_queue &q=(this==c.pool) ? *queues[c.idx] : injected;
+    {
+        lock_guard<decltype(q.lock)> g(q.lock);
+        for(auto &i: items)
+            q.q.push_back(std::move(i));
+    }
+    queued+=items.size();
+    // Wake no more idle workers than there is work for, rather than once per item
+    size_t wake=(std::min)((size_t) idle, items.size());
+    for(size_t n=0; n<wake; n++)
+        service.post([]{});
+}
 
-BOOST_AFIO_V2_NAMESPACE_BEGIN
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC bool work_stealing_thread_pool::int_pop(size_t idx, detail::work_item &out)
+{
+    if(!queued)
+        return false;
+    // My own newest work first, as its data is most likely to still be in cache
+    {
+        worker_queue &q=*queues[idx];
+        lock_guard<decltype(q.lock)> g(q.lock);
+        if(!q.q.empty())
+        {
+            out=std::move(q.q.back());
+            q.q.pop_back();
+            --queued;
+            return true;
+        }
+    }
+    // Then work from outside the pool in the order it was submitted
+    {
+        lock_guard<decltype(injected.lock)> g(injected.lock);
+        if(!injected.q.empty())
+        {
+            out=std::move(injected.q.front());
+            injected.q.pop_front();
+            --queued;
+            return true;
+        }
+    }
+    // Then steal the oldest work of the other workers
+    for(size_t n=1; n<queues.size(); n++)
+    {
+        worker_queue &q=*queues[(idx+n)%queues.size()];
+        lock_guard<decltype(q.lock)> g(q.lock);
+        if(!q.q.empty())
+        {
+            out=std::move(q.q.front());
+            q.q.pop_front();
+            --queued;
+            return true;
+        }
+    }
+    return false;
+}
 
-std::shared_ptr<std_thread_pool> process_threadpool()
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void work_stealing_thread_pool::int_run(size_t idx)
 {
-    // This is basically how many file i/o operations can occur at once
-    // Obviously the kernel also has a limit
-    static std::weak_ptr<std_thread_pool> shared;
-    static spinlock<bool> lock;
-    std::shared_ptr<std_thread_pool> ret(shared.lock());
-    if(!ret)
+    detail::set_threadname("boost::afio::work_stealing_thread_pool worker");
+    current_worker &c=int_current();
+    c.pool=this;
+    c.idx=idx;
+    try
     {
-        lock_guard<decltype(lock)> lockh(lock);
-        ret=shared.lock();
-        if(!ret)
+        for(size_t count=0;;)
         {
-            shared=ret=std::make_shared<std_thread_pool>(BOOST_AFIO_MAX_NON_ASYNC_QUEUE_DEPTH);
+            detail::work_item item;
+            if(int_pop(idx, item))
+            {
+                item();
+                // Don't starve anything else posted to the io_service while we are busy
+                if(!(++count & 15))
+                    service.poll_one();
+                continue;
+            }
+            if(stopping)
+                break;
+            ++idle;
+            // If something was enqueued after we last looked, int_enqueue() may not have seen us idle
+            if(queued)
+            {
+                --idle;
+                continue;
+            }
+            service.run_one();
+            --idle;
         }
     }
-    return ret;
+    catch(...)
+    {
+        BOOST_AFIO_LOG_FATAL_EXIT("WARNING: work_stealing_thread_pool worker exits via " << detail::output_exception_info << " which shouldn't happen." << std::endl);
+    }
+    c.pool=nullptr;
 }
 
 #ifndef BOOST_AFIO_COMPILING_FOR_GCOV
@@ -788,17 +1849,89 @@ retry:
     }
 
     
+    /* The ops upon one handle opened with file_flags::strand, run one at a time in the order they became ready.
+    Whichever thread finds the strand idle schedules a drain of it, and the drain runs each op in turn on the
+    same worker. An op which completes later, such as one submitted to io_uring, parks the strand and whoever
+    completes it schedules the drain again. Ordering thus needs neither each op chained onto the last through
+    the op table, nor a trip through the thread source per op.
+    */
+    class op_strand
+    {
+        spinlock<bool> lock;
+        std::deque<std::shared_ptr<async_file_io_dispatcher_op>> q;
+        bool draining;
+        enum { running, parked, completed };
+        atomic<int> state;
+        std::shared_ptr<async_file_io_dispatcher_op> pop()
+        {
+            std::shared_ptr<async_file_io_dispatcher_op> ret;
+            lock_guard<decltype(lock)> g(lock);
+            if(q.empty())
+                draining=false;
+            else
+            {
+                ret=std::move(q.front());
+                q.pop_front();
+                state.store(running, memory_order_relaxed);
+            }
+            return ret;
+        }
+    public:
+        op_strand() : draining(false), state(completed) { }
+        // Returns true if the strand was idle, in which case the caller must schedule drain()
+        bool push(std::shared_ptr<async_file_io_dispatcher_op> op)
+        {
+            lock_guard<decltype(lock)> g(lock);
+            q.push_back(std::move(op));
+            if(draining)
+                return false;
+            draining=true;
+            return true;
+        }
+        // Called when the op last popped completes. Returns true if the strand had parked, in which case the caller must schedule drain()
+        bool complete() noexcept
+        {
+            return parked==state.exchange(completed, memory_order_acq_rel);
+        }
+        inline void drain();
+    };
+
+#if BOOST_AFIO_HAVE_KAIO
+    // Returns what the offsets, lengths and memory of O_DIRECT i/o upon fd must be aligned to, or zero if it can't be done
+    inline size_t direct_io_alignment(int fd) noexcept
+    {
+#ifdef STATX_DIOALIGN
+        // Linux 6.1 onwards reports it, which is the only way to know for files not directly upon a block device
+        struct statx sx;
+        if(!::statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &sx) && (sx.stx_mask & STATX_DIOALIGN))
+            return sx.stx_dio_offset_align ? std::max(sx.stx_dio_offset_align, sx.stx_dio_mem_align) : 0;
+#endif
+        int sectorsize=0;
+        if(!::ioctl(fd, BLKSSZGET, &sectorsize) && sectorsize>0)
+            return (size_t) sectorsize;
+        // A filing system's block size is never smaller than the logical sector size of its device
+        BOOST_AFIO_POSIX_STAT_STRUCT s={0};
+        if(!BOOST_AFIO_POSIX_FSTAT(fd, &s) && s.st_blksize>0)
+            return (size_t) s.st_blksize;
+        return 4096;
+    }
+#endif
+
     struct async_io_handle_posix : public handle
     {
         int fd;  // -999 is closed handle
         bool has_been_added, DeleteOnClose, SyncOnClose, has_ever_been_fsynced;
         dev_t st_dev;  // Stored on first open. Used to detect races later.
         ino_t st_ino;
+#if BOOST_AFIO_HAVE_KAIO
+        size_t directalign;  // What i/o must be aligned to if opened os_direct, otherwise zero
+#endif
         typedef spinlock<bool> pathlock_t;
         mutable pathlock_t pathlock; BOOST_AFIO_V2_NAMESPACE::path _path;
 #ifndef BOOST_AFIO_COMPILING_FOR_GCOV
         std::unique_ptr<posix_lock_file> lockfile;
 #endif
+        op_strand strand;
 
         async_io_handle_posix(dispatcher *_parent, const BOOST_AFIO_V2_NAMESPACE::path &path, file_flags flags, bool _DeleteOnClose, bool _SyncOnClose, int _fd) : handle(_parent, flags), fd(_fd), has_been_added(false), DeleteOnClose(_DeleteOnClose), SyncOnClose(_SyncOnClose), has_ever_been_fsynced(false), st_dev(0), st_ino(0), _path(path)
         {
@@ -819,6 +1952,9 @@ retry:
 #ifndef BOOST_AFIO_COMPILING_FOR_GCOV
             if(!!(flags & file_flags::os_lockable))
                 lockfile=process_lockfile_registry::open<posix_lock_file>(this);
+#endif
+#if BOOST_AFIO_HAVE_KAIO
+            directalign=(fd>=0 && !!(flags & file_flags::os_direct)) ? direct_io_alignment(fd) : 0;
 #endif
         }
         //! Returns the containing directory if my inode appears in it
@@ -850,6 +1986,7 @@ retry:
                 has_been_added=false;
             }
         }
+        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC detail::op_strand *int_strand() noexcept override final { return &strand; }
         BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC open_states is_open() const override final
         {
           if(-999==fd)
@@ -1197,85 +2334,514 @@ update_path:
           }
           update_path(oldpath, newpath);
         }
-        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC void atomic_relink(const path_req &_req) override final
+        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC void atomic_relink(const path_req &_req) override final
+        {
+          path_req req(_req);
+          if(-999!=fd)
+          {
+            auto newdirh=decode_relative_path<async_file_io_dispatcher_compat, async_io_handle_posix>(req);
+            if(!(flags() & file_flags::no_race_protection))
+            {
+#if BOOST_AFIO_POSIX_PROVIDES_AT_PATH_FUNCTIONS
+              auto dirh(int_verifymyinode());
+              if(!dirh)
+              {
+                errno=ENOENT;
+                BOOST_AFIO_ERRHOSFN(-1, [this]{return path();});
+              }
+              BOOST_AFIO_V2_NAMESPACE::path leaf(path().filename());
+              BOOST_AFIO_ERRHOSFN(BOOST_AFIO_POSIX_RENAMEAT((int)(size_t)dirh->native_handle(), leaf.c_str(), newdirh ? (int)(size_t)newdirh->native_handle() : at_fdcwd, req.path.c_str()), [this]{return path();});
+#else
+              // At least check if what I am about to delete matches myself
+              BOOST_AFIO_POSIX_STAT_STRUCT s={0};
+              BOOST_AFIO_V2_NAMESPACE::path p(path(true));
+              BOOST_AFIO_ERRHOSFN(BOOST_AFIO_POSIX_LSTATAT(at_fdcwd, p.c_str(), &s), [this]{return path();});
+              if(s.st_dev!=st_dev || s.st_ino!=st_ino)
+              {
+                errno=ENOENT;
+                BOOST_AFIO_ERRHOSFN(-1, [this]{return path();});
+              }
+              // Could of course still race between the lstat() and the unlink() so still unsafe ...
+              BOOST_AFIO_ERRHOSFN(BOOST_AFIO_POSIX_RENAMEAT(at_fdcwd, p.c_str(), at_fdcwd, req.path.c_str()), [this]{return path();});
+#endif
+              if(newdirh)
+                req.path=newdirh->path(true)/req.path;
+              goto update_path;
+            }
+          }
+          decode_relative_path<async_file_io_dispatcher_compat, async_io_handle_posix>(req, true);
+          BOOST_AFIO_ERRHOSFN(BOOST_AFIO_POSIX_RENAMEAT(at_fdcwd, path(true).c_str(), at_fdcwd, req.path.c_str()), [this]{return path();});
+update_path:
+          BOOST_AFIO_V2_NAMESPACE::path oldpath;
+          {
+            lock_guard<pathlock_t> g(pathlock);
+            oldpath=std::move(_path);
+            _path=req.path;
+          }
+          update_path(oldpath, req.path);
+        }
+    };
+
+    struct async_file_io_dispatcher_op
+    {
+        OpType optype;
+        async_op_flags flags;
+        enqueued_task<handle_ptr()> enqueuement;
+        typedef std::pair<size_t, std::shared_ptr<detail::async_file_io_dispatcher_op>> completion_t;
+        typedef std::vector<completion_t, op_pool_allocator<completion_t>> completions_t;
+        completions_t completions;
+        handle_ptr admittedh;  // The handle this op is counted against by admission control, if any
+        size_t precondition;   // The id of the op this op was chained onto, if any
+        handle_future preconditionh;  // Supplies this op's input handle, until it completes
+        atomic<size_t> depth;  // How many ops deep the chain of preconditions was when this op was chained
+        op_strand *strand;     // The strand this op was run through, if any
+        handle_ptr strandh;    // Keeps the handle owning strand alive
+        enum status_t { pending, started, canceled, timedout };
+        atomic<int> status;
+        atomic<chrono::steady_clock::rep> deadline;  // Zero for none
+        chrono::steady_clock::rep scheduledat;  // When scheduled
+        atomic<chrono::steady_clock::rep> startedat;  // When it started executing, or zero if it has not
+        bool stallreported;    // Only touched by the stall detector under this op's shard lock
+        handle_future h() const { return enqueuement.get_future(); }
+#ifdef BOOST_AFIO_OP_STACKBACKTRACEDEPTH
+        stack_type stack;  // Empty unless this op was sampled
+        void fillStack() { if(sample_stack()) collect_stack(stack); }
+#else
+        void fillStack() { }
+#endif
+        async_file_io_dispatcher_op(OpType _optype, async_op_flags _flags)
+            : optype(_optype), flags(_flags), precondition(0), depth(0), strand(nullptr), status(pending), deadline(0),
+            scheduledat(chrono::steady_clock::now().time_since_epoch().count()), startedat(0), stallreported(false)
+        {
+            // Stop the stl_future from being auto-set on task return
+            enqueuement.disable_auto_set_future();
+            //completions.reserve(4); // stop needless storage doubling for small numbers
+            fillStack();
+        }
+        async_file_io_dispatcher_op(async_file_io_dispatcher_op &&o) noexcept : optype(o.optype), flags(std::move(o.flags)),
+            enqueuement(std::move(o.enqueuement)), completions(std::move(o.completions)), admittedh(std::move(o.admittedh)),
+            precondition(o.precondition), preconditionh(std::move(o.preconditionh)), depth(o.depth.load()), strand(o.strand), strandh(std::move(o.strandh)),
+            status(o.status.load()), deadline(o.deadline.load()), scheduledat(o.scheduledat), startedat(o.startedat.load()), stallreported(o.stallreported)
+#ifdef BOOST_AFIO_OP_STACKBACKTRACEDEPTH
+            , stack(std::move(o.stack))
+#endif
+            {
+            }
+        // Barriers must run regardless, as every other op in the barrier waits upon them
+        bool cancellable() const { return OpType::barrier!=optype; }
+        // Stops this op from ever starting. Returns false if it already has.
+        bool cancel(status_t why=canceled)
+        {
+            int expected=pending;
+            return cancellable() && status.compare_exchange_strong(expected, why);
+        }
+        // Called just before executing. Returns false if this op was cancelled or its deadline has passed.
+        bool start()
+        {
+            auto now=chrono::steady_clock::now().time_since_epoch().count();
+            auto d=deadline.load(memory_order_relaxed);
+            if(d && now>=d)
+                cancel(timedout);
+            int expected=pending;
+            if(!status.compare_exchange_strong(expected, started))
+                return false;
+            startedat.store(now, memory_order_relaxed);
+            return true;
+        }
+        // The exception an op which never started completes with
+        exception_ptr not_started_exception() const
+        {
+            if(timedout==status)
+                return BOOST_AFIO_V2_NAMESPACE::make_exception_ptr(system_error(error_code(ETIMEDOUT, generic_category()), "Op deadline passed before it started"));
+            return BOOST_AFIO_V2_NAMESPACE::make_exception_ptr(system_error(error_code(ECANCELED, generic_category()), "Op was canceled before it started"));
+        }
+    private:
+        async_file_io_dispatcher_op(const async_file_io_dispatcher_op &o) = delete;
+    };
+    inline void op_strand::drain()
+    {
+        while(auto op=pop())
+        {
+            op->enqueuement();
+            // If it has yet to complete, whoever completes it carries on from here
+            int expected=running;
+            if(state.compare_exchange_strong(expected, parked, memory_order_acq_rel))
+                return;
+        }
+    }
+    // Ops which may be run through a strand. Anything which can wait upon other ops, such as a barrier
+    // or a user completion, could deadlock waiting on ops queued behind it.
+    inline bool strandable(OpType optype)
+    {
+        switch(optype)
+        {
+        case OpType::read:
+        case OpType::write:
+        case OpType::sync:
+        case OpType::truncate:
+        case OpType::zero:
+            return true;
+        default:
+            return false;
+        }
+    }
+    /* The table of extant ops, keyed by monotonic op id. Every chain and every completion
+    used to serialise on one spinlock around one unordered_map, so instead we split the
+    table into BOOST_AFIO_OP_TABLE_SHARDS shards each with its own lock and map. As ids
+    are allocated monotonically, concurrently scheduled ops land in consecutive shards
+    and so submitting threads rarely contend. Chaining a completion onto an op and
+    retiring that op both happen under that op's shard lock, which preserves the
+    guarantee that an op's completions are never appended after they were detached.
+    */
+    class async_file_io_dispatcher_op_table
+    {
+    public:
+        typedef std::shared_ptr<async_file_io_dispatcher_op> op_ptr;
+        typedef async_file_io_dispatcher_op::completion_t completion_t;
+        typedef async_file_io_dispatcher_op::completions_t completions_t;
+        typedef spinlock<size_t,
+            spins_to_loop<100>::policy,
+            spins_to_yield<500>::policy,
+            spins_to_sleep::policy
+        > shardlock_t;
+    private:
+        static constexpr size_t shards_count=BOOST_AFIO_OP_TABLE_SHARDS;
+        static_assert(shards_count && !(shards_count&(shards_count-1)), "BOOST_AFIO_OP_TABLE_SHARDS must be a power of two");
+        // Each shard is padded out so neighbouring shard locks don't false share. Not alignas()
+        // as the dispatcher_p containing us is heap allocated, which ignores extended alignment before C++17
+        struct shard_t
+        {
+            mutable shardlock_t lock;
+            std::unordered_map<size_t, op_ptr> ops;
+            atomic<size_t> count;  // ops.size(), only changed under lock but readable without it
+            char padding[64];
+            shard_t() : count(0) { }
+        };
+        shard_t _shards[shards_count];
+        shard_t &shard(size_t id) { return _shards[id&(shards_count-1)]; }
+        const shard_t &shard(size_t id) const { return _shards[id&(shards_count-1)]; }
+        // Calls f(shard, idx) for every idx in [0, n), grouping the indices by the shard of key(idx)
+        // so that each shard's lock is taken just once
+        template<class K, class F> void by_shard(size_t n, K &&key, F &&f)
+        {
+            size_t starts[shards_count+1]={0};
+            for(size_t i=0; i<n; i++)
+                ++starts[(key(i)&(shards_count-1))+1];
+            for(size_t i=0; i<shards_count; i++)
+                starts[i+1]+=starts[i];
+            std::vector<size_t> order(n);
+            {
+                size_t pos[shards_count];
+                std::copy(starts, starts+shards_count, pos);
+                for(size_t i=0; i<n; i++)
+                    order[pos[key(i)&(shards_count-1)]++]=i;
+            }
+            for(size_t i=0; i<shards_count; i++)
+            {
+                if(starts[i]==starts[i+1])
+                    continue;
+                shard_t &s=_shards[i];
+                lock_guard<shardlock_t> g(s.lock);
+                for(size_t j=starts[i]; j<starts[i+1]; j++)
+                    f(s, order[j]);
+            }
+        }
+    public:
+        async_file_io_dispatcher_op_table() { }
+        //! Adds a new op. Returns false if the id is already present.
+        bool insert(size_t id, op_ptr op)
+        {
+            shard_t &s=shard(id);
+            lock_guard<shardlock_t> g(s.lock);
+            if(!s.ops.insert(std::make_pair(id, std::move(op))).second)
+                return false;
+            s.count.store(s.ops.size(), memory_order_relaxed);
+            return true;
+        }
+        //! Adds a batch of new ops, taking each shard's lock once. Returns false if any id was already present.
+        bool insert(const std::vector<std::pair<size_t, op_ptr>> &items)
+        {
+            bool ret=true;
+            by_shard(items.size(), [&items](size_t i){ return items[i].first; }, [this, &items, &ret](shard_t &s, size_t i){
+                if(s.ops.insert(items[i]).second)
+                    s.count.store(s.ops.size(), memory_order_relaxed);
+                else
+                    ret=false;
+            });
+            return ret;
+        }
+        //! Appends each completion items[i].second to op items[i].first, taking each shard's lock once. done[i] is set to whether that op was still in flight.
+        void append_completions(const std::vector<std::pair<size_t, completion_t>> &items, std::vector<char> &done)
+        {
+            done.assign(items.size(), false);
+            by_shard(items.size(), [&items](size_t i){ return items[i].first; }, [&items, &done](shard_t &s, size_t i){
+                auto it=s.ops.find(items[i].first);
+                if(s.ops.end()!=it)
+                {
+                    it->second->completions.push_back(items[i].second);
+                    items[i].second.second->depth.store(it->second->depth.load(memory_order_relaxed)+1, memory_order_relaxed);
+                    done[i]=true;
+                }
+            });
+        }
+        //! Returns the op for id, or a null ptr if it is not in flight.
+        op_ptr find(size_t id) const
+        {
+            const shard_t &s=shard(id);
+            lock_guard<shardlock_t> g(s.lock);
+            auto it=s.ops.find(id);
+            return s.ops.end()==it ? op_ptr() : it->second;
+        }
+        //! Appends a completion to op id if it is still in flight, returning false if it has already been retired.
+        bool append_completion(size_t id, const completion_t &item)
+        {
+            shard_t &s=shard(id);
+            lock_guard<shardlock_t> g(s.lock);
+            auto it=s.ops.find(id);
+            if(s.ops.end()==it)
+                return false;
+            it->second->completions.push_back(item);
+            item.second->depth.store(it->second->depth.load(memory_order_relaxed)+1, memory_order_relaxed);
+            return true;
+        }
+        //! Removes a previously appended completion from op id, returning false if it was not found
+        bool remove_completion(size_t id, size_t completionid)
+        {
+            shard_t &s=shard(id);
+            lock_guard<shardlock_t> g(s.lock);
+            auto it=s.ops.find(id);
+            if(s.ops.end()==it || it->second->completions.empty())
+                return false;
+            auto &completions=it->second->completions;
+            // Items may have been added by other threads ...
+            for(auto cit=--completions.end(); true; --cit)
+            {
+                if(cit->first==completionid)
+                {
+                    completions.erase(cit);
+                    return true;
+                }
+                if(completions.begin()==cit) break;
+            }
+            return false;
+        }
+        //! Removes op id, detaching its completions into \em completions. Returns a null ptr if not found.
+        op_ptr extract(size_t id, completions_t &completions)
+        {
+            op_ptr ret;
+            shard_t &s=shard(id);
+            lock_guard<shardlock_t> g(s.lock);
+            auto it=s.ops.find(id);
+            if(s.ops.end()==it)
+                return ret;
+            ret.swap(it->second);
+            s.ops.erase(it);
+            s.count.store(s.ops.size(), memory_order_relaxed);
+            completions=std::move(ret->completions);
+            return ret;
+        }
+        //! Removes op id if present
+        void erase(size_t id)
+        {
+            shard_t &s=shard(id);
+            lock_guard<shardlock_t> g(s.lock);
+            if(s.ops.erase(id))
+                s.count.store(s.ops.size(), memory_order_relaxed);
+        }
+        //! Returns the number of ops in flight, summed over the shards without locking them
+        size_t size() const
+        {
+            size_t ret=0;
+            for(auto &s: _shards)
+                ret+=s.count.load(memory_order_relaxed);
+            return ret;
+        }
+        bool empty() const { return !size(); }
+        //! Calls f(id, op) for every op in flight, holding each shard's lock in turn
+        template<class F> void for_each(F &&f) const
+        {
+            for(auto &s: _shards)
+            {
+                lock_guard<shardlock_t> g(s.lock);
+                for(auto &i: s.ops)
+                    f(i.first, i.second);
+            }
+        }
+        //! Calls f(id, op) for the ops of whole shards in turn starting from shard \em cursor, holding each shard's
+        //! lock in turn, until at least \em budget ops have been visited or every shard has been. Advances \em cursor past the shards visited.
+        template<class F> void scan(size_t &cursor, size_t budget, F &&f) const
+        {
+            size_t visited=0;
+            for(size_t n=0; n<shards_count && visited<budget; n++)
+            {
+                const shard_t &s=_shards[cursor&(shards_count-1)];
+                cursor=(cursor+1)&(shards_count-1);
+                lock_guard<shardlock_t> g(s.lock);
+                for(auto &i: s.ops)
+                    f(i.first, i.second);
+                visited+=s.ops.size();
+            }
+        }
+        //! Returns a sorted list of the ids of all ops in flight, useful in a debugger
+        std::vector<size_t> ids() const
+        {
+            std::vector<size_t> ret;
+            for_each([&ret](size_t id, const op_ptr &){ ret.push_back(id); });
+            std::sort(ret.begin(), ret.end());
+            return ret;
+        }
+    private:
+        async_file_io_dispatcher_op_table(const async_file_io_dispatcher_op_table &) = delete;
+        async_file_io_dispatcher_op_table &operator=(const async_file_io_dispatcher_op_table &) = delete;
+    };
+    // One thread's latency histogram for one type of op. Only ever written by its owning thread, using
+    // plain loads and stores rather than locked increments, but may be read by stats() from any thread.
+    struct op_latency_recorder
+    {
+        atomic<unsigned long long> counts[latency_histogram::buckets];
+        atomic<unsigned long long> sum;
+        op_latency_recorder() : sum(0)
+        {
+            for(auto &i: counts)
+                i.store(0, memory_order_relaxed);
+        }
+        void record(unsigned long long ns)
+        {
+            auto &c=counts[latency_histogram::bucket(ns)];
+            c.store(c.load(memory_order_relaxed)+1, memory_order_relaxed);
+            sum.store(sum.load(memory_order_relaxed)+ns, memory_order_relaxed);
+        }
+        void snapshot(latency_histogram &h) const
+        {
+            for(size_t n=0; n<latency_histogram::buckets; n++)
+                if(auto c=counts[n].load(memory_order_relaxed))
+                    h.record(n, c, 0);
+            h.record(0, 0, sum.load(memory_order_relaxed));
+        }
+    };
+    struct op_latency_recorders
+    {
+        op_latency_recorder queued, executing, total;
+    };
+    // The latency recorders of one thread for one dispatcher, allocated per type of op when first completed
+    struct thread_op_stats
+    {
+        thread::id owner;
+        atomic<op_latency_recorders *> optypes[(size_t) OpType::Last];
+        thread_op_stats() : owner(this_thread::get_id())
+        {
+            for(auto &i: optypes)
+                i.store(nullptr, memory_order_relaxed);
+        }
+        ~thread_op_stats()
         {
-          path_req req(_req);
-          if(-999!=fd)
-          {
-            auto newdirh=decode_relative_path<async_file_io_dispatcher_compat, async_io_handle_posix>(req);
-            if(!(flags() & file_flags::no_race_protection))
+            for(auto &i: optypes)
+                delete i.load(memory_order_relaxed);
+        }
+        op_latency_recorders &operator[](OpType optype)
+        {
+            auto &slot=optypes[(size_t) optype];
+            op_latency_recorders *ret=slot.load(memory_order_relaxed);
+            if(!ret)
             {
-#if BOOST_AFIO_POSIX_PROVIDES_AT_PATH_FUNCTIONS
-              auto dirh(int_verifymyinode());
-              if(!dirh)
-              {
-                errno=ENOENT;
-                BOOST_AFIO_ERRHOSFN(-1, [this]{return path();});
-              }
-              BOOST_AFIO_V2_NAMESPACE::path leaf(path().filename());
-              BOOST_AFIO_ERRHOSFN(BOOST_AFIO_POSIX_RENAMEAT((int)(size_t)dirh->native_handle(), leaf.c_str(), newdirh ? (int)(size_t)newdirh->native_handle() : at_fdcwd, req.path.c_str()), [this]{return path();});
-#else
-              // At least check if what I am about to delete matches myself
-              BOOST_AFIO_POSIX_STAT_STRUCT s={0};
-              BOOST_AFIO_V2_NAMESPACE::path p(path(true));
-              BOOST_AFIO_ERRHOSFN(BOOST_AFIO_POSIX_LSTATAT(at_fdcwd, p.c_str(), &s), [this]{return path();});
-              if(s.st_dev!=st_dev || s.st_ino!=st_ino)
-              {
-                errno=ENOENT;
-                BOOST_AFIO_ERRHOSFN(-1, [this]{return path();});
-              }
-              // Could of course still race between the lstat() and the unlink() so still unsafe ...
-              BOOST_AFIO_ERRHOSFN(BOOST_AFIO_POSIX_RENAMEAT(at_fdcwd, p.c_str(), at_fdcwd, req.path.c_str()), [this]{return path();});
-#endif
-              if(newdirh)
-                req.path=newdirh->path(true)/req.path;
-              goto update_path;
+                ret=new op_latency_recorders;
+                slot.store(ret, memory_order_release);
             }
-          }
-          decode_relative_path<async_file_io_dispatcher_compat, async_io_handle_posix>(req, true);
-          BOOST_AFIO_ERRHOSFN(BOOST_AFIO_POSIX_RENAMEAT(at_fdcwd, path(true).c_str(), at_fdcwd, req.path.c_str()), [this]{return path();});
-update_path:
-          BOOST_AFIO_V2_NAMESPACE::path oldpath;
-          {
-            lock_guard<pathlock_t> g(pathlock);
-            oldpath=std::move(_path);
-            _path=req.path;
-          }
-          update_path(oldpath, req.path);
+            return *ret;
         }
+    private:
+        thread_op_stats(const thread_op_stats &) = delete;
+        thread_op_stats &operator=(const thread_op_stats &) = delete;
     };
-
-    struct async_file_io_dispatcher_op
+    /* Every op's latencies are recorded by the thread completing it into that thread's own
+    thread_op_stats, so no cache line is written by more than one thread. Each thread finds its
+    thread_op_stats for a dispatcher through a small thread local cache keyed by a process unique
+    id for that dispatcher, as threads in a shared thread source may well outlive dispatchers,
+    and only takes the registry lock on a cache miss. Blocks are freed with the dispatcher.
+    */
+    class op_stats_registry
     {
-        OpType optype;
-        async_op_flags flags;
-        enqueued_task<handle_ptr()> enqueuement;
-        typedef std::pair<size_t, std::shared_ptr<detail::async_file_io_dispatcher_op>> completion_t;
-        std::vector<completion_t> completions;
-        const shared_future<handle_ptr> &h() const { return enqueuement.get_future(); }
-#ifdef BOOST_AFIO_OP_STACKBACKTRACEDEPTH
-        stack_type stack;
-        void fillStack() { collect_stack(stack); }
-#else
-        void fillStack() { }
-#endif
-        async_file_io_dispatcher_op(OpType _optype, async_op_flags _flags)
-            : optype(_optype), flags(_flags)
+        struct cache_entry
         {
-            // Stop the stl_future from being auto-set on task return
-            enqueuement.disable_auto_set_future();
-            //completions.reserve(4); // stop needless storage doubling for small numbers
-            fillStack();
+            size_t uid;
+            thread_op_stats *stats;
+        };
+        static constexpr size_t cache_entries=4;
+        static size_t next_uid()
+        {
+            static atomic<size_t> count(0);
+            return ++count;
         }
-        async_file_io_dispatcher_op(async_file_io_dispatcher_op &&o) noexcept : optype(o.optype), flags(std::move(o.flags)),
-            enqueuement(std::move(o.enqueuement)), completions(std::move(o.completions))
-#ifdef BOOST_AFIO_OP_STACKBACKTRACEDEPTH
-            , stack(std::move(o.stack))
-#endif
+        const size_t uid;
+        typedef spinlock<bool> lock_t;
+        mutable lock_t lock;
+        std::vector<std::unique_ptr<thread_op_stats>> threads;
+        dispatcher_stats baseline;
+        thread_op_stats &this_thread_stats()
+        {
+            static BOOST_AFIO_THREAD_LOCAL cache_entry cache[cache_entries];
+            if(cache[0].uid==uid)
+                return *cache[0].stats;
+            size_t n=1;
+            for(; n<cache_entries-1 && cache[n].uid!=uid; n++);
+            cache_entry entry=cache[n];
+            if(entry.uid!=uid)
             {
+                entry.uid=uid;
+                entry.stats=nullptr;
+                auto me=this_thread::get_id();
+                lock_guard<lock_t> g(lock);
+                for(auto &i: threads)
+                    if(i->owner==me)
+                        entry.stats=i.get();
+                if(!entry.stats)
+                {
+                    threads.push_back(detail::make_unique<thread_op_stats>());
+                    entry.stats=threads.back().get();
+                }
             }
-    private:
-        async_file_io_dispatcher_op(const async_file_io_dispatcher_op &o) = delete;
+            // Move to the front, evicting the least recently used
+            for(; n; n--)
+                cache[n]=cache[n-1];
+            cache[0]=entry;
+            return *entry.stats;
+        }
+    public:
+        op_stats_registry() : uid(next_uid()) { }
+        // Records an op scheduled, started and completed at these steady_clock times
+        void record(OpType optype, chrono::steady_clock::rep scheduled, chrono::steady_clock::rep started, chrono::steady_clock::rep completed)
+        {
+            auto ns=[](chrono::steady_clock::rep d) -> unsigned long long {
+                auto ret=chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::duration(d)).count();
+                return ret>0 ? (unsigned long long) ret : 0;
+            };
+            op_latency_recorders &r=this_thread_stats()[optype];
+            r.queued.record(ns(started-scheduled));
+            r.executing.record(ns(completed-started));
+            r.total.record(ns(completed-scheduled));
+        }
+        dispatcher_stats snapshot() const
+        {
+            dispatcher_stats ret;
+            lock_guard<lock_t> g(lock);
+            for(auto &t: threads)
+                for(size_t n=0; n<(size_t) OpType::Last; n++)
+                    if(op_latency_recorders *r=t->optypes[n].load(memory_order_acquire))
+                    {
+                        op_latencies &o=ret[(OpType) n];
+                        r->queued.snapshot(o.queued);
+                        r->executing.snapshot(o.executing);
+                        r->total.snapshot(o.total);
+                    }
+            ret-=baseline;
+            return ret;
+        }
+        void reset()
+        {
+            dispatcher_stats now=snapshot();
+            lock_guard<lock_t> g(lock);
+            baseline+=now;
+        }
     };
     struct dispatcher_p
     {
@@ -1285,38 +2851,195 @@ update_path:
         std::vector<std::pair<detail::OpType, std::function<dispatcher::filter_t>>> filters;
         std::vector<std::pair<detail::OpType, std::function<dispatcher::filter_readwrite_t>>> filters_buffers;
 
-#ifdef BOOST_AFIO_USE_CONCURRENT_UNORDERED_MAP
-        typedef null_lock fdslock_t;
-        typedef null_lock opslock_t;
-#else
         typedef spinlock<size_t> fdslock_t;
-        typedef spinlock<size_t,
-            spins_to_loop<100>::policy,
-            spins_to_yield<500>::policy,
-            spins_to_sleep::policy
-        > opslock_t;
-#endif
         typedef recursive_mutex dircachelock_t;
         fdslock_t fdslock; engine_unordered_map_t<void *, std::weak_ptr<handle>> fds;
-        opslock_t opslock; atomic<size_t> monotoniccount; engine_unordered_map_t<size_t, std::shared_ptr<async_file_io_dispatcher_op>> ops;
+        atomic<size_t> monotoniccount; async_file_io_dispatcher_op_table ops;
+        atomic<size_t> inlinedepth;
+        atomic<size_t> kernelqueueops;  // Ops completed by a kernel i/o queue's reaper
+        atomic<size_t> priorities[(size_t) OpType::Last];
+        // Admission control, where zero limits are unlimited
+        atomic<size_t> maxinflight, maxinflightperhandle;
+        atomic<bool> admissionwouldblock, overlimit;
+        size_t lowwatermark; std::function<void()> lowwatermarkcallback;  // Both guarded by admissionlock
+        typedef spinlock<bool> perhandlelock_t;
+        perhandlelock_t perhandlelock; std::unordered_map<handle *, size_t> perhandle;
+        mutex admissionlock; condition_variable admissioncv; atomic<size_t> admissionwaiters;
+        op_stats_registry stats;
+        // The stall detector, whose thread only runs while configured
+        mutex stalllock; condition_variable stallcv; bool stallstop; thread stallthread;
+        size_t stallcursor;  // The op table shard the next scan starts from
         dircachelock_t dircachelock; std::unordered_map<path, std::weak_ptr<handle>, path_hash> dirhcache;
 
         dispatcher_p(std::shared_ptr<thread_source> _pool, file_flags _flagsforce, file_flags _flagsmask) : pool(_pool),
-            testing_flags(unit_testing_flags::none), flagsforce(_flagsforce), flagsmask(_flagsmask), monotoniccount(0)
-        {
-#ifdef BOOST_AFIO_USE_CONCURRENT_UNORDERED_MAP
-            // concurrent_unordered_map doesn't lock, so we actually don't need many buckets for max performance
-            fds.min_bucket_capacity(2);
-            fds.reserve(499);
-            ops.min_bucket_capacity(2);
-            ops.reserve(499);
-#else
-            // unordered_map needs to release the lock as quickly as possible
-            ops.reserve(10000);
-#endif
+            testing_flags(unit_testing_flags::none), flagsforce(_flagsforce), flagsmask(_flagsmask), monotoniccount(0), inlinedepth(BOOST_AFIO_INLINE_CONTINUATION_DEPTH), kernelqueueops(0),
+            maxinflight(0), maxinflightperhandle(0), admissionwouldblock(false), overlimit(false), lowwatermark(0), admissionwaiters(0),
+            stallstop(false), stallcursor(0)
+        {
+            for(auto &i: priorities)
+                i=(size_t) async_op_flags::none;
         }
         ~dispatcher_p()
         {
+            stop_stall_detector();
+        }
+        void start_stall_detector(chrono::steady_clock::duration threshold, std::function<dispatcher::stall_handler_t> callback, chrono::steady_clock::duration period)
+        {
+            stallstop=false;
+            stallthread=thread([this, threshold, callback, period]{
+                unique_lock<mutex> g(stalllock);
+                while(!stallstop)
+                {
+                    stallcv.wait_for(g, period);
+                    if(stallstop)
+                        break;
+                    g.unlock();
+                    scan_for_stalls(threshold, callback);
+                    g.lock();
+                }
+            });
+        }
+        void stop_stall_detector()
+        {
+            {
+                lock_guard<mutex> g(stalllock);
+                stallstop=true;
+            }
+            stallcv.notify_all();
+            if(stallthread.joinable())
+                stallthread.join();
+        }
+        // Examines the next BOOST_AFIO_STALL_DETECTOR_SCAN_BUDGET or so ops in flight, reporting those in flight
+        // for longer than threshold. Only the ops are noted under the shard locks, the callback is invoked after.
+        void scan_for_stalls(chrono::steady_clock::duration threshold, const std::function<dispatcher::stall_handler_t> &callback)
+        {
+            struct stalled_t
+            {
+                size_t id;
+                async_file_io_dispatcher_op_table::op_ptr op;
+                handle_future preconditionh;
+                size_t dependents;
+            };
+            std::vector<stalled_t> stalled;
+            auto now=chrono::steady_clock::now().time_since_epoch().count();
+            auto scheduledbefore=now-threshold.count();
+            ops.scan(stallcursor, BOOST_AFIO_STALL_DETECTOR_SCAN_BUDGET, [&stalled, scheduledbefore](size_t id, const async_file_io_dispatcher_op_table::op_ptr &op){
+                // Ops waiting on a precondition still in flight are held up by it rather than stalled themselves
+                if(op->stallreported || op->scheduledat>scheduledbefore || (op->preconditionh.valid() && !op->preconditionh.is_ready()))
+                    return;
+                op->stallreported=true;
+                stalled_t i={ id, op, op->preconditionh, op->completions.size() };
+                stalled.push_back(std::move(i));
+            });
+            for(auto &i: stalled)
+            {
+                stalled_op s;
+                s.id=i.id;
+                s.optype=i.op->optype;
+                s.age=chrono::steady_clock::duration(now-i.op->scheduledat);
+                if(auto startedat=i.op->startedat.load(memory_order_relaxed))
+                    s.running=chrono::steady_clock::duration(now-startedat);
+                s.depth=i.op->depth.load(memory_order_relaxed);
+                s.dependents=i.dependents;
+                try
+                {
+                    if(i.preconditionh.is_ready() && !i.preconditionh.has_failed())
+                        if(auto &h=i.preconditionh.get())
+                            s.handle_path=h->path();
+                }
+                catch(...) { }
+#ifdef BOOST_AFIO_OP_STACKBACKTRACEDEPTH
+                if(!i.op->stack.empty())
+                {
+                    std::ostringstream buffer;
+                    print_stack(buffer, i.op->stack);
+                    s.stack=buffer.str();
+                }
+#endif
+                try { callback(s); } catch(...) { }
+            }
+        }
+        // Returns true if scheduling another op upon h, with pending ops already scheduled but not yet in
+        // the op table, would exceed the admission control limits
+        bool over_limits(handle *h, size_t pending)
+        {
+            size_t maxops=maxinflight.load(memory_order_relaxed);
+            if(maxops && ops.size()+pending>=maxops)
+                return true;
+            if(h)
+            {
+                lock_guard<perhandlelock_t> g(perhandlelock);
+                auto it=perhandle.find(h);
+                if(perhandle.end()!=it && it->second>=maxinflightperhandle.load(memory_order_relaxed))
+                    return true;
+            }
+            return false;
+        }
+        // Admits an op chained onto precondition for scheduling, blocking if need be after calling flush to
+        // schedule everything admitted but not yet scheduled. Returns false if the op would block instead.
+        template<class F> bool admit(const future<> &precondition, async_op_flags flags, size_t pending, handle_ptr &admittedh, F &&flush)
+        {
+            // Immediate ops run before the scheduling call returns anyway, and must not wait on themselves
+            if((!maxinflight.load(memory_order_relaxed) && !maxinflightperhandle.load(memory_order_relaxed)) || !!(flags & async_op_flags::immediate))
+                return true;
+            if(maxinflightperhandle.load(memory_order_relaxed) && precondition.valid() && precondition.has_value())
+                admittedh=precondition.get_handle(true);
+            if(over_limits(admittedh.get(), pending))
+            {
+                overlimit=true;
+                if(admissionwouldblock)
+                {
+                    admittedh.reset();
+                    return false;
+                }
+                flush();
+                unique_lock<mutex> g(admissionlock);
+                ++admissionwaiters;
+                admissioncv.wait(g, [this, &admittedh]{ return !over_limits(admittedh.get(), 0); });
+                --admissionwaiters;
+            }
+            if(admittedh)
+            {
+                lock_guard<perhandlelock_t> g(perhandlelock);
+                ++perhandle[admittedh.get()];
+            }
+            return true;
+        }
+        // Called after an admitted op leaves the op table
+        void release(handle_ptr &admittedh)
+        {
+            if(admittedh)
+            {
+                lock_guard<perhandlelock_t> g(perhandlelock);
+                auto it=perhandle.find(admittedh.get());
+                if(perhandle.end()!=it && !--it->second)
+                    perhandle.erase(it);
+                admittedh.reset();
+            }
+            if(admissionwaiters)
+            {
+                lock_guard<mutex> g(admissionlock);
+                admissioncv.notify_all();
+            }
+            if(overlimit.load(memory_order_relaxed))
+            {
+                // The watermark may be reconfigured concurrently, but the callback runs unlocked as it may well schedule more ops
+                std::function<void()> callback;
+                {
+                    lock_guard<mutex> g(admissionlock);
+                    if(ops.size()<=lowwatermark && overlimit.exchange(false))
+                        callback=lowwatermarkcallback;
+                }
+                if(callback)
+                    callback();
+            }
+        }
+        // Fills in the priority configured for this type of op if none was specified
+        async_op_flags with_priority(OpType optype, async_op_flags flags) const
+        {
+            if(!(flags & (async_op_flags::latency_critical|async_op_flags::background)))
+                flags=flags|(async_op_flags) priorities[(size_t) optype].load(memory_order_relaxed);
+            return flags;
         }
 
         // Returns a handle to a directory from the cache, or creates a new directory handle.
@@ -1384,6 +3107,30 @@ update_path:
     class async_file_io_dispatcher_windows;
     class async_file_io_dispatcher_linux;
     class async_file_io_dispatcher_qnx;
+    // The thread source lane an op with these flags is scheduled from
+    inline work_lane lane_for(async_op_flags flags)
+    {
+        if(!!(flags & async_op_flags::latency_critical))
+            return work_lane::latency_critical;
+        if(!!(flags & async_op_flags::background))
+            return work_lane::background;
+        return work_lane::normal;
+    }
+    // How deeply this thread is currently nested within continuations run inline by complete_async_op()
+    inline size_t &inline_continuation_depth()
+    {
+        static BOOST_AFIO_THREAD_LOCAL size_t depth;
+        return depth;
+    }
+    // Consumes the request of a synchronous caller that the next op it schedules run on it, so ops
+    // scheduled from within that op are scheduled as usual
+    inline bool take_run_next_op_inline()
+    {
+        bool &v=run_next_op_inline();
+        bool ret=v;
+        v=false;
+        return ret;
+    }
     struct immediate_async_ops
     {
         typedef handle_ptr rettype;
@@ -1412,6 +3159,46 @@ update_path:
         immediate_async_ops(immediate_async_ops &&);
         immediate_async_ops &operator=(immediate_async_ops &&);
     };
+    // Ops scheduled by the vector APIs, collected so they can be entered into the op table,
+    // chained onto their preconditions and enqueued to the thread source in bulk
+    struct async_op_batch
+    {
+        immediate_async_ops &immediates;
+        size_t nextid, endid;
+        std::vector<std::pair<size_t, std::shared_ptr<async_file_io_dispatcher_op>>> ops;
+        std::vector<size_t> preconditions;
+
+        // Reserves a block of n consecutive op ids, none of which are zero
+        async_op_batch(atomic<size_t> &monotoniccount, immediate_async_ops &_immediates, size_t n) : immediates(_immediates)
+        {
+            do
+            {
+                nextid=monotoniccount.fetch_add(n)+1;
+                endid=nextid+n;
+            } while(!nextid || endid<nextid);
+            ops.reserve(n);
+            preconditions.reserve(n);
+        }
+        size_t next_id()
+        {
+            if(nextid==endid)
+                BOOST_AFIO_THROW_FATAL(std::runtime_error("More ops were added to a batch than it reserved ids for"));
+            return nextid++;
+        }
+        void add(size_t id, std::shared_ptr<async_file_io_dispatcher_op> op, size_t precondition)
+        {
+            ops.push_back(std::make_pair(id, std::move(op)));
+            preconditions.push_back(precondition);
+        }
+    private:
+        async_op_batch(const async_op_batch &);
+        async_op_batch &operator=(const async_op_batch &);
+    };
+    // Returns the future for an op refused by admission control
+    inline future<> would_block_future(dispatcher *parent)
+    {
+        return future<>(parent, 0, handle_future::from_exception(BOOST_AFIO_V2_NAMESPACE::make_exception_ptr(system_error(error_code(EWOULDBLOCK, generic_category()), "Too many ops are in flight"))), false, false);
+    }
 }
 
 BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC metadata_flags directory_entry::metadata_supported() noexcept
@@ -1601,48 +3388,129 @@ BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void dispatcher::testing_flags(detail::unit
   p->testing_flags=flags;
 }
 
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void dispatcher::inline_continuation_depth(size_t depth)
+{
+  p->inlinedepth.store(depth, memory_order_relaxed);
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC size_t dispatcher::inline_continuation_depth() const
+{
+  return p->inlinedepth.load(memory_order_relaxed);
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void dispatcher::op_priority(detail::OpType optype, async_op_flags priority)
+{
+  if((size_t) optype>=(size_t) detail::OpType::Last)
+    BOOST_AFIO_THROW(std::invalid_argument("Unknown op type"));
+  p->priorities[(size_t) optype].store((size_t) (priority & (async_op_flags::latency_critical|async_op_flags::background)), memory_order_relaxed);
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC async_op_flags dispatcher::op_priority(detail::OpType optype) const
+{
+  if((size_t) optype>=(size_t) detail::OpType::Last)
+    BOOST_AFIO_THROW(std::invalid_argument("Unknown op type"));
+  return (async_op_flags) p->priorities[(size_t) optype].load(memory_order_relaxed);
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC bool dispatcher::cancel(const future<> &op)
+{
+  auto thisop=p->ops.find(op.id());
+  if(!thisop || !thisop->cancel())
+    return false;
+  // If it is still waiting on its precondition then nothing else will ever complete it, so we must.
+  // Otherwise it has been queued, and completes itself when dequeued.
+  if(thisop->precondition && p->ops.remove_completion(thisop->precondition, op.id()))
+    complete_async_op(op.id(), thisop->not_started_exception());
+  return true;
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC bool dispatcher::deadline(const future<> &op, chrono::steady_clock::time_point when)
+{
+  auto thisop=p->ops.find(op.id());
+  if(!thisop || !thisop->cancellable() || detail::async_file_io_dispatcher_op::pending!=thisop->status)
+    return false;
+  // Never store zero, which means no deadline
+  auto d=when.time_since_epoch().count();
+  thisop->deadline.store(d ? d : 1, memory_order_relaxed);
+  return true;
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC dispatcher_stats dispatcher::stats() const
+{
+  return p->stats.snapshot();
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void dispatcher::reset_stats()
+{
+  p->stats.reset();
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void dispatcher::stall_detector(chrono::steady_clock::duration threshold, std::function<dispatcher::stall_handler_t> callback, chrono::steady_clock::duration period)
+{
+  p->stop_stall_detector();
+  if(callback)
+    p->start_stall_detector(threshold, std::move(callback), period);
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void dispatcher::admission_control(size_t maxops, size_t maxopsperhandle, admission_policy policy)
+{
+  p->admissionwouldblock=(admission_policy::would_block==policy);
+  p->maxinflightperhandle=maxopsperhandle;
+  p->maxinflight=maxops;
+  // Anyone blocked under the old limits needs to recheck against the new ones
+  lock_guard<mutex> g(p->admissionlock);
+  p->admissioncv.notify_all();
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void dispatcher::admission_low_watermark(size_t ops, std::function<void()> callback)
+{
+  lock_guard<mutex> g(p->admissionlock);
+  p->lowwatermark=ops;
+  p->lowwatermarkcallback=std::move(callback);
+}
+
 BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC dispatcher::~dispatcher()
 {
 #ifndef BOOST_AFIO_COMPILING_FOR_GCOV
     engine_unordered_map_t<const detail::async_file_io_dispatcher_op *, std::pair<size_t, future_status>> reallyoutstanding;
     for(;;)
     {
-        std::vector<std::pair<const size_t, std::shared_ptr<detail::async_file_io_dispatcher_op>>> outstanding;
+        std::vector<std::pair<size_t, std::shared_ptr<detail::async_file_io_dispatcher_op>>> outstanding;
+        size_t extant=p->ops.size();
+        if(extant)
         {
-            lock_guard<decltype(p->opslock)> g(p->opslock); // may have no effect under concurrent_unordered_map
-            if(!p->ops.empty())
-            {
-                outstanding.reserve(p->ops.size());
-                for(auto &op: p->ops)
+            outstanding.reserve(extant);
+            p->ops.for_each([&](size_t id, const std::shared_ptr<detail::async_file_io_dispatcher_op> &op){
+                if(op->h().valid())
                 {
-                    if(op.second->h().valid())
+                    auto it=reallyoutstanding.find(op.get());
+                    if(reallyoutstanding.end()!=it)
                     {
-                        auto it=reallyoutstanding.find(op.second.get());
-                        if(reallyoutstanding.end()!=it)
+                        if(it->second.first>=5)
                         {
-                            if(it->second.first>=5)
+                            static const char *statuses[]={ "ready", "timeout", "deferred", "unknown" };
+                            int status=static_cast<int>(it->second.second);
+                            BOOST_AFIO_LOG_FATAL_EXIT("WARNING: ~async_file_dispatcher_base() detects stuck future<> in total of " << extant << " extant ops\n"
+                                "   id=" << id << " type=" << detail::optypes[static_cast<size_t>(op->optype)] << " flags=0x" << std::hex << static_cast<size_t>(op->flags) << std::dec << " status=" << statuses[(status>=0 && status<=2) ? status : 3] << " failcount=" << it->second.first << " Completions:");
+                            for(auto &c: op->completions)
                             {
-                                static const char *statuses[]={ "ready", "timeout", "deferred", "unknown" };
-                                int status=static_cast<int>(it->second.second);
-                                BOOST_AFIO_LOG_FATAL_EXIT("WARNING: ~async_file_dispatcher_base() detects stuck future<> in total of " << p->ops.size() << " extant ops\n"
-                                    "   id=" << op.first << " type=" << detail::optypes[static_cast<size_t>(op.second->optype)] << " flags=0x" << std::hex << static_cast<size_t>(op.second->flags) << std::dec << " status=" << statuses[(status>=0 && status<=2) ? status : 3] << " failcount=" << it->second.first << " Completions:");
-                                for(auto &c: op.second->completions)
-                                {
-                                    BOOST_AFIO_LOG_FATAL_EXIT(" id=" << c.first);
-                                }
-                                BOOST_AFIO_LOG_FATAL_EXIT(std::endl);
+                                BOOST_AFIO_LOG_FATAL_EXIT(" id=" << c.first);
+                            }
+                            BOOST_AFIO_LOG_FATAL_EXIT(std::endl);
 #ifdef BOOST_AFIO_OP_STACKBACKTRACEDEPTH
-                                BOOST_AFIO_LOG_FATAL_EXIT("  Allocation backtrace:" << std::endl);
-                                std::stringstream stacktxt;
-                                print_stack(stacktxt, op.second->stack);
-                                BOOST_AFIO_LOG_FATAL_EXIT(stacktxt.str() << std::endl);
-#endif
+                            if(!op->stack.empty())
+                            {
+                              BOOST_AFIO_LOG_FATAL_EXIT("  Allocation backtrace:" << std::endl);
+                              std::stringstream stacktxt;
+                              print_stack(stacktxt, op->stack);
+                              BOOST_AFIO_LOG_FATAL_EXIT(stacktxt.str() << std::endl);
                             }
+#endif
                         }
-                        outstanding.push_back(op);
                     }
+                    outstanding.push_back(std::make_pair(id, op));
                 }
-            }
+            });
         }
         if(outstanding.empty()) break;
         size_t mincount=(size_t)-1;
@@ -1720,12 +3588,12 @@ BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC file_flags dispatcher::fileflags(file_flags
 
 BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC size_t dispatcher::wait_queue_depth() const
 {
-    size_t ret=0;
-    {
-        lock_guard<decltype(p->opslock)> g(p->opslock);
-        ret=p->ops.size();
-    }
-    return ret;
+    return p->ops.size();
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC size_t dispatcher::kernel_queue_ops() const
+{
+    return p->kernelqueueops.load(memory_order_relaxed);
 }
 
 BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC size_t dispatcher::fd_count() const
@@ -1761,33 +3629,16 @@ BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void dispatcher::int_directory_cached_handl
 // Non op lock holding variant
 BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC future<> dispatcher::int_op_from_scheduled_id(size_t id) const
 {
-#ifdef BOOST_AFIO_USE_CONCURRENT_UNORDERED_MAP
-    future<> ret;
-    typedef decltype(p->ops)::value_type op_value_type;
-    if(!p->ops.visit(id, [this, id, &ret](const op_value_type &op){
-        ret=future<>(const_cast<dispatcher *>(this), id, op.second->h());
-    }))
-    {
-        BOOST_AFIO_THROW(std::runtime_error("Failed to find this operation in list of currently executing operations"));
-    }
-    return ret;
-#else
-    engine_unordered_map_t<size_t, std::shared_ptr<detail::async_file_io_dispatcher_op>>::iterator it=p->ops.find(id);
-    if(p->ops.end()==it)
+    auto op(p->ops.find(id));
+    if(!op)
     {
         BOOST_AFIO_THROW(std::runtime_error("Failed to find this operation in list of currently executing operations"));
     }
-    return future<>(const_cast<dispatcher *>(this), id, it->second->h());
-#endif
+    return future<>(const_cast<dispatcher *>(this), id, op->h());
 }
 BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC future<> dispatcher::op_from_scheduled_id(size_t id) const
 {
-    future<> ret;
-    {
-        lock_guard<decltype(p->opslock)> g(p->opslock);
-        ret=int_op_from_scheduled_id(id);
-    }
-    return ret;
+    return int_op_from_scheduled_id(id);
 }
 
 BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void dispatcher::post_op_filter_clear()
@@ -1822,16 +3673,18 @@ BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC std::vector<future<>> dispatcher::completio
     std::vector<future<>>::const_iterator i;
     std::vector<std::pair<async_op_flags, dispatcher::completion_t *>>::const_iterator c;
     detail::immediate_async_ops immediates(callbacks.size());
+    detail::async_op_batch batch(p->monotoniccount, immediates, callbacks.size());
     if(ops.empty())
     {
         future<> empty;
         for(auto & c: callbacks)
         {
-            ret.push_back(chain_async_op(immediates, (int) detail::OpType::UserCompletion, empty, c.first, &dispatcher::invoke_user_completion_fast, c.second));
+            ret.push_back(chain_async_op(batch, (int) detail::OpType::UserCompletion, empty, c.first, &dispatcher::invoke_user_completion_fast, c.second));
         }
     }
     else for(i=ops.begin(), c=callbacks.begin(); i!=ops.end() && c!=callbacks.end(); ++i, ++c)
-        ret.push_back(chain_async_op(immediates, (int) detail::OpType::UserCompletion, *i, c->first, &dispatcher::invoke_user_completion_fast, c->second));
+        ret.push_back(chain_async_op(batch, (int) detail::OpType::UserCompletion, *i, c->first, &dispatcher::invoke_user_completion_fast, c->second));
+    submit_async_ops(batch);
     return ret;
 }
 #endif
@@ -1849,60 +3702,74 @@ BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC std::vector<future<>> dispatcher::completio
     std::vector<future<>>::const_iterator i;
     std::vector<std::pair<async_op_flags, std::function<dispatcher::completion_t>>>::const_iterator c;
     detail::immediate_async_ops immediates(callbacks.size());
+    detail::async_op_batch batch(p->monotoniccount, immediates, callbacks.size());
     if(ops.empty())
     {
         future<> empty;
         for(auto & c: callbacks)
         {
-            ret.push_back(chain_async_op(immediates, (int) detail::OpType::UserCompletion, empty, c.first, &dispatcher::invoke_user_completion_slow, c.second));
+            ret.push_back(chain_async_op(batch, (int) detail::OpType::UserCompletion, empty, c.first, &dispatcher::invoke_user_completion_slow, c.second));
         }
     }
     else for(i=ops.begin(), c=callbacks.begin(); i!=ops.end() && c!=callbacks.end(); ++i, ++c)
-            ret.push_back(chain_async_op(immediates, (int) detail::OpType::UserCompletion, *i, c->first, &dispatcher::invoke_user_completion_slow, c->second));
+            ret.push_back(chain_async_op(batch, (int) detail::OpType::UserCompletion, *i, c->first, &dispatcher::invoke_user_completion_slow, c->second));
+    submit_async_ops(batch);
+    return ret;
+}
+
+// Called in unknown thread
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC dispatcher::completion_returntype dispatcher::invoke_user_completion_inline(size_t id, future<> op, const detail::inline_completion &callback)
+{
+    return callback(id, std::move(op));
+}
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC std::vector<future<>> dispatcher::int_completion(const std::vector<future<>> &ops, async_op_flags flags, const detail::inline_completion &callback)
+{
+    std::vector<future<>> ret;
+    ret.reserve(ops.size());
+    detail::immediate_async_ops immediates(ops.size());
+    detail::async_op_batch batch(p->monotoniccount, immediates, ops.size());
+    // Each op binds its own copy of the callable inline within its task state, which is invoked from there
+    for(auto &i: ops)
+        ret.push_back(chain_async_op<dispatcher, const detail::inline_completion &>(batch, (int) detail::OpType::UserCompletion, i, flags, &dispatcher::invoke_user_completion_inline, callback));
+    submit_async_ops(batch);
     return ret;
 }
 
 // Called in unknown thread
 BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void dispatcher::complete_async_op(size_t id, handle_ptr h, exception_ptr e)
+{
+    int_complete_async_op(id, std::move(h), std::move(e), error_code());
+}
+
+// Called in unknown thread
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void dispatcher::complete_async_op(size_t id, error_code ec)
+{
+    int_complete_async_op(id, handle_ptr(), exception_ptr(), ec);
+}
+
+// Called in unknown thread
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void dispatcher::int_complete_async_op(size_t id, handle_ptr h, exception_ptr e, error_code ec)
 {
     detail::immediate_async_ops immediates(1);
     std::shared_ptr<detail::async_file_io_dispatcher_op> thisop;
-    std::vector<detail::async_file_io_dispatcher_op::completion_t> completions;
+    detail::async_file_io_dispatcher_op::completions_t completions;
+    // Find me in ops, remove me from extant ops and detach my completions.
+    // Because chain_async_op() appends to an op's completions under the same shard
+    // lock as this removal, we can now safely process them from stack storage
+    // without holding any locks
+    thisop=p->ops.extract(id, completions);
+    if(!thisop)
     {
-#ifdef BOOST_AFIO_USE_CONCURRENT_UNORDERED_MAP
-        // We can atomically remove without destruction
-        auto np=p->ops.extract(id);
-        if(!np)
-#else
-        lock_guard<decltype(p->opslock)> g(p->opslock);
-        // Find me in ops, remove my completions and delete me from extant ops
-        auto it=p->ops.find(id);
-        if(p->ops.end()==it)
-#endif
-        {
 #ifndef NDEBUG
-            std::vector<size_t> opsids;
-            for(auto &i: p->ops)
-            {
-                opsids.push_back(i.first);
-            }
-            std::sort(opsids.begin(), opsids.end());
-#endif
-            BOOST_AFIO_THROW_FATAL(std::runtime_error("Failed to find this operation in list of currently executing operations"));
-        }
-#ifdef BOOST_AFIO_USE_CONCURRENT_UNORDERED_MAP
-        thisop.swap(np->second);
-#else
-        thisop.swap(it->second); // thisop=it->second;
-        // Erase me from ops
-        p->ops.erase(it);
+        std::vector<size_t> opsids(p->ops.ids());
 #endif
-        // Ok so this op is now removed from the ops list.
-        // Because chain_async_op() holds the opslock during the finding of preconditions
-        // and adding ops to its completions, we can now safely detach our completions
-        // into stack storage and process them from there without holding any locks
-        completions=std::move(thisop->completions);
+        BOOST_AFIO_THROW_FATAL(std::runtime_error("Failed to find this operation in list of currently executing operations"));
     }
+    BOOST_AFIO_TRACE_OP(detail::op_trace_event::completed, thisop->optype, id);
+    thisop->preconditionh=detail::handle_future();
+    if(auto startedat=thisop->startedat.load(memory_order_relaxed))
+        p->stats.record(thisop->optype, thisop->scheduledat, startedat, chrono::steady_clock::now().time_since_epoch().count());
+    p->release(thisop->admittedh);
     // Early set stl_future
     if(e)
     {
@@ -1924,8 +3791,14 @@ BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void dispatcher::complete_async_op(size_t i
           {
             // Append the stack to the runtime error message
             std::ostringstream buffer;
-            buffer << originalmsg << ". Op was scheduled at:\n";
-            print_stack(buffer, thisop->stack);
+            buffer << originalmsg << ".";
+            if(!thisop->stack.empty())
+            {
+              buffer << " Op was scheduled at:\n";
+              print_stack(buffer, thisop->stack);
+            }
+            else
+              buffer << " Op was not sampled for a backtrace of where it was scheduled.\n";
             buffer << "Exceptions were thrown within the engine at:\n";
             for(auto &i : *afio_exception_stack())
             {
@@ -1949,6 +3822,11 @@ BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void dispatcher::complete_async_op(size_t i
         assert(thisop->enqueuement.get_future().get_exception_ptr()==e);
         assert(thisop->h().get_exception_ptr()==e);*/
     }
+    else if(ec)
+    {
+        // Routine failures skip making an exception and the backtrace both
+        thisop->enqueuement.set_future_error(ec);
+    }
     else
     {
         thisop->enqueuement.set_future_value(h);
@@ -1961,7 +3839,7 @@ BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void dispatcher::complete_async_op(size_t i
         assert(thisop->enqueuement.get_future().get()==h);
         assert(thisop->h().get()==h);*/
     }
-    BOOST_AFIO_DEBUG_PRINT("X %u %p e=%d f=%p (uc=%u, c=%u)\n", (unsigned) id, h.get(), !!e, &thisop->h(), (unsigned) h.use_count(), (unsigned) thisop->completions.size());
+    BOOST_AFIO_DEBUG_PRINT("X %u %p e=%d f=%p (uc=%u, c=%u)\n", (unsigned) id, h.get(), !!e || !!ec, (void *) thisop.get(), (unsigned) h.use_count(), (unsigned) thisop->completions.size());
     // Any post op filters installed? If so, invoke those now.
     if(!p->filters.empty())
     {
@@ -1981,21 +3859,96 @@ BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void dispatcher::complete_async_op(size_t i
             }
         }
     }
+    // The next op on the strand may now start
+    if(thisop->strand && thisop->strand->complete())
+    {
+        handle_ptr sh(std::move(thisop->strandh));
+        detail::op_strand *s=thisop->strand;
+        p->pool->enqueue([sh, s]{ s->drain(); });
+    }
     if(!completions.empty())
     {
+        // Whatever was waiting on an op which never ran is moot, so cancel that too
+        if(thisop->status>=detail::async_file_io_dispatcher_op::canceled)
+        {
+            for(auto &c: completions)
+                c.second->cancel();
+        }
+        // If permitted, keep the most urgent non-immediate continuation back and run it ourselves
+        // rather than paying for a round trip through the thread source. The depth of
+        // nesting is bounded per thread so long chains can't overflow the stack.
+        detail::async_file_io_dispatcher_op *runinline=nullptr;
+        size_t &depth=detail::inline_continuation_depth();
+        bool caninline=depth<p->inlinedepth.load(memory_order_relaxed);
         for(auto &c: completions)
         {
             detail::async_file_io_dispatcher_op *c_op=c.second.get();
             BOOST_AFIO_DEBUG_PRINT("X %u (f=%u) > %u\n", (unsigned) id, (unsigned) c_op->flags, (unsigned) c.first);
             if(!!(c_op->flags & async_op_flags::immediate))
                 immediates.enqueue(c_op->enqueuement);
+            else if(!e && !ec && int_strand_op(c.second, h))
+                continue;
+            else if(caninline && (!runinline || detail::lane_for(c_op->flags)<detail::lane_for(runinline->flags)))
+            {
+                if(runinline)
+                    p->pool->enqueue(runinline->enqueuement, detail::lane_for(runinline->flags));
+                runinline=c_op;
+            }
             else
-                p->pool->enqueue(c_op->enqueuement);
+                p->pool->enqueue(c_op->enqueuement, detail::lane_for(c_op->flags));
+        }
+        // Running it ourselves would jump the queue if more urgent work is waiting for a thread
+        if(runinline && !p->pool->none_more_urgent(detail::lane_for(runinline->flags)))
+        {
+            p->pool->enqueue(runinline->enqueuement, detail::lane_for(runinline->flags));
+            runinline=nullptr;
+        }
+        if(runinline)
+        {
+            ++depth;
+            auto undepth=detail::Undoer([&depth]{ --depth; });
+            runinline->enqueuement();
         }
     }
 }
 
 
+namespace detail
+{
+    template<size_t... I> struct index_sequence { };
+    template<size_t N, size_t... I> struct make_index_sequence : make_index_sequence<N-1, N-1, I...> { };
+    template<size_t... I> struct make_index_sequence<0, I...> { typedef index_sequence<I...> type; };
+    /* What an op runs once dequeued. A lambda capturing the args of the implementation routine
+    would copy them, heap allocated buffer lists and all, and C++11 cannot move into a lambda
+    capture. So they are moved into a tuple here instead, and moved on into the routine when
+    run, which as a task only ever runs once is safe. Routines taking a const reference, such
+    as to a user completion, are handed the copy kept here instead.
+    */
+    template<class F, class... Args> struct async_op_closure
+    {
+        dispatcher *parent;
+        async_file_io_dispatcher_op *op;
+        size_t id;
+        future<> precondition;
+        dispatcher::completion_returntype(F::*f)(size_t, future<>, Args...);
+        std::tuple<typename std::decay<Args>::type...> args;
+        async_op_closure(dispatcher *_parent, async_file_io_dispatcher_op *_op, size_t _id, const future<> &_precondition, dispatcher::completion_returntype(F::*_f)(size_t, future<>, Args...), Args &&... _args)
+            : parent(_parent), op(_op), id(_id), precondition(_precondition), f(_f), args(std::move(_args)...) { }
+        handle_ptr operator()() { return invoke(typename make_index_sequence<sizeof...(Args)>::type()); }
+        template<size_t... I> handle_ptr invoke(index_sequence<I...>)
+        {
+            BOOST_AFIO_TRACE_OP(op_trace_event::dequeued, op->optype, id);
+            // Ops cancelled or past their deadline are dropped here rather than executed
+            if(!op->start())
+            {
+                parent->complete_async_op(id, op->not_started_exception());
+                return handle_ptr();
+            }
+            return parent->invoke_async_op_completions<F, Args...>(id, std::move(precondition), f, std::move(std::get<I>(args))...);
+        }
+    };
+}
+
 // Called in unknown thread 
 template<class F, class... Args> BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC handle_ptr dispatcher::invoke_async_op_completions(size_t id, future<> op, completion_returntype(F::*f)(size_t, future<>, Args...), Args... args)
 {
@@ -2003,24 +3956,13 @@ template<class F, class... Args> BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC handle_ptr
     {
 #ifndef NDEBUG
         // Find our op
+        if(!p->ops.find(id))
         {
-            lock_guard<decltype(p->opslock)> g(p->opslock);
-            auto it(p->ops.find(id));
-            if(p->ops.end()==it)
-            {
-#ifndef NDEBUG
-                std::vector<size_t> opsids;
-                for(auto &i: p->ops)
-                {
-                    opsids.push_back(i.first);
-                }
-                std::sort(opsids.begin(), opsids.end());
-#endif
-                BOOST_AFIO_THROW_FATAL(std::runtime_error("Failed to find this operation in list of currently executing operations"));
-            }
+            std::vector<size_t> opsids(p->ops.ids());
+            BOOST_AFIO_THROW_FATAL(std::runtime_error("Failed to find this operation in list of currently executing operations"));
         }
 #endif
-        completion_returntype ret((static_cast<F *>(this)->*f)(id, std::move(op), args...));
+        completion_returntype ret((static_cast<F *>(this)->*f)(id, std::move(op), std::move(args)...));
         // If boolean is false, reschedule completion notification setting it to ret.second, otherwise complete now
         if(ret.first)
         {
@@ -2042,117 +3984,64 @@ template<class F, class... Args> BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC handle_ptr
 }
 
 
-// You MUST hold opslock before entry!
+// Admits and prepares a new op ready for scheduling, returning null if admission control refused it.
+// The op takes over the admission, so from here on whoever fails to schedule it must release thisop->admittedh.
+template<class F, class Flush, class... Args> BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC std::shared_ptr<detail::async_file_io_dispatcher_op> dispatcher::prepare_async_op(size_t thisid, int optype, const future<> &precondition, async_op_flags flags, size_t pending, Flush &&flush, completion_returntype(F::*f)(size_t, future<>, Args...), Args... args)
+{
+    handle_ptr admittedh;
+    if(!p->admit(precondition, flags, pending, admittedh, std::forward<Flush>(flush)))
+        return std::shared_ptr<detail::async_file_io_dispatcher_op>();
+    auto unadmit=detail::Undoer([this, &admittedh](){ p->release(admittedh); });
+    flags=p->with_priority((detail::OpType) optype, flags);
+    // Op records are recycled through per-thread free lists
+    auto thisop=std::allocate_shared<detail::async_file_io_dispatcher_op>(detail::op_pool_allocator<detail::async_file_io_dispatcher_op>(), (detail::OpType) optype, flags);
+    // Bind supplied implementation routine wrapped with a completion dispatcher to this, unique id,
+    // precondition and any args they passed. The closure lives inline in the task state and takes
+    // the args by move, so for the common argument packs binding does not allocate.
+    detail::async_file_io_dispatcher_op *op=thisop.get();
+    thisop->enqueuement.set_task(detail::async_op_closure<F, Args...>(this, op, thisid, precondition, f, std::move(args)...));
+    thisop->precondition=precondition.id();
+    thisop->preconditionh=precondition._h;
+    BOOST_AFIO_TRACE_OP(detail::op_trace_event::scheduled, (detail::OpType) optype, thisid, precondition.id());
+    thisop->admittedh=std::move(admittedh);
+    unadmit.dismiss();
+    return thisop;
+}
+
 template<class F, class... Args> BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC future<> dispatcher::chain_async_op(detail::immediate_async_ops &immediates, int optype, const future<> &precondition, async_op_flags flags, completion_returntype(F::*f)(size_t, future<>, Args...), Args... args)
 {   
     size_t thisid=0;
     while(!(thisid=++p->monotoniccount));
-#if 0 //ndef NDEBUG
-    if(!p->ops.empty())
-    {
-        std::vector<size_t> opsids;
-        for(auto &i: p->ops)
-        {
-            opsids.push_back(i.first);
-        }
-        std::sort(opsids.begin(), opsids.end());
-        assert(thisid==opsids.back()+1);
-    }
-#endif
-    // Wrap supplied implementation routine with a completion dispatcher
-    auto wrapperf=&dispatcher::invoke_async_op_completions<F, Args...>;
-    // Make a new future<> ready for returning
-    auto thisop=std::make_shared<detail::async_file_io_dispatcher_op>((detail::OpType) optype, flags);
-    // Bind supplied implementation routine to this, unique id, precondition and any args they passed
-    thisop->enqueuement.set_task(std::bind(wrapperf, this, thisid, precondition, f, args...));
+    auto thisop=prepare_async_op(thisid, optype, precondition, flags, 0, []{}, f, std::move(args)...);
+    if(!thisop)
+        return detail::would_block_future(this);
+    flags=thisop->flags;
     // Set the output shared stl_future
     future<> ret(this, thisid, thisop->h());
     typename detail::async_file_io_dispatcher_op::completion_t item(std::make_pair(thisid, thisop));
     bool done=false;
-    auto unopsit=detail::Undoer([this, thisid](){
+    auto unopsit=detail::Undoer([this, thisid, &thisop](){
         std::string what;
         try { throw; } catch(std::exception &e) { what=e.what(); } catch(...) { what="not a std exception"; }
         BOOST_AFIO_DEBUG_PRINT("E X %u (%s)\n", (unsigned) thisid, what.c_str());
-        {
-#ifdef BOOST_AFIO_USE_CONCURRENT_UNORDERED_MAP
-            p->ops.erase(thisid);
-#else
-            lock_guard<decltype(p->opslock)> g(p->opslock);
-            auto opsit=p->ops.find(thisid);
-            if(p->ops.end()!=opsit) p->ops.erase(opsit);
-#endif
-        }
+        p->ops.erase(thisid);
+        p->release(thisop->admittedh);
     });
-#ifdef BOOST_AFIO_USE_CONCURRENT_UNORDERED_MAP
-    p->ops.insert(item);
+    // Insert ourselves before chaining onto our precondition, as the precondition may
+    // complete and execute us before we even return from here
+    bool inserted=p->ops.insert(thisid, thisop);
+    (void) inserted;
+    assert(inserted);
+    // If still in flight, chain item to be executed when precondition completes
     if(precondition.id())
-    {
-        // If still in flight, chain item to be executed when precondition completes
-        typedef typename decltype(p->ops)::value_type op_value_type;
-        p->ops.visit(precondition.id, [&item, &done](const op_value_type &dep){
-          dep.second->completions.push_back(item);
-          done=true;
-        });
-    }
-#else
-    {
-        /* This is a weird bug which took me several days to track down ...
-        It turns out that libstdc++ 4.8.0 will *move* insert item into
-        p->ops because item's type is not *exactly* the value_type wanted
-        by unordered_map. That destroys item for use later, which is
-        obviously _insane_. The workaround is to feed insert() a copy. */
-        auto item2(item);
-        {
-            lock_guard<decltype(p->opslock)> g(p->opslock);
-            auto opsit=p->ops.insert(std::move(item2));
-            assert(opsit.second);
-            if(precondition.id())
-            {
-                // If still in flight, chain item to be executed when precondition completes
-                auto dep(p->ops.find(precondition.id()));
-                if(p->ops.end()!=dep)
-                {
-                    dep->second->completions.push_back(item);
-                    done=true;
-                }
-            }
-        }
-    }
-#endif
+        done=p->ops.append_completion(precondition.id(), item);
     auto undep=detail::Undoer([done, this, &precondition, &item](){
         if(done)
-        {
-#ifdef BOOST_AFIO_USE_CONCURRENT_UNORDERED_MAP
-            typedef typename decltype(p->ops)::value_type op_value_type;
-            p->ops.visit(precondition.id(), [&item](const op_value_type &dep){
-                // Items may have been added by other threads ...
-                for(auto it=--dep.second->completions.end(); true; --it)
-                {
-                    if(it->first==item.first)
-                    {
-                        dep.second->completions.erase(it);
-                        break;
-                    }
-                    if(dep.second->completions.begin()==it) break;
-                }              
-            });
-#else
-            lock_guard<decltype(p->opslock)> g(p->opslock);
-            auto dep(p->ops.find(precondition.id()));
-            // Items may have been added by other threads ...
-            for(auto it=--dep->second->completions.end(); true; --it)
-            {
-                if(it->first==item.first)
-                {
-                    dep->second->completions.erase(it);
-                    break;
-                }
-                if(dep->second->completions.begin()==it) break;
-            }
-#endif
-        }
+            p->ops.remove_completion(precondition.id(), item.first);
     });
     BOOST_AFIO_DEBUG_PRINT("I %u (d=%d) < %u (%s)\n", (unsigned) thisid, done, (unsigned) precondition.id(), detail::optypes[static_cast<int>(optype)]);
+    // A synchronous caller about to wait on this op would rather it ran on this thread
+    bool runinline=detail::take_run_next_op_inline();
     if(!done)
     {
         // Bind input handle now and queue immediately to next available thread worker
@@ -2166,24 +4055,138 @@ template<class F, class... Args> BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC future<> d
 #endif
         if(!!(flags & async_op_flags::immediate))
             immediates.enqueue(thisop->enqueuement);
+        else if(int_strand_op(thisop, precondition._h))
+            ;  // the strand runs it in turn
+        else if(runinline)
+            immediates.enqueue(thisop->enqueuement);
         else
-            p->pool->enqueue(thisop->enqueuement);
+            p->pool->enqueue(thisop->enqueuement, detail::lane_for(flags));
     }
     undep.dismiss();
     unopsit.dismiss();
     return ret;
 }
 
+// As above, but only prepares the op, leaving it to submit_async_ops() to schedule it along with the rest of the batch
+template<class F, class... Args> BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC future<> dispatcher::chain_async_op(detail::async_op_batch &batch, int optype, const future<> &precondition, async_op_flags flags, completion_returntype(F::*f)(size_t, future<>, Args...), Args... args)
+{
+    // If we must wait for ops to complete, schedule what we have so far first, as it may be what we are waiting on
+    size_t thisid=batch.next_id();
+    auto thisop=prepare_async_op(thisid, optype, precondition, flags, batch.ops.size(), [this, &batch]{ submit_async_ops(batch); }, f, std::move(args)...);
+    if(!thisop)
+        return detail::would_block_future(this);
+    future<> ret(this, thisid, thisop->h());
+    batch.add(thisid, std::move(thisop), precondition.id());
+    return ret;
+}
+
+// Schedules a batch of prepared ops, taking each op table shard lock once per step rather than
+// once per op per step, and handing every op ready to run to the thread source in one go.
+// Leaves the batch empty, ready for more ops.
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC void dispatcher::submit_async_ops(detail::async_op_batch &batch)
+{
+    if(batch.ops.empty())
+        return;
+    auto unopsit=detail::Undoer([this, &batch](){
+        for(auto &i: batch.ops)
+        {
+            p->ops.erase(i.first);
+            p->release(i.second->admittedh);
+        }
+    });
+    // Insert ourselves before chaining onto our preconditions, as they may complete and
+    // execute us before we even return from here
+    bool inserted=p->ops.insert(batch.ops);
+    (void) inserted;
+    assert(inserted);
+    // Chain those with preconditions still in flight onto them
+    std::vector<std::pair<size_t, detail::async_file_io_dispatcher_op::completion_t>> chained;
+    std::vector<size_t> chainedidx;
+    std::vector<char> done;
+    for(size_t n=0; n<batch.ops.size(); n++)
+    {
+        if(batch.preconditions[n])
+        {
+            chained.push_back(std::make_pair(batch.preconditions[n], batch.ops[n]));
+            chainedidx.push_back(n);
+        }
+    }
+    if(!chained.empty())
+        p->ops.append_completions(chained, done);
+    auto undep=detail::Undoer([this, &chained, &done](){
+        for(size_t n=0; n<done.size(); n++)
+            if(done[n])
+                p->ops.remove_completion(chained[n].first, chained[n].second.first);
+    });
+    // Everything else can be queued immediately to the next available thread worker, in one go per lane,
+    // unless a synchronous caller is about to wait on it in which case it runs on this thread
+    bool runinline=detail::take_run_next_op_inline();
+    std::vector<enqueued_task<handle_ptr()>> ready[3];
+    for(size_t n=0, c=0; n<batch.ops.size(); n++)
+    {
+        if(c<chainedidx.size() && chainedidx[c]==n)
+        {
+            if(done[c++])
+                continue;
+        }
+        detail::async_file_io_dispatcher_op *op=batch.ops[n].second.get();
+        BOOST_AFIO_DEBUG_PRINT("I %u (d=0) < %u (%s)\n", (unsigned) batch.ops[n].first, (unsigned) batch.preconditions[n], detail::optypes[static_cast<int>(op->optype)]);
+        if(!!(op->flags & async_op_flags::immediate))
+            batch.immediates.enqueue(op->enqueuement);
+        else if(int_strand_op(batch.ops[n].second, op->preconditionh))
+            continue;
+        else if(runinline)
+            batch.immediates.enqueue(op->enqueuement);
+        else
+            ready[(size_t) detail::lane_for(op->flags)].push_back(op->enqueuement);
+    }
+    for(size_t n=0; n<3; n++)
+        if(!ready[n].empty())
+            p->pool->enqueue(ready[n].begin(), ready[n].end(), (detail::work_lane) n);
+    undep.dismiss();
+    unopsit.dismiss();
+    batch.ops.clear();
+    batch.preconditions.clear();
+}
+
+// Runs an op ready to run through the strand of its input handle, if it has one, returning false if it should be scheduled as usual
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC bool dispatcher::int_strand_op(const std::shared_ptr<detail::async_file_io_dispatcher_op> &op, const handle_ptr &h)
+{
+    if(!h || !(h->flags() & file_flags::strand) || !!(op->flags & async_op_flags::immediate) || !detail::strandable(op->optype))
+        return false;
+    detail::op_strand *s=h->int_strand();
+    if(!s)
+        return false;
+    op->strand=s;
+    op->strandh=h;
+    if(s->push(op))
+    {
+        handle_ptr sh(h);
+        p->pool->enqueue([sh, s]{ s->drain(); });
+    }
+    return true;
+}
+
+BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC bool dispatcher::int_strand_op(const std::shared_ptr<detail::async_file_io_dispatcher_op> &op, const detail::handle_future &precondition)
+{
+    // Only a precondition which completed without error supplies an input handle
+    if(!precondition.is_ready() || precondition.has_failed())
+        return false;
+    return int_strand_op(op, precondition.get());
+}
+
 // Generic op receiving specialisation i.e. precondition is also input op. Skips sanity checking.
 template<class F> BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC std::vector<future<>> dispatcher::chain_async_ops(int optype, const std::vector<future<>> &preconditions, async_op_flags flags, completion_returntype(F::*f)(size_t, future<>, future<>))
 {
   std::vector<future<>> ret;
   ret.reserve(preconditions.size());
   detail::immediate_async_ops immediates(preconditions.size());
+  detail::async_op_batch batch(p->monotoniccount, immediates, preconditions.size());
   for (auto &i : preconditions)
   {
-    ret.push_back(chain_async_op(immediates, optype, i, flags, f, i));
+    ret.push_back(chain_async_op(batch, optype, i, flags, f, i));
   }
+  submit_async_ops(batch);
   return ret;
 }
 // General non-specialised implementation taking some arbitrary parameter T with precondition
@@ -2195,10 +4198,12 @@ template<class F, class T> BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC std::vector<futu
   if (preconditions.size() != container.size())
     BOOST_AFIO_THROW(std::runtime_error("preconditions size does not match size of ops data"));
   detail::immediate_async_ops immediates(preconditions.size());
+  detail::async_op_batch batch(p->monotoniccount, immediates, preconditions.size());
   auto precondition_it = preconditions.cbegin();
   auto container_it = container.cbegin();
   for (; precondition_it != preconditions.cend() && container_it != container.cend(); ++precondition_it, ++container_it)
-    ret.push_back(chain_async_op(immediates, optype, *precondition_it, flags, f, *container_it));
+    ret.push_back(chain_async_op(batch, optype, *precondition_it, flags, f, *container_it));
+  submit_async_ops(batch);
   return ret;
 }
 // General non-specialised implementation taking some arbitrary parameter T containing precondition returning custom type
@@ -2207,11 +4212,13 @@ template<class R, class F> BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC std::vector<futu
   std::vector<future<R>> ret;
   ret.reserve(preconditions.size());
   detail::immediate_async_ops immediates(preconditions.size());
+  detail::async_op_batch batch(p->monotoniccount, immediates, preconditions.size());
   for (auto &i : preconditions)
   {
     auto s(std::make_shared<promise<R>>());
-    ret.push_back(future<R>(chain_async_op(immediates, optype, i, flags, f, s), s->get_future()));
+    ret.push_back(future<R>(chain_async_op(batch, optype, i, flags, f, s), s->get_future()));
   }
+  submit_async_ops(batch);
   return ret;
 }
 // General non-specialised implementation taking some arbitrary parameter T with precondition returning custom type
@@ -2223,13 +4230,15 @@ template<class R, class F, class T> BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC std::ve
   if (preconditions.size() != container.size())
     BOOST_AFIO_THROW(std::runtime_error("preconditions size does not match size of ops data"));
   detail::immediate_async_ops immediates(preconditions.size());
+  detail::async_op_batch batch(p->monotoniccount, immediates, preconditions.size());
   auto precondition_it = preconditions.cbegin();
   auto container_it = container.cbegin();
   for (; precondition_it != preconditions.cend() && container_it != container.cend(); ++precondition_it, ++container_it)
   {
     auto s(std::make_shared<promise<R>>());
-    ret.push_back(future<R>(chain_async_op(immediates, optype, *precondition_it, flags, f, *container_it, s), s->get_future()));
+    ret.push_back(future<R>(chain_async_op(batch, optype, *precondition_it, flags, f, *container_it, s), s->get_future()));
   }
+  submit_async_ops(batch);
   return ret;
 }
 // General non-specialised implementation taking some arbitrary parameter T containing precondition
@@ -2238,10 +4247,12 @@ template<class F, class T> BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC std::vector<futu
   std::vector<future<>> ret;
   ret.reserve(container.size());
   detail::immediate_async_ops immediates(container.size());
+  detail::async_op_batch batch(p->monotoniccount, immediates, container.size());
   for (auto &i : container)
   {
-    ret.push_back(chain_async_op(immediates, optype, i.precondition, flags, f, i));
+    ret.push_back(chain_async_op(batch, optype, i.precondition, flags, f, i));
   }
+  submit_async_ops(batch);
   return ret;
 }
 // General non-specialised implementation taking some arbitrary parameter T containing precondition returning custom type
@@ -2250,11 +4261,13 @@ template<class R, class F, class T> BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC std::ve
   std::vector<future<R>> ret;
   ret.reserve(container.size());
   detail::immediate_async_ops immediates(container.size());
+  detail::async_op_batch batch(p->monotoniccount, immediates, container.size());
   for (auto &i : container)
   {
     auto s(std::make_shared<promise<R>>());
-    ret.push_back(future<R>(chain_async_op(immediates, optype, i.precondition, flags, f, i, s), s->get_future()));
+    ret.push_back(future<R>(chain_async_op(batch, optype, i.precondition, flags, f, i, s), s->get_future()));
   }
+  submit_async_ops(batch);
   return ret;
 }
 
@@ -2268,17 +4281,16 @@ namespace detail
 {
     struct barrier_count_completed_state
     {
-        atomic<size_t> togo;
-        std::vector<std::pair<size_t, handle_ptr>> out;
-        std::vector<shared_future<handle_ptr>> insharedstates;
-        barrier_count_completed_state(const std::vector<future<>> &ops) : togo(ops.size()), out(ops.size())
+        struct arrival
         {
-            insharedstates.reserve(ops.size());
-            for(auto &i: ops)
-            {
-                insharedstates.push_back(i._h);
-            }
-        }
+            size_t id;
+            handle_ptr h;
+            exception_ptr e;
+            error_code ec;
+        };
+        atomic<size_t> togo;
+        std::vector<arrival> out;
+        barrier_count_completed_state(const std::vector<future<>> &ops) : togo(ops.size()), out(ops.size()) { }
     };
 }
 
@@ -2288,44 +4300,26 @@ types, but hey it works and is non-header so so what ...
 //template<class T> dispatcher::completion_returntype dispatcher::dobarrier(size_t id, future<> op, T state);
 template<> BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC dispatcher::completion_returntype dispatcher::dobarrier<std::pair<std::shared_ptr<detail::barrier_count_completed_state>, size_t>>(size_t id, future<> op, std::pair<std::shared_ptr<detail::barrier_count_completed_state>, size_t> state)
 {
-    handle_ptr h(op.get_handle(true)); // Ignore any error state until later
+    // An op's completions run only after its outcome is set, so it can be collected now without waiting
+    handle_ptr h(op.get_handle(true));
     size_t idx=state.second;
     detail::barrier_count_completed_state &s=*state.first;
-    s.out[idx]=std::make_pair(id, h); // This might look thread unsafe, but each idx is unique
-    if(--state.first->togo)
-        return std::make_pair(false, h);
-#if 1
-    // On the basis that probably the preceding decrementing thread has yet to signal their stl_future,
-    // give up my timeslice
-    this_thread::yield();
-#endif
-#if BOOST_AFIO_USE_BOOST_THREAD
-    // Rather than potentially expend a syscall per wait on each input op to complete, compose a list of input futures and wait on them all
-    std::vector<shared_future<handle_ptr>> notready;
-    notready.reserve(s.insharedstates.size()-1);
-    for(idx=0; idx<s.insharedstates.size(); idx++)
-    {
-        shared_future<handle_ptr> &f=s.insharedstates[idx];
-        if(idx==state.second || is_ready(f)) continue;
-        notready.push_back(f);
-    }
-    if(!notready.empty())
-        boost::wait_for_all(notready.begin(), notready.end());
-#else
-    for(idx=0; idx<s.insharedstates.size(); idx++)
-    {
-        shared_future<handle_ptr> &f=s.insharedstates[idx];
-        if(idx==state.second || is_ready(f)) continue;
-        f.wait();
-    }
-#endif
-    // Last one just completed, so issue completions for everything in out including myself
-    for(idx=0; idx<s.out.size(); idx++)
+    auto &arrival=s.out[idx];  // This might look thread unsafe, but each idx is unique
+    arrival.id=id;
+    arrival.h=h;
+    if(op.valid())
     {
-        shared_future<handle_ptr> &thisresult=s.insharedstates[idx];
-        exception_ptr e(get_exception_ptr(thisresult));
-        complete_async_op(s.out[idx].first, s.out[idx].second, e);
+        // Replicate an error as is rather than making an exception of it
+        arrival.ec=op._h.get_error();
+        if(!arrival.ec)
+            arrival.e=op.get_exception();
     }
+    // Release our arrival to, or acquire everyone else's as, whoever arrives last
+    if(1!=s.togo.fetch_sub(1, memory_order_acq_rel))
+        return std::make_pair(false, h);
+    // Last one just arrived, so issue completions for everything in out including myself
+    for(auto &i: s.out)
+        int_complete_async_op(i.id, i.h, i.e, i.ec);
     // As I just completed myself above, prevent any further processing
     return std::make_pair(false, handle_ptr());
 }
@@ -2353,11 +4347,408 @@ BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC std::vector<future<>> dispatcher::barrier(c
 }
 
 namespace detail {
+#if BOOST_AFIO_HAVE_KAIO || BOOST_AFIO_HAVE_IO_URING
+    // Continuations run inline by a thread reaping a kernel queue would hold up every other completion, so send them to the pool
+    inline void become_reaper() noexcept
+    {
+        inline_continuation_depth()=((size_t)-1)/2;
+    }
+
+    /* Lets a dispatcher stop sending ops to a kernel queue before tearing it down. Ops which find the
+    gate closed take the compat dispatcher's blocking syscalls instead, so the queue need only drain
+    what is already in flight.
+    */
+    class submission_gate
+    {
+        atomic<bool> _closed;
+        atomic<size_t> _inside;
+    public:
+        submission_gate() : _closed(false), _inside(0) { }
+        //! Returns true if the caller may submit, in which case it must leave() once done
+        bool enter() noexcept
+        {
+            _inside.fetch_add(1, memory_order_seq_cst);
+            if(!_closed.load(memory_order_seq_cst))
+                return true;
+            _inside.fetch_sub(1, memory_order_release);
+            return false;
+        }
+        void leave() noexcept { _inside.fetch_sub(1, memory_order_release); }
+        //! Turns away anything new, then waits for everything already inside to leave
+        void close() noexcept
+        {
+            _closed.store(true, memory_order_seq_cst);
+            while(_inside.load(memory_order_seq_cst))
+                this_thread::yield();
+        }
+        //! Enters the gate for the lifetime of this object if it is open
+        class ticket
+        {
+            submission_gate *_gate;
+        public:
+            explicit ticket(submission_gate &gate) noexcept : _gate(gate.enter() ? &gate : nullptr) { }
+            ~ticket() { if(_gate) _gate->leave(); }
+            ticket(const ticket &) = delete;
+            ticket &operator=(const ticket &) = delete;
+            explicit operator bool() const noexcept { return _gate!=nullptr; }
+        };
+    };
+
+    /* What an op handed to a kernel queue needs until its last submission completes. Reads and
+    writes are split into chunks of no more than IOV_MAX buffers, the most one submission takes,
+    and the op only completes once every chunk is done with its buffers.
+    */
+    struct kernel_io_op
+    {
+        typedef std::vector<std::pair<OpType, std::function<dispatcher::filter_readwrite_t>>> filters_t;
+        size_t id;
+        handle_ptr h;
+        OpType optype;
+        std::vector<iovec> vecs;
+        io_req_impl<true> req;  // Only kept if there are buffer filters to call
+        atomic<size_t> togo;
+        atomic<bool> failed;
+        exception_ptr e;
+        kernel_io_op(size_t _id, handle_ptr _h, OpType _optype) : id(_id), h(std::move(_h)), optype(_optype), togo(0), failed(false) { }
+        async_io_handle_posix *handle() const noexcept { return static_cast<async_io_handle_posix *>(h.get()); }
+        //! The number of chunks the buffers split into
+        size_t chunks() const noexcept { return (vecs.size()+IOV_MAX-1)/IOV_MAX; }
+        //! Takes the buffers of _req, and _req itself if there are filters, then calls f(n, amount, offset, bytes) for each chunk
+        template<bool iswrite, class F> void split(io_req_impl<iswrite> &_req, const filters_t &filters, F &&f)
+        {
+            vecs.reserve(_req.buffers.size());
+            for(auto &b: _req.buffers)
+            {
+                iovec v;
+                v.iov_base=(void *) asio::buffer_cast<const void *>(b);
+                v.iov_len=asio::buffer_size(b);
+                vecs.push_back(v);
+            }
+            off_t offset=_req.where;
+            if(!filters.empty())
+                req=std::move(_req);
+            togo=chunks();
+            for(size_t n=0; n<vecs.size(); n+=IOV_MAX)
+            {
+                size_t amount=std::min((size_t) IOV_MAX, vecs.size()-n), bytes=0;
+                for(size_t m=n; m<n+amount; m++)
+                    bytes+=vecs[m].iov_len;
+                f(n, amount, offset, bytes);
+                offset+=bytes;
+            }
+        }
+        //! Calls the buffer filters and counts the bytes transferred once a chunk completes with res, a byte count or negated errno
+        void transferred(const filters_t &filters, size_t n, size_t amount, off_t offset, long res)
+        {
+            async_io_handle_posix *p=handle();
+            if(!filters.empty())
+            {
+                error_code ec(res<0 ? (int) -res : 0, generic_category());
+                for(auto &i: filters)
+                {
+                    if(i.first==OpType::Unknown || i.first==optype)
+                    {
+                        i.second(optype, p, req, offset, n, amount, ec, res<0 ? 0 : (size_t) res);
+                    }
+                }
+            }
+            if(res>0)
+            {
+                if(OpType::write==optype)
+                    p->byteswritten+=res;
+                else
+                    p->bytesread+=res;
+            }
+        }
+        //! Records the exception being handled as why the op failed, unless a chunk already failed
+        void fail() noexcept
+        {
+            if(!failed.exchange(true, memory_order_relaxed))
+                e=current_exception();
+        }
+        //! Records why the op failed, res being a negated errno, or not negative if the file ran out before the buffers did
+        void fail(long res)
+        {
+            if(failed.load(memory_order_relaxed))
+                return;
+            async_io_handle_posix *p=handle();
+            try
+            {
+                if(res>=0)
+                    BOOST_AFIO_THROW(std::runtime_error(OpType::write==optype ? "Failed to write all buffers" : "Failed to read all buffers"));
+                BOOST_AFIO_ERRGOSFN((int) -res, [p]{return p->path();});
+            }
+            catch(...)
+            {
+                fail();
+            }
+        }
+        //! Marks count chunks done, returning true if they were the last
+        bool chunks_done(size_t count=1) noexcept { return count==togo.fetch_sub(count, memory_order_acq_rel); }
+    };
+    // One submission of an op, transferring its iovecs [n, n+amount)
+    template<class Op> struct kernel_io_chunk
+    {
+        std::shared_ptr<Op> op;
+        size_t n, amount;
+        off_t offset;
+        size_t bytes;
+        kernel_io_chunk(std::shared_ptr<Op> _op, size_t _n, size_t _amount, off_t _offset, size_t _bytes) : op(std::move(_op)), n(_n), amount(_amount), offset(_offset), bytes(_bytes) { }
+    };
+#endif
+
+#if BOOST_AFIO_HAVE_KAIO
+    /* Linux native AIO, which is only truly asynchronous for O_DIRECT files. Each completion signals
+    an eventfd which a dedicated thread waits upon before reaping whatever has completed. Other
+    threads keep no more than events iocbs in flight, sleeping until the reaper gives back slots
+    if there are that many, while the reaper, which can't wait upon itself, may use the rest of the
+    context, which has room for twice as many.
+    */
+    class kaio_engine
+    {
+    public:
+        //! Called by the reaper with each completion's data and result, after giving back the iocb's slot
+        typedef std::function<void(void *, long)> completion_t;
+    private:
+        aio_context_t _ctx;
+        int _efd;
+        unsigned _events;
+        atomic<unsigned> _inflight;
+        atomic<bool> _stopping;
+        completion_t _completion;
+        mutex _lock; condition_variable _cv; atomic<unsigned> _waiters;  // Threads sleeping until slots are given back
+        thread _reaper;
+
+        // Acts upon every completion so far, returning true if there were any. Completions may submit more and so reenter this.
+        bool _reap_ready()
+        {
+            bool ret=false;
+            io_event events[64];
+            for(;;)
+            {
+                timespec notimeout={0, 0};
+                long n=(long) syscall(__NR_io_getevents, _ctx, 0, 64, events, &notimeout);
+                if(n<0 && EINTR==errno)
+                    continue;
+                if(n<=0)
+                    return ret;
+                ret=true;
+                // Completions waiting for room to submit more would otherwise fill the context between them
+                _inflight.fetch_sub((unsigned) n);
+                if(_waiters.load())
+                {
+                    lock_guard<mutex> g(_lock);
+                    _cv.notify_all();
+                }
+                for(long i=0; i<n; i++)
+                    _completion((void *)(uintptr_t) events[i].data, (long) events[i].res);
+            }
+        }
+        // Called by threads other than the reaper. Sleeps until fewer than n iocbs are in flight, or for at
+        // most timeout if not zero.
+        void _wait_below(unsigned n, chrono::milliseconds timeout=chrono::milliseconds(0))
+        {
+            unique_lock<mutex> g(_lock);
+            ++_waiters;
+            auto below=[this, n]{ return _inflight.load()<n; };
+            if(timeout.count())
+                _cv.wait_for(g, timeout, below);
+            else
+                _cv.wait(g, below);
+            --_waiters;
+        }
+        void _reap()
+        {
+            become_reaper();
+            while(!_stopping.load(memory_order_acquire) || _inflight.load(memory_order_acquire))
+            {
+                uint64_t count;
+                if(-1==::read(_efd, &count, sizeof(count)) && EINTR==errno)
+                    continue;
+                _reap_ready();
+            }
+        }
+    public:
+        //! Sets up a context for events events, throwing if the kernel can't
+        kaio_engine(unsigned events, completion_t completion) : _ctx(0), _efd(-1), _events(events), _inflight(0), _stopping(false), _completion(std::move(completion)), _waiters(0)
+        {
+            BOOST_AFIO_ERRHOS(syscall(__NR_io_setup, 2*events, &_ctx));
+            _efd=::eventfd(0, EFD_CLOEXEC);
+            if(-1==_efd)
+            {
+                int errcode=errno;
+                syscall(__NR_io_destroy, _ctx);
+                BOOST_AFIO_ERRGOS(errcode);
+            }
+            _reaper=thread([this]{ _reap(); });
+        }
+        //! Nothing more may be submitted by now. Waits for everything in flight to complete.
+        ~kaio_engine()
+        {
+            // The reaper leaves once everything in flight has completed, and this wakes it
+            _stopping.store(true, memory_order_release);
+            uint64_t one=1;
+            while(-1==::write(_efd, &one, sizeof(one)) && EINTR==errno);
+            _reaper.join();
+            syscall(__NR_io_destroy, _ctx);
+            ::close(_efd);
+        }
+        kaio_engine(const kaio_engine &) = delete;
+        kaio_engine &operator=(const kaio_engine &) = delete;
+        //! Submits an iocb which must stay alive until its completion is called, waiting if too many are in flight
+        void submit(iocb *cb)
+        {
+            bool reaper=this_thread::get_id()==_reaper.get_id();
+            unsigned limit=reaper ? 2*_events : _events;
+            for(;;)
+            {
+                unsigned n=_inflight.load(memory_order_relaxed);
+                if(n<limit)
+                {
+                    if(_inflight.compare_exchange_weak(n, n+1, memory_order_acquire, memory_order_relaxed))
+                        break;
+                    continue;
+                }
+                if(!reaper)
+                    _wait_below(limit);
+                else if(!_reap_ready())
+                    this_thread::yield();
+            }
+            cb->aio_flags|=IOCB_FLAG_RESFD;
+            cb->aio_resfd=_efd;
+            iocb *cbs[1]={ cb };
+            for(;;)
+            {
+                long ret=(long) syscall(__NR_io_submit, _ctx, 1, cbs);
+                if(1==ret)
+                    return;
+                if(ret<0 && (EAGAIN==errno || EINTR==errno))
+                {
+                    // The kernel may be short of room shared with other contexts, which only our completions
+                    // or time can fix
+                    if(EINTR==errno)
+                        continue;
+                    if(!reaper)
+                        _wait_below(_inflight.load(), chrono::milliseconds(1));
+                    else if(!_reap_ready())
+                        this_thread::yield();
+                    continue;
+                }
+                int errcode=(ret<0) ? errno : EIO;
+                _inflight.fetch_sub(1, memory_order_release);
+                BOOST_AFIO_ERRGOS(errcode);
+            }
+        }
+    };
+#endif
+
     class async_file_io_dispatcher_compat : public dispatcher
     {
         template<class Impl, class Handle> friend handle_ptr detail::decode_relative_path(path_req &req, bool force_absolute);
         friend class dispatcher;
         friend struct async_io_handle_posix;
+    protected:
+#if BOOST_AFIO_HAVE_KAIO
+        // One iocb of a read or write
+        struct kaio_chunk : kernel_io_chunk<kernel_io_op>
+        {
+            iocb cb;
+            kaio_chunk(std::shared_ptr<kernel_io_op> _op, size_t _n, size_t _amount, off_t _offset, size_t _bytes) : kernel_io_chunk<kernel_io_op>(std::move(_op), _n, _amount, _offset, _bytes)
+            {
+                memset(&cb, 0, sizeof(cb));
+            }
+        };
+        submission_gate kaiogate;
+        mutex kaiolock;
+        std::unique_ptr<kaio_engine> kaioengine;
+        atomic<kaio_engine *> kaiop;
+        atomic<bool> kaiotried;
+        // Returns the KAIO engine, setting it up upon first use, or null if the kernel won't
+        kaio_engine *kaio()
+        {
+            kaio_engine *ret=kaiop.load(memory_order_acquire);
+            if(ret || kaiotried.load(memory_order_acquire))
+                return ret;
+            lock_guard<mutex> g(kaiolock);
+            if(!kaiotried.load(memory_order_relaxed))
+            {
+                try
+                {
+                    kaioengine=detail::make_unique<kaio_engine>(BOOST_AFIO_KAIO_EVENTS, [this](void *data, long res){ kaio_complete((kaio_chunk *) data, res); });
+                    kaiop.store(kaioengine.get(), memory_order_release);
+                }
+                catch(...)
+                {
+                    // Fall back onto blocking syscalls
+                }
+                kaiotried.store(true, memory_order_release);
+            }
+            return kaiop.load(memory_order_acquire);
+        }
+        // Called in unknown thread. Sends a read or write of an O_DIRECT handle to KAIO if it is suitably
+        // aligned, returning false if it can't.
+        template<bool iswrite> bool kaio_readwrite(size_t id, const handle_ptr &h, detail::io_req_impl<iswrite> &req)
+        {
+            async_io_handle_posix *p=static_cast<async_io_handle_posix *>(h.get());
+            size_t align=p->directalign;
+            // POSIX doesn't guarantee pwritev appends to O_APPEND files, and nor does KAIO
+            if(!align || (iswrite && !!(p->flags() & file_flags::append)) || (req.where % align))
+                return false;
+            for(auto &b: req.buffers)
+            {
+                if(((size_t) asio::buffer_cast<const void *>(b) % align) || (asio::buffer_size(b) % align))
+                    return false;
+            }
+            submission_gate::ticket t(kaiogate);
+            kaio_engine *engine=t ? kaio() : nullptr;
+            if(!engine)
+                return false;
+            auto o=std::make_shared<kernel_io_op>(id, h, iswrite ? OpType::write : OpType::read);
+            size_t submitted=0;
+            bool failed=false;
+            o->split(req, this->p->filters_buffers, [&](size_t n, size_t amount, off_t offset, size_t bytes){
+                if(failed)
+                    return;
+                kaio_chunk *c=new kaio_chunk(o, n, amount, offset, bytes);
+                c->cb.aio_data=(uint64_t)(uintptr_t) c;
+                c->cb.aio_lio_opcode=iswrite ? IOCB_CMD_PWRITEV : IOCB_CMD_PREADV;
+                c->cb.aio_fildes=p->fd;
+                c->cb.aio_buf=(uint64_t)(uintptr_t)(o->vecs.data()+n);
+                c->cb.aio_nbytes=amount;
+                c->cb.aio_offset=offset;
+                try
+                {
+                    BOOST_AFIO_TRACE_SYSCALL(o->optype, id);
+                    engine->submit(&c->cb);
+                    ++submitted;
+                }
+                catch(...)
+                {
+                    delete c;
+                    o->fail();
+                    failed=true;
+                }
+            });
+            // Whatever was already submitted completes the op when it's done with the buffers
+            if(failed && o->chunks_done(o->chunks()-submitted))
+                complete_async_op(id, h, o->e);
+            return true;
+        }
+        // Called in the KAIO reaping thread
+        void kaio_complete(kaio_chunk *_c, long res)
+        {
+            std::unique_ptr<kaio_chunk> c(_c);
+            kernel_io_op *o=c->op.get();
+            o->transferred(this->p->filters_buffers, c->n, c->amount, c->offset, res);
+            if(res<0 || (size_t) res!=c->bytes)
+                o->fail(res);
+            if(o->chunks_done())
+            {
+                this->p->kernelqueueops.fetch_add(1, memory_order_relaxed);
+                complete_async_op(o->id, o->h, o->e);
+            }
+        }
+#endif
         handle_ptr decode_relative_path(path_req &req, bool force_absolute=false)
         {
           return detail::decode_relative_path<async_file_io_dispatcher_compat, async_io_handle_posix>(req, force_absolute);
@@ -2382,7 +4773,7 @@ namespace detail {
               }
             }
             // This will add itself to the dir cache if it's eligible
-            return dofile(id, op, req);
+            return doopen(id, op, req);
         }
         // Called in unknown thread
         completion_returntype dounlink(bool is_dir, size_t id, future<> op, path_req req)
@@ -2405,8 +4796,32 @@ namespace detail {
         {
           return dounlink(true, id, std::move(op), std::move(req));
         }
-        // Called in unknown thread
+        // Called in unknown thread. Throws on failure, as its callers outside of an op expect.
         completion_returntype dofile(size_t id, future<> op, path_req req)
+        {
+            return int_dofile(id, std::move(op), std::move(req), nullptr);
+        }
+        // Called in unknown thread. Failing to create or open is routine (e.g. lock files), so
+        // completes the op with an error code rather than paying for throwing an exception.
+        completion_returntype doopen(size_t id, future<> op, path_req req)
+        {
+            error_code ec;
+            auto ret=int_dofile(id, std::move(op), std::move(req), &ec);
+            if(!ec)
+              return ret;
+            complete_async_op(id, ec);
+            return std::make_pair(false, handle_ptr());
+        }
+        // If ec is set, failures other than out of memory are returned via it
+        static bool int_failed_into(int fd, int code, error_code *ec)
+        {
+            if(-1!=fd || !ec || ENOMEM==code)
+              return false;
+            *ec=error_code(code, generic_category());
+            return true;
+        }
+        // Called in unknown thread
+        completion_returntype int_dofile(size_t id, future<> op, path_req req, error_code *ec)
         {
             int flags=0, fd;
             req.flags=fileflags(req.flags);
@@ -2438,6 +4853,8 @@ namespace detail {
                       if(!(req.flags & file_flags::create_only_if_not_exist))
                           fd=0;
                   }
+                  if(int_failed_into(fd, errno, ec))
+                      return std::make_pair(false, handle_ptr());
                   BOOST_AFIO_ERRHOSFN(fd, [&req]{return req.path;});
               }
 #endif
@@ -2471,6 +4888,8 @@ namespace detail {
                         if(!(req.flags & file_flags::create_only_if_not_exist))
                             fd=0;
                     }
+                    if(int_failed_into(fd, errno, ec))
+                        return std::make_pair(false, handle_ptr());
                     BOOST_AFIO_ERRHOSFN(fd, [&req]{return req.path;});
                 }
             }
@@ -2485,6 +4904,7 @@ namespace detail {
 #endif
             }
             fd=BOOST_AFIO_POSIX_OPENAT(dirh ? (int)(size_t)dirh->native_handle() : at_fdcwd, req.path.c_str(), flags, 0x1b0/*660*/);
+            int openerrno=errno;
             if(dirh)
               req.path=dirh->path()/req.path;
 #ifdef O_PATH
@@ -2495,6 +4915,8 @@ namespace detail {
               return std::make_pair(true, ret);
             }
 #endif
+            if(int_failed_into(fd, openerrno, ec))
+              return std::make_pair(false, handle_ptr());
             // If writing and SyncOnClose and NOT synchronous, turn on SyncOnClose
             auto ret=std::make_shared<async_io_handle_posix>(this, req.path, req.flags, (file_flags::create_only_if_not_exist|file_flags::delete_on_close)==(req.flags & (file_flags::create_only_if_not_exist|file_flags::delete_on_close)), (file_flags::sync_on_close|file_flags::write)==(req.flags & (file_flags::sync_on_close|file_flags::write|file_flags::always_sync)), fd);
             static_cast<async_io_handle_posix *>(ret.get())->do_add_io_handle_to_parent();
@@ -2530,7 +4952,7 @@ namespace detail {
         completion_returntype dosymlink(size_t id, future<> op, path_req req)
         {
             req.flags=fileflags(req.flags)|file_flags::int_opening_link;
-            return dofile(id, op, req);
+            return doopen(id, op, req);
         }
         // Called in unknown thread
         completion_returntype dormsymlink(size_t id, future<> op, path_req req)
@@ -2595,7 +5017,11 @@ namespace detail {
             async_io_handle_posix *p=static_cast<async_io_handle_posix *>(h.get());
             off_t bytestobesynced=p->write_count_since_fsync();
             if(bytestobesynced)
+            {
+                BOOST_AFIO_TRACE_SYSCALL(OpType::sync, id);
+                BOOST_AFIO_BLOCKING_SYSCALL;
                 BOOST_AFIO_ERRHOSFN(BOOST_AFIO_POSIX_FSYNC(p->fd), [p]{return p->path();});
+            }
             p->has_ever_been_fsynced=true;
             p->byteswrittenatlastfsync+=bytestobesynced;
             return std::make_pair(true, h);
@@ -2628,6 +5054,10 @@ namespace detail {
             {   
                 BOOST_AFIO_DEBUG_PRINT("  R %u: %p %u\n", (unsigned) id, asio::buffer_cast<const void *>(b), (unsigned) asio::buffer_size(b));
             }
+#endif
+#if BOOST_AFIO_HAVE_KAIO
+            if(kaio_readwrite(id, h, req))
+                return std::make_pair(false, h);
 #endif
             std::vector<iovec> vecs;
             vecs.reserve(req.buffers.size());
@@ -2643,7 +5073,11 @@ namespace detail {
                 ssize_t _bytesread;
                 size_t amount=std::min((int) (vecs.size()-n), IOV_MAX);
                 off_t offset=req.where+bytesread;
-                while(-1==(_bytesread=preadv(p->fd, (&vecs.front())+n, (int) amount, offset)) && EINTR==errno);
+                {
+                    BOOST_AFIO_TRACE_SYSCALL(OpType::read, id);
+                    BOOST_AFIO_BLOCKING_SYSCALL;
+                    while(-1==(_bytesread=preadv(p->fd, (&vecs.front())+n, (int) amount, offset)) && EINTR==errno);
+                }
                 if(!this->p->filters_buffers.empty())
                 {
                     error_code ec(errno, generic_category());
@@ -2678,6 +5112,10 @@ namespace detail {
             {   
                 BOOST_AFIO_DEBUG_PRINT("  W %u: %p %u\n", (unsigned) id, asio::buffer_cast<const void *>(b), (unsigned) asio::buffer_size(b));
             }
+#endif
+#if BOOST_AFIO_HAVE_KAIO
+            if(kaio_readwrite(id, h, req))
+                return std::make_pair(false, h);
 #endif
             for(auto &b: req.buffers)
             {
@@ -2694,10 +5132,14 @@ namespace detail {
                 // POSIX doesn't actually guarantee pwritev appends to O_APPEND files, and indeed OS X does not.
                 if(!!(p->flags() & file_flags::append))
                 {
+                  BOOST_AFIO_TRACE_SYSCALL(OpType::write, id);
+                  BOOST_AFIO_BLOCKING_SYSCALL;
                   while(-1==(_byteswritten=writev(p->fd, (&vecs.front())+n, (int) amount)) && EINTR==errno);
                 }
                 else
                 {
+                  BOOST_AFIO_TRACE_SYSCALL(OpType::write, id);
+                  BOOST_AFIO_BLOCKING_SYSCALL;
                   while(-1==(_byteswritten=pwritev(p->fd, (&vecs.front())+n, (int) amount, offset)) && EINTR==errno);
                 }
                 if(!this->p->filters_buffers.empty())
@@ -2726,8 +5168,12 @@ namespace detail {
             async_io_handle_posix *p=static_cast<async_io_handle_posix *>(h.get());
             BOOST_AFIO_DEBUG_PRINT("T %u %p (%c)\n", (unsigned) id, h.get(), p->path().native().back());
             int ret;
-            while(-1==(ret=BOOST_AFIO_POSIX_FTRUNCATE(p->fd, newsize)) && EINTR==errno)
-              /*empty*/;
+            {
+              BOOST_AFIO_TRACE_SYSCALL(OpType::truncate, id);
+              BOOST_AFIO_BLOCKING_SYSCALL;
+              while(-1==(ret=BOOST_AFIO_POSIX_FTRUNCATE(p->fd, newsize)) && EINTR==errno)
+                /*empty*/;
+            }
             BOOST_AFIO_ERRHOSFN(ret, [p]{return p->path();});
             return std::make_pair(true, h);
         }
@@ -3097,8 +5543,20 @@ namespace detail {
 
     public:
         async_file_io_dispatcher_compat(std::shared_ptr<thread_source> threadpool, file_flags flagsforce, file_flags flagsmask) : dispatcher(threadpool, flagsforce, flagsmask)
+#if BOOST_AFIO_HAVE_KAIO
+          , kaiop(nullptr), kaiotried(false)
+#endif
         {
         }
+#if BOOST_AFIO_HAVE_KAIO
+        ~async_file_io_dispatcher_compat()
+        {
+            // Outstanding ops which haven't yet submitted now never will, so once those submitting
+            // are done the engine's destructor need only wait for its iocbs in flight to complete
+            kaiogate.close();
+            kaioengine.reset();
+        }
+#endif
 
 
         BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC std::vector<future<>> dir(const std::vector<path_req> &reqs) override final
@@ -3112,7 +5570,7 @@ namespace detail {
 #endif
             return chain_async_ops((int) detail::OpType::dir, reqs, async_op_flags::none, &async_file_io_dispatcher_compat::dodir);
         }
-        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC std::vector<future<>> rmdir(const std::vector<path_req> &reqs) override final
+        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC std::vector<future<>> rmdir(const std::vector<path_req> &reqs) override
         {
 #if BOOST_AFIO_VALIDATE_INPUTS
             for(auto &i: reqs)
@@ -3132,9 +5590,9 @@ namespace detail {
                     BOOST_AFIO_THROW(std::invalid_argument("Inputs are invalid."));
             }
 #endif
-            return chain_async_ops((int) detail::OpType::file, reqs, async_op_flags::none, &async_file_io_dispatcher_compat::dofile);
+            return chain_async_ops((int) detail::OpType::file, reqs, async_op_flags::none, &async_file_io_dispatcher_compat::doopen);
         }
-        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC std::vector<future<>> rmfile(const std::vector<path_req> &reqs) override final
+        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC std::vector<future<>> rmfile(const std::vector<path_req> &reqs) override
         {
 #if BOOST_AFIO_VALIDATE_INPUTS
             for(auto &i: reqs)
@@ -3163,7 +5621,7 @@ namespace detail {
             }
             return chain_async_ops((int) detail::OpType::symlink, ops, reqs, async_op_flags::none, &async_file_io_dispatcher_compat::dosymlink);
         }
-        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC std::vector<future<>> rmsymlink(const std::vector<path_req> &reqs) override final
+        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC std::vector<future<>> rmsymlink(const std::vector<path_req> &reqs) override
         {
 #if BOOST_AFIO_VALIDATE_INPUTS
             for(auto &i: reqs)
@@ -3174,7 +5632,7 @@ namespace detail {
 #endif
             return chain_async_ops((int) detail::OpType::rmsymlink, reqs, async_op_flags::none, &async_file_io_dispatcher_compat::dormsymlink);
         }
-        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC std::vector<future<>> sync(const std::vector<future<>> &ops) override final
+        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC std::vector<future<>> sync(const std::vector<future<>> &ops) override
         {
 #if BOOST_AFIO_VALIDATE_INPUTS
             for(auto &i: ops)
@@ -3185,7 +5643,7 @@ namespace detail {
 #endif
             return chain_async_ops((int) detail::OpType::sync, ops, async_op_flags::none, &async_file_io_dispatcher_compat::dosync);
         }
-        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC std::vector<future<>> zero(const std::vector<future<>> &ops, const std::vector<std::vector<std::pair<off_t, off_t>>> &ranges) override final
+        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC std::vector<future<>> zero(const std::vector<future<>> &ops, const std::vector<std::vector<std::pair<off_t, off_t>>> &ranges) override
         {
 #if BOOST_AFIO_VALIDATE_INPUTS
           for(auto &i: ops)
@@ -3207,7 +5665,7 @@ namespace detail {
 #endif
             return chain_async_ops((int) detail::OpType::close, ops, async_op_flags::none, &async_file_io_dispatcher_compat::doclose);
         }
-        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC std::vector<future<>> read(const std::vector<detail::io_req_impl<false>> &reqs) override final
+        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC std::vector<future<>> read(const std::vector<detail::io_req_impl<false>> &reqs) override
         {
 #if BOOST_AFIO_VALIDATE_INPUTS
             for(auto &i: reqs)
@@ -3218,7 +5676,7 @@ namespace detail {
 #endif
             return chain_async_ops((int) detail::OpType::read, reqs, async_op_flags::none, &async_file_io_dispatcher_compat::doread);
         }
-        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC std::vector<future<>> write(const std::vector<detail::io_req_impl<true>> &reqs) override final
+        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC std::vector<future<>> write(const std::vector<detail::io_req_impl<true>> &reqs) override
         {
 #if BOOST_AFIO_VALIDATE_INPUTS
             for(auto &i: reqs)
@@ -3337,6 +5795,9 @@ BOOST_AFIO_V2_NAMESPACE_END
 #if defined(WIN32) && !defined(USE_POSIX_ON_WIN32)
 #include "afio_iocp.ipp"
 #endif
+#if BOOST_AFIO_HAVE_IO_URING
+#include "afio_uring.ipp"
+#endif
 
 BOOST_AFIO_V2_NAMESPACE_BEGIN
 
@@ -3443,11 +5904,32 @@ BOOST_AFIO_HEADERS_ONLY_MEMFUNC_SPEC outcome<dispatcher_ptr> make_dispatcher(std
 {
     try
     {
-        if(uri!="file:///")
+        bool compat=(uri=="file:///?compat"), uring=(uri=="file:///?io_uring");
+        if(uri!="file:///" && !compat && !uring)
             return error_code(ENXIO, generic_category());
 #if defined(WIN32) && !defined(USE_POSIX_ON_WIN32)
+        if(compat || uring)
+            return error_code(ENXIO, generic_category());
         return dispatcher_ptr(std::make_shared<detail::async_file_io_dispatcher_windows>(threadpool, flagsforce, flagsmask));
 #else
+#if BOOST_AFIO_HAVE_IO_URING
+        // Kernels predating io_uring, with it disabled, or short of locked memory refuse to set up
+        // a ring, so use the compat dispatcher instead. Anything else is a real failure.
+        if(!compat) try
+        {
+            return dispatcher_ptr(std::make_shared<detail::async_file_io_dispatcher_linux>(threadpool, flagsforce, flagsmask));
+        }
+        catch(const system_error &e)
+        {
+            if(e.code().category()!=generic_category() || (ENOSYS!=e.code().value() && EPERM!=e.code().value() && ENOMEM!=e.code().value()))
+                throw;
+            if(uring)
+                return e.code();
+        }
+#else
+        if(uring)
+            return error_code(ENOSYS, generic_category());
+#endif
         return dispatcher_ptr(std::make_shared<detail::async_file_io_dispatcher_compat>(threadpool, flagsforce, flagsmask));
 #endif
     }
@@ -0,0 +1,640 @@
+/* async_file_io
+Provides a threadpool and asynchronous file i/o infrastructure based on Boost.ASIO, Boost.Iostreams and filesystem
+(C) 2013-2014 Niall Douglas http://www.nedprod.com/
+File Created: Mar 2013
+*/
+
+#if BOOST_AFIO_HAVE_IO_URING
+
+BOOST_AFIO_V2_NAMESPACE_BEGIN
+
+namespace detail {
+    // IORING_OP_UNLINKAT, which kernel headers before 5.11 lack. Never supported by the rings of kernels that old.
+    static BOOST_CONSTEXPR_OR_CONST unsigned io_uring_op_unlinkat=36;
+    /* A minimal io_uring driven directly through its syscalls. Any thread may prepare entries, which
+    are handed to the kernel by whichever thread next flushes, so concurrent submitters share one
+    io_uring_enter(). A dedicated thread reaps completions. Other threads keep no more entries in
+    flight than the submission ring holds, while the reaper, which can't wait upon itself, may use
+    the rest of the completion ring, so completions are never dropped.
+    */
+    class io_uring_ring
+    {
+    public:
+        //! Called by the reaper with each completion's data and result, after giving back the entry's slot
+        typedef std::function<void(void *, int)> completion_t;
+    private:
+        int _fd;
+        unsigned _entries, _cqentries;
+        void *_sqmap, *_cqmap;
+        size_t _sqmapsize, _cqmapsize;
+        io_uring_sqe *_sqes;
+        unsigned *_sqhead, *_sqtail, *_sqmask, *_sqarray;
+        unsigned *_cqhead, *_cqtail, *_cqmask;
+        io_uring_cqe *_cqes;
+        bool _supported[IORING_OP_LAST];
+        typedef spinlock<bool> sqlock_t;
+        sqlock_t _sqlock;
+        atomic<unsigned> _queued, _inflight;
+        atomic<bool> _submitting, _stopping;
+        completion_t _completion;
+        std::deque<io_uring_cqe> _stashed;  // Only touched by the reaper
+        thread _reaper;
+
+        void _release() noexcept
+        {
+            if(_sqes)
+                ::munmap(_sqes, _entries*sizeof(io_uring_sqe));
+            if(_cqmap && _cqmap!=_sqmap)
+                ::munmap(_cqmap, _cqmapsize);
+            if(_sqmap)
+                ::munmap(_sqmap, _sqmapsize);
+            if(_fd>=0)
+                ::close(_fd);
+        }
+        bool _is_reaper() const noexcept { return this_thread::get_id()==_reaper.get_id(); }
+        // Called by the reaper. Moves completions out of the completion ring without acting upon them, which
+        // is safe to do anywhere, so the kernel can post more. Returns true if there were any.
+        bool _stash()
+        {
+            unsigned head=*_cqhead, tail=__atomic_load_n(_cqtail, __ATOMIC_ACQUIRE);
+            if(head==tail)
+                return false;
+            for(; head!=tail; head++)
+                _stashed.push_back(_cqes[head & *_cqmask]);
+            __atomic_store_n(_cqhead, tail, __ATOMIC_RELEASE);
+            return true;
+        }
+        void _complete(const io_uring_cqe &cqe)
+        {
+            // Completions waiting for slots to submit more would otherwise hold all of them between them
+            _inflight.fetch_sub(1, memory_order_release);
+            if(cqe.user_data)
+                _completion((void *)(uintptr_t) cqe.user_data, cqe.res);
+        }
+        // Called by the reaper. Acts upon every completion so far, returning true if there were any. Completions
+        // may submit more and so reenter this, hence each is taken off the rings before acting upon it.
+        bool _reap_ready()
+        {
+            bool ret=false;
+            while(!_stashed.empty())
+            {
+                io_uring_cqe cqe=_stashed.front();
+                _stashed.pop_front();
+                _complete(cqe);
+                ret=true;
+            }
+            for(;;)
+            {
+                unsigned head=*_cqhead;
+                if(head==__atomic_load_n(_cqtail, __ATOMIC_ACQUIRE))
+                    return ret;
+                io_uring_cqe cqe=_cqes[head & *_cqmask];
+                __atomic_store_n(_cqhead, head+1, __ATOMIC_RELEASE);
+                _complete(cqe);
+                ret=true;
+            }
+        }
+        void _wait() noexcept
+        {
+            syscall(__NR_io_uring_enter, _fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        }
+        void _reap()
+        {
+            become_reaper();
+            while(!_stopping.load(memory_order_acquire) || _inflight.load(memory_order_acquire))
+            {
+                if(!_reap_ready())
+                    _wait();
+            }
+        }
+    public:
+        /*! Sets up a ring of at least entries entries whose completions are passed to completion,
+        throwing system_error with the code io_uring_setup() failed with if the kernel won't.
+        */
+        io_uring_ring(unsigned entries, completion_t completion) : _fd(-1), _sqmap(nullptr), _cqmap(nullptr), _sqes(nullptr), _queued(0), _inflight(0), _submitting(false), _stopping(false), _completion(std::move(completion))
+        {
+            io_uring_params params;
+            memset(&params, 0, sizeof(params));
+            _fd=(int) syscall(__NR_io_uring_setup, entries, &params);
+            // Reported as is, ENOMEM included, so callers can tell the kernel refusing apart from other failures
+            if(_fd<0)
+                BOOST_AFIO_THROW(system_error(error_code(errno, generic_category()), "io_uring_setup() failed"));
+            try
+            {
+                _entries=params.sq_entries;
+                _cqentries=params.cq_entries;
+                _sqmapsize=params.sq_off.array+params.sq_entries*sizeof(unsigned);
+                _cqmapsize=params.cq_off.cqes+params.cq_entries*sizeof(io_uring_cqe);
+                if(params.features & IORING_FEAT_SINGLE_MMAP)
+                    _sqmapsize=_cqmapsize=std::max(_sqmapsize, _cqmapsize);
+                _sqmap=::mmap(nullptr, _sqmapsize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+                if(MAP_FAILED==_sqmap) { _sqmap=nullptr; BOOST_AFIO_ERRGOS(errno); }
+                if(params.features & IORING_FEAT_SINGLE_MMAP)
+                    _cqmap=_sqmap;
+                else
+                {
+                    _cqmap=::mmap(nullptr, _cqmapsize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+                    if(MAP_FAILED==_cqmap) { _cqmap=nullptr; BOOST_AFIO_ERRGOS(errno); }
+                }
+                void *sqes=::mmap(nullptr, _entries*sizeof(io_uring_sqe), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, _fd, IORING_OFF_SQES);
+                if(MAP_FAILED==sqes) BOOST_AFIO_ERRGOS(errno);
+                _sqes=(io_uring_sqe *) sqes;
+                char *sq=(char *) _sqmap, *cq=(char *) _cqmap;
+                _sqhead=(unsigned *)(sq+params.sq_off.head);
+                _sqtail=(unsigned *)(sq+params.sq_off.tail);
+                _sqmask=(unsigned *)(sq+params.sq_off.ring_mask);
+                _sqarray=(unsigned *)(sq+params.sq_off.array);
+                _cqhead=(unsigned *)(cq+params.cq_off.head);
+                _cqtail=(unsigned *)(cq+params.cq_off.tail);
+                _cqmask=(unsigned *)(cq+params.cq_off.ring_mask);
+                _cqes=(io_uring_cqe *)(cq+params.cq_off.cqes);
+                // Each submission slot always refers to the entry of the same index
+                for(unsigned n=0; n<_entries; n++)
+                    _sqarray[n]=n;
+                // Kernels too old to be probed support only what the very first io_uring did
+                memset(_supported, 0, sizeof(_supported));
+                std::vector<char> probebuffer(sizeof(io_uring_probe)+256*sizeof(io_uring_probe_op));
+                io_uring_probe *probe=(io_uring_probe *) probebuffer.data();
+                if(syscall(__NR_io_uring_register, _fd, IORING_REGISTER_PROBE, probe, 256)>=0)
+                {
+                    for(unsigned n=0; n<probe->ops_len && n<IORING_OP_LAST; n++)
+                        _supported[probe->ops[n].op]=!!(probe->ops[n].flags & IO_URING_OP_SUPPORTED);
+                }
+                else
+                    _supported[IORING_OP_NOP]=_supported[IORING_OP_READV]=_supported[IORING_OP_WRITEV]=_supported[IORING_OP_FSYNC]=true;
+                if(!_supported[IORING_OP_NOP] || !_supported[IORING_OP_READV] || !_supported[IORING_OP_WRITEV] || !_supported[IORING_OP_FSYNC])
+                    BOOST_AFIO_THROW(system_error(error_code(ENOSYS, generic_category()), "io_uring lacks readv, writev or fsync"));
+                _reaper=thread([this]{ _reap(); });
+            }
+            catch(...)
+            {
+                _release();
+                throw;
+            }
+        }
+        //! Nothing more may be submitted by now. Waits for everything in flight to complete.
+        ~io_uring_ring()
+        {
+            // The reaper leaves once everything in flight has completed, and this wakes it
+            _stopping.store(true, memory_order_release);
+            reserve();
+            prepare([](io_uring_sqe *sqe){
+                sqe->opcode=IORING_OP_NOP;
+                sqe->user_data=0;
+            });
+            flush();
+            _reaper.join();
+            _release();
+        }
+        io_uring_ring(const io_uring_ring &) = delete;
+        io_uring_ring &operator=(const io_uring_ring &) = delete;
+        //! True if the kernel implements the opcode
+        bool supports(unsigned opcode) const noexcept { return opcode<IORING_OP_LAST && _supported[opcode]; }
+        //! Waits until a slot is free, then takes it. The reaper acts upon completions to free one.
+        void reserve()
+        {
+            bool reaper=_is_reaper();
+            unsigned limit=reaper ? _cqentries : _entries;
+            for(;;)
+            {
+                unsigned n=_inflight.load(memory_order_relaxed);
+                if(n<limit)
+                {
+                    if(_inflight.compare_exchange_weak(n, n+1, memory_order_acquire, memory_order_relaxed))
+                        return;
+                    continue;
+                }
+                flush();
+                if(!reaper)
+                    this_thread::yield();
+                else if(!_reap_ready())
+                    _wait();
+            }
+        }
+        //! Takes a slot regardless of how many are in flight, for resubmitting an entry from its own completion
+        void claim() noexcept { _inflight.fetch_add(1, memory_order_acquire); }
+        //! Claims a submission entry for a slot already taken, has f fill it in, and queues it for the next flush
+        template<class F> void prepare(F &&f)
+        {
+            for(;;)
+            {
+                {
+                    lock_guard<sqlock_t> g(_sqlock);
+                    unsigned tail=*_sqtail, head=__atomic_load_n(_sqhead, __ATOMIC_ACQUIRE);
+                    if(tail-head<_entries)
+                    {
+                        io_uring_sqe *sqe=_sqes+(tail & *_sqmask);
+                        memset(sqe, 0, sizeof(*sqe));
+                        f(sqe);
+                        __atomic_store_n(_sqtail, tail+1, __ATOMIC_RELEASE);
+                        _queued.fetch_add(1, memory_order_release);
+                        return;
+                    }
+                }
+                // The submission ring is full of entries not yet handed to the kernel, which may be
+                // waiting upon the reaper to make room in the completion ring
+                flush();
+                if(!_is_reaper() || !_stash())
+                    this_thread::yield();
+            }
+        }
+        //! Hands everything prepared so far to the kernel, unless another thread is already doing so
+        void flush()
+        {
+            bool reaper=_is_reaper();
+            // Whoever finds nobody else submitting submits on behalf of everyone, rechecking after
+            // giving up the role in case something was queued after it last looked
+            while(_queued.load(memory_order_acquire) && !_submitting.exchange(true, memory_order_acquire))
+            {
+                unsigned n=_queued.exchange(0, memory_order_acq_rel);
+                while(n)
+                {
+                    int ret=(int) syscall(__NR_io_uring_enter, _fd, n, 0, 0, nullptr, 0);
+                    if(ret>0)
+                        n-=ret;
+                    else if(ret<0 && EINTR!=errno && EAGAIN!=errno && EBUSY!=errno)
+                        BOOST_AFIO_THROW_FATAL(std::runtime_error("io_uring_enter() failed to submit entries"));
+                    // EBUSY means the completion ring is full, and only the reaper can empty it
+                    else if(!reaper || !_stash())
+                        this_thread::yield();
+                }
+                _submitting.store(false, memory_order_release);
+            }
+        }
+    };
+
+    /* The Linux dispatcher is the compat dispatcher with reads, writes, syncs and zeroing done
+    through an io_uring, so how many of those can be in flight is bounded by the size of the ring
+    rather than by how many threads are in the pool. A single reaper thread completes the ops
+    as their entries complete. Once destruction begins, ops not yet submitted take the compat
+    dispatcher's blocking syscalls instead, so the ring only has to drain what is in flight.
+    */
+    class async_file_io_dispatcher_linux : public async_file_io_dispatcher_compat
+    {
+        friend class dispatcher;
+        // Syncs, zeroing and unlinks need a little more than reads and writes do
+        struct uring_op : kernel_io_op
+        {
+            std::vector<std::pair<off_t, off_t>> ranges;  // Only kept by zero
+            handle_ptr dirh; path leaf;  // Only kept by unlinks, whose handle is their precondition's and may be null
+            off_t bytestobesynced;
+            atomic<bool> unsupported;
+            uring_op(size_t _id, handle_ptr _h, OpType _optype) : kernel_io_op(_id, std::move(_h), _optype), bytestobesynced(0), unsupported(false) { }
+        };
+        // One submission entry of an op, which short transfers resubmit with what remains
+        struct uring_chunk : kernel_io_chunk<uring_op>
+        {
+            size_t done;
+            uring_chunk(std::shared_ptr<uring_op> _op, size_t _n, size_t _amount, off_t _offset, size_t _bytes) : kernel_io_chunk<uring_op>(std::move(_op), _n, _amount, _offset, _bytes), done(0) { }
+        };
+        submission_gate gate;
+        io_uring_ring ring;
+
+        // Called in unknown thread, or in the reaper thread to resubmit a chunk from its completion
+        void submit(uring_chunk *c, bool resubmit=false)
+        {
+            uring_op *o=c->op.get();
+            async_io_handle_posix *p=static_cast<async_io_handle_posix *>(o->h.get());
+            int fd=p ? p->fd : -1;
+            BOOST_AFIO_TRACE_SYSCALL(o->optype, o->id);
+            if(resubmit)
+                ring.claim();
+            else
+                ring.reserve();
+            ring.prepare([c, o, fd](io_uring_sqe *sqe){
+                sqe->fd=fd;
+                sqe->user_data=(uint64_t)(uintptr_t) c;
+                switch(o->optype)
+                {
+                case OpType::rmdir:
+                case OpType::rmfile:
+                    sqe->opcode=io_uring_op_unlinkat;
+                    sqe->fd=o->dirh ? (int)(size_t) o->dirh->native_handle() : at_fdcwd;
+                    sqe->addr=(uint64_t)(uintptr_t) o->leaf.c_str();
+                    sqe->rw_flags=(OpType::rmdir==o->optype) ? AT_REMOVEDIR : 0;  // unlink_flags
+                    break;
+                case OpType::read:
+                case OpType::write:
+                    sqe->opcode=(OpType::read==o->optype) ? IORING_OP_READV : IORING_OP_WRITEV;
+                    sqe->off=c->offset;
+                    sqe->addr=(uint64_t)(uintptr_t)(o->vecs.data()+c->n);
+                    sqe->len=(unsigned) c->amount;
+                    break;
+                case OpType::sync:
+                    sqe->opcode=IORING_OP_FSYNC;
+                    break;
+                case OpType::zero:
+                    sqe->opcode=IORING_OP_FALLOCATE;
+                    sqe->off=c->offset;
+                    sqe->addr=c->bytes;
+                    sqe->len=0x02/*FALLOC_FL_PUNCH_HOLE*/|0x01/*FALLOC_FL_KEEP_SIZE*/;
+                    break;
+                default:
+                    abort();
+                }
+            });
+        }
+        // Called in the reaper thread
+        void complete_chunk(uring_chunk *_c, int res)
+        {
+            std::unique_ptr<uring_chunk> c(_c);
+            uring_op *o=c->op.get();
+            // Nothing was done, so retry before anything sees the result
+            if(-EINTR==res || -EAGAIN==res)
+            {
+                submit(c.release(), true);
+                ring.flush();
+                return;
+            }
+            if(!o->leaf.empty())
+            {
+                // Fails like compat's unlinkat(), which may be told apart from a failure of the handle the op was chained onto
+                if(res<0)
+                {
+                    try
+                    {
+                        BOOST_AFIO_ERRGOSFN((int) -res, [o]{return o->leaf;});
+                    }
+                    catch(...)
+                    {
+                        o->fail();
+                    }
+                }
+                complete_uring_op(std::move(c->op));
+                return;
+            }
+            if(OpType::read==o->optype || OpType::write==o->optype)
+            {
+                o->transferred(this->p->filters_buffers, c->n, c->amount, c->offset, res);
+                if(res>0)
+                {
+                    c->done+=res;
+                    // A short transfer resubmits whatever remains
+                    if(c->done<c->bytes)
+                    {
+                        size_t transferred=(size_t) res;
+                        c->offset+=transferred;
+                        while(transferred)
+                        {
+                            iovec &v=o->vecs[c->n];
+                            if(transferred>=v.iov_len)
+                            {
+                                transferred-=v.iov_len;
+                                c->n++;
+                                c->amount--;
+                            }
+                            else
+                            {
+                                v.iov_base=(char *) v.iov_base+transferred;
+                                v.iov_len-=transferred;
+                                transferred=0;
+                            }
+                        }
+                        submit(c.release(), true);
+                        ring.flush();
+                        return;
+                    }
+                }
+                else if(!res)
+                {
+                    // Like compat, running out of file before all the buffers are done is a failure
+                    o->fail(0);
+                }
+            }
+            else if(OpType::zero==o->optype && (-EOPNOTSUPP==res || -EINVAL==res))
+            {
+                // The filing system may not support trim, so write zeros instead later
+                o->unsupported=true;
+                res=0;
+            }
+            if(res<0)
+                o->fail(res);
+            // Only once every entry is done with the buffers is the op complete
+            if(o->chunks_done())
+                complete_uring_op(std::move(c->op));
+        }
+        // Called in the reaper thread
+        void complete_uring_op(std::shared_ptr<uring_op> o)
+        {
+            async_io_handle_posix *p=static_cast<async_io_handle_posix *>(o->h.get());
+            if(o->e)
+            {
+                this->p->kernelqueueops.fetch_add(1, memory_order_relaxed);
+                complete_async_op(o->id, o->h, o->e);
+                return;
+            }
+            if(OpType::sync==o->optype)
+            {
+                p->has_ever_been_fsynced=true;
+                p->byteswrittenatlastfsync+=o->bytestobesynced;
+            }
+            else if(OpType::zero==o->optype && o->unsupported)
+            {
+                // Writing zeros blocks, so mustn't be done here
+                this->p->pool->enqueue([this, o]{
+                    try
+                    {
+                        async_file_io_dispatcher_compat::dozero(o->id, future<>(o->h), o->ranges);
+                        complete_async_op(o->id, o->h);
+                    }
+                    catch(...)
+                    {
+                        complete_async_op(o->id, o->h, current_exception());
+                    }
+                });
+                return;
+            }
+            this->p->kernelqueueops.fetch_add(1, memory_order_relaxed);
+            complete_async_op(o->id, o->h);
+        }
+        // Called in unknown thread
+        template<bool iswrite> completion_returntype doreadwrite(size_t id, handle_ptr h, io_req_impl<iswrite> &req)
+        {
+            async_io_handle_posix *p=static_cast<async_io_handle_posix *>(h.get());
+            auto o=std::make_shared<uring_op>(id, h, iswrite ? OpType::write : OpType::read);
+            BOOST_AFIO_DEBUG_PRINT("%c %u %p (%c) @ %u, b=%u\n", iswrite ? 'W' : 'R', (unsigned) id, h.get(), p->path().native().back(), (unsigned) req.where, (unsigned) req.buffers.size());
+            o->split(req, this->p->filters_buffers, [this, &o](size_t n, size_t amount, off_t offset, size_t bytes){
+                submit(new uring_chunk(o, n, amount, offset, bytes));
+            });
+            ring.flush();
+            // Indicate we're not finished yet
+            return std::make_pair(false, h);
+        }
+        // Called in unknown thread
+        completion_returntype doread(size_t id, future<> op, io_req_impl<false> req)
+        {
+            submission_gate::ticket t(gate);
+            if(!t)
+                return async_file_io_dispatcher_compat::doread(id, std::move(op), std::move(req));
+            handle_ptr h(op.get_handle());
+            return doreadwrite(id, std::move(h), req);
+        }
+        // Called in unknown thread
+        completion_returntype dowrite(size_t id, future<> op, io_req_impl<true> req)
+        {
+            handle_ptr h(op.get_handle());
+            submission_gate::ticket t(gate);
+            // Appends split across several entries could land in any order
+            if(!t || !!(h->flags() & file_flags::append))
+                return async_file_io_dispatcher_compat::dowrite(id, std::move(op), std::move(req));
+            return doreadwrite(id, std::move(h), req);
+        }
+        // Called in unknown thread
+        completion_returntype dosync(size_t id, future<> op, future<>)
+        {
+            handle_ptr h(op.get_handle());
+            async_io_handle_posix *p=static_cast<async_io_handle_posix *>(h.get());
+            off_t bytestobesynced=p->write_count_since_fsync();
+            if(!bytestobesynced)
+            {
+                p->has_ever_been_fsynced=true;
+                return std::make_pair(true, h);
+            }
+            submission_gate::ticket t(gate);
+            if(!t)
+                return async_file_io_dispatcher_compat::dosync(id, std::move(op), future<>());
+            auto o=std::make_shared<uring_op>(id, h, OpType::sync);
+            o->bytestobesynced=bytestobesynced;
+            o->togo=1;
+            submit(new uring_chunk(std::move(o), 0, 0, 0, 0));
+            ring.flush();
+            return std::make_pair(false, h);
+        }
+        // Called in unknown thread
+        completion_returntype dozero(size_t id, future<> op, std::vector<std::pair<off_t, off_t>> ranges)
+        {
+            submission_gate::ticket t(gate);
+            if(!t || ranges.empty() || !ring.supports(IORING_OP_FALLOCATE))
+                return async_file_io_dispatcher_compat::dozero(id, std::move(op), std::move(ranges));
+            handle_ptr h(op.get_handle());
+            auto o=std::make_shared<uring_op>(id, h, OpType::zero);
+            o->togo=ranges.size();
+            o->ranges=std::move(ranges);
+            for(auto &i: o->ranges)
+                submit(new uring_chunk(o, 0, 0, i.first, (size_t) i.second));
+            ring.flush();
+            return std::make_pair(false, h);
+        }
+        // Called in unknown thread
+        completion_returntype dounlink(bool is_dir, size_t id, future<> op, path_req req)
+        {
+            submission_gate::ticket t(gate);
+            // Deleting the input op's own file goes through its handle, which has to rename it out of the way first
+            if(!t || req.path.empty() || !ring.supports(io_uring_op_unlinkat))
+                return async_file_io_dispatcher_compat::dounlink(is_dir, id, std::move(op), std::move(req));
+            req.flags=fileflags(req.flags);
+            auto dirh=decode_relative_path(req);
+            auto o=std::make_shared<uring_op>(id, op.get_handle(), is_dir ? OpType::rmdir : OpType::rmfile);
+            o->dirh=std::move(dirh);
+            o->leaf=std::move(req.path);
+            o->togo=1;
+            submit(new uring_chunk(o, 0, 0, 0, 0));
+            ring.flush();
+            return std::make_pair(false, o->h);
+        }
+        // Called in unknown thread
+        completion_returntype dormdir(size_t id, future<> op, path_req req)
+        {
+            return dounlink(true, id, std::move(op), std::move(req));
+        }
+        // Called in unknown thread
+        completion_returntype dormfile(size_t id, future<> op, path_req req)
+        {
+            return dounlink(false, id, std::move(op), std::move(req));
+        }
+
+    public:
+        async_file_io_dispatcher_linux(std::shared_ptr<thread_source> threadpool, file_flags flagsforce, file_flags flagsmask) : async_file_io_dispatcher_compat(threadpool, flagsforce, flagsmask),
+            ring(BOOST_AFIO_IO_URING_ENTRIES, [this](void *data, int res){ complete_chunk((uring_chunk *) data, res); })
+        {
+        }
+        ~async_file_io_dispatcher_linux()
+        {
+            // Outstanding ops which haven't yet submitted now never will, so once those submitting
+            // are done the ring's destructor need only wait for its entries in flight to complete
+            gate.close();
+        }
+
+        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC std::vector<future<>> sync(const std::vector<future<>> &ops) override final
+        {
+#if BOOST_AFIO_VALIDATE_INPUTS
+            for(auto &i: ops)
+            {
+                if(!i.validate())
+                    BOOST_AFIO_THROW(std::invalid_argument("Inputs are invalid."));
+            }
+#endif
+            return chain_async_ops((int) detail::OpType::sync, ops, async_op_flags::none, &async_file_io_dispatcher_linux::dosync);
+        }
+        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC std::vector<future<>> zero(const std::vector<future<>> &ops, const std::vector<std::vector<std::pair<off_t, off_t>>> &ranges) override final
+        {
+#if BOOST_AFIO_VALIDATE_INPUTS
+            for(auto &i: ops)
+            {
+                if(!i.validate())
+                    BOOST_AFIO_THROW(std::invalid_argument("Inputs are invalid."));
+            }
+#endif
+            return chain_async_ops((int) detail::OpType::zero, ops, ranges, async_op_flags::none, &async_file_io_dispatcher_linux::dozero);
+        }
+        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC std::vector<future<>> rmdir(const std::vector<path_req> &reqs) override final
+        {
+#if BOOST_AFIO_VALIDATE_INPUTS
+            for(auto &i: reqs)
+            {
+                if(!i.validate())
+                    BOOST_AFIO_THROW(std::invalid_argument("Inputs are invalid."));
+            }
+#endif
+            return chain_async_ops((int) detail::OpType::rmdir, reqs, async_op_flags::none, &async_file_io_dispatcher_linux::dormdir);
+        }
+        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC std::vector<future<>> rmfile(const std::vector<path_req> &reqs) override final
+        {
+#if BOOST_AFIO_VALIDATE_INPUTS
+            for(auto &i: reqs)
+            {
+                if(!i.validate())
+                    BOOST_AFIO_THROW(std::invalid_argument("Inputs are invalid."));
+            }
+#endif
+            return chain_async_ops((int) detail::OpType::rmfile, reqs, async_op_flags::none, &async_file_io_dispatcher_linux::dormfile);
+        }
+        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC std::vector<future<>> rmsymlink(const std::vector<path_req> &reqs) override final
+        {
+#if BOOST_AFIO_VALIDATE_INPUTS
+            for(auto &i: reqs)
+            {
+                if(!i.validate())
+                    BOOST_AFIO_THROW(std::invalid_argument("Inputs are invalid."));
+            }
+#endif
+            return chain_async_ops((int) detail::OpType::rmsymlink, reqs, async_op_flags::none, &async_file_io_dispatcher_linux::dormfile);
+        }
+        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC std::vector<future<>> read(const std::vector<detail::io_req_impl<false>> &reqs) override final
+        {
+#if BOOST_AFIO_VALIDATE_INPUTS
+            for(auto &i: reqs)
+            {
+                if(!i.validate())
+                    BOOST_AFIO_THROW(std::invalid_argument("Inputs are invalid."));
+            }
+#endif
+            return chain_async_ops((int) detail::OpType::read, reqs, async_op_flags::none, &async_file_io_dispatcher_linux::doread);
+        }
+        BOOST_AFIO_HEADERS_ONLY_VIRTUAL_SPEC std::vector<future<>> write(const std::vector<detail::io_req_impl<true>> &reqs) override final
+        {
+#if BOOST_AFIO_VALIDATE_INPUTS
+            for(auto &i: reqs)
+            {
+                if(!i.validate())
+                    BOOST_AFIO_THROW(std::invalid_argument("Inputs are invalid."));
+            }
+#endif
+            return chain_async_ops((int) detail::OpType::write, reqs, async_op_flags::none, &async_file_io_dispatcher_linux::dowrite);
+        }
+    };
+}
+
+BOOST_AFIO_V2_NAMESPACE_END
+
+#endif
@@ -1 +1 @@
-g++ -o test_all -g -O3 -DNDEBUG -std=c++11 -pthread test/test_all.cpp detail/SpookyV2.cpp -Iinclude -Itest -DUNICODE=1 -DWIN32=1 -D_UNICODE=1 -D_WIN32=1 -DAFIO_STANDALONE=1 -Iasio/asio/include -DASIO_STANDALONE=1  -DBOOST_AFIO_RUNNING_IN_CI=1 -I../boost-release -L../boost-release/stage/lib -lboost_filesystem-mgw49-mt-1_57 -lboost_system-mgw49-mt-1_57 -lws2_32 -Wl,-subsystem,console
+g++ -o test_all -g -O3 -DNDEBUG -std=c++11 -pthread test/test_all.cpp detail/SpookyV2.cpp detail/allocation_counter.cpp -Iinclude -Itest -DUNICODE=1 -DWIN32=1 -D_UNICODE=1 -D_WIN32=1 -DAFIO_STANDALONE=1 -Iasio/asio/include -DASIO_STANDALONE=1  -DBOOST_AFIO_RUNNING_IN_CI=1 -I../boost-release -L../boost-release/stage/lib -lboost_filesystem-mgw49-mt-1_57 -lboost_system-mgw49-mt-1_57 -lws2_32 -Wl,-subsystem,console
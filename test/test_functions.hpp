@@ -36,6 +36,7 @@ extern "C" void tzset(void);
 #include <random>
 #include <fstream>
 #include "../detail/SpookyV2.h"
+#include "../detail/allocation_counter.hpp"
 #include "Aligned_Allocator.hpp"
 #include "boost/afio/v2/detail/valgrind/valgrind.h"
 #include <time.h>
@@ -0,0 +1,92 @@
+#include "test_functions.hpp"
+
+BOOST_AFIO_AUTO_TEST_CASE(async_io_adaptive_threadpool, "Tests that an adaptive std_thread_pool spawns workers lazily, grows when stalled but not when busy, retires idle workers and stays within its bounds", 60)
+{
+    using namespace BOOST_AFIO_V2_NAMESPACE;
+    static const size_t blocks=256, blocksize=4096;
+    std::vector<char> buffer(blocks*blocksize, 'n');
+    auto pool=std::make_shared<std_thread_pool>(thread_pool_bounds(2, 8, chrono::milliseconds(100)));
+    BOOST_CHECK(pool->is_adaptive());
+    BOOST_CHECK(pool->size()==0);
+    auto dispatcher=make_dispatcher("file:///", file_flags::none, file_flags::none, pool).get();
+    {
+      auto mkdir(dispatcher->dir(path_req("testdir", file_flags::create)));
+      auto mkfile(dispatcher->file(path_req::relative(mkdir, "foo", file_flags::create | file_flags::read_write)));
+      auto resizefile(dispatcher->truncate(mkfile, buffer.size()));
+      std::vector<io_req<const char>> writes;
+      for(size_t n=0; n<blocks; n++)
+        writes.push_back(io_req<const char>(resizefile, buffer.data()+n*blocksize, blocksize, n*blocksize));
+      auto written(dispatcher->write(writes));
+      auto syncfile(dispatcher->sync(dispatcher->barrier(written).front()));
+      BOOST_REQUIRE_NO_THROW(syncfile.get());
+      BOOST_CHECK(pool->size()>=1);
+      BOOST_CHECK(pool->size()<=8);
+      // The truncate at least ran on a worker, which is still alive as none has been idle for long
+      BOOST_CHECK(pool->blocked_time().count()>0);
+      auto stats(pool->worker_stats());
+      BOOST_CHECK(stats.size()==pool->size());
+      chrono::nanoseconds blocked(0);
+      for(auto &i: stats)
+        blocked+=i.blocked;
+      BOOST_CHECK(blocked.count()>0);
+      BOOST_CHECK(blocked<=pool->blocked_time());
+      auto closefile(dispatcher->close(syncfile));
+      auto delfile(dispatcher->rmfile(closefile));
+      auto deldir(dispatcher->rmdir(dispatcher->depends(delfile, mkdir)));
+      BOOST_CHECK_NO_THROW(delfile.get());
+      BOOST_CHECK_NO_THROW(deldir.wait());  // virus checkers sometimes make this spuriously fail
+    }
+    dispatcher.reset();
+    pool->destroy();
+    BOOST_CHECK(pool->size()==0);
+
+#if defined(WIN32) || defined(__linux__)
+    // Workers stuck in work which never says it blocks are noticed by the lack of progress, where the CPU
+    // time of threads can be told so they can be told apart from workers busy running CPU bound work
+    pool=std::make_shared<std_thread_pool>(thread_pool_bounds(2, 6, chrono::milliseconds(100), chrono::milliseconds(10)));
+    {
+      atomic<bool> release(false);
+      atomic<size_t> running(0);
+      std::vector<shared_future<void>> stuck;
+      for(size_t n=0; n<7; n++)
+        stuck.push_back(pool->enqueue([&release, &running]{
+          ++running;
+          while(!release)
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }));
+      for(size_t n=0; n<1000 && running<6; n++)
+        this_thread::sleep_for(chrono::milliseconds(10));
+      this_thread::sleep_for(chrono::milliseconds(100));
+      BOOST_CHECK(running==6);
+      BOOST_CHECK(pool->size()==6);
+      release=true;
+      for(auto &i: stuck)
+        BOOST_CHECK_NO_THROW(i.get());
+      // Then everything beyond the minimum retires after the idle timeout
+      for(size_t n=0; n<1000 && pool->size()>2; n++)
+        this_thread::sleep_for(chrono::milliseconds(10));
+      BOOST_CHECK(pool->size()==2);
+    }
+    pool->destroy();
+#endif
+
+    // Workers busy running CPU bound work make no progress either, but adding more would gain nothing
+    pool=std::make_shared<std_thread_pool>(thread_pool_bounds(2, 6, chrono::milliseconds(100), chrono::milliseconds(10)));
+    {
+      std::vector<shared_future<void>> busy;
+      for(size_t n=0; n<4; n++)
+        busy.push_back(pool->enqueue([]{
+          auto end=chrono::steady_clock::now()+chrono::milliseconds(300);
+          while(chrono::steady_clock::now()<end);
+        }));
+      size_t peak=0;
+      for(auto &i: busy)
+      {
+        while(i.wait_for(chrono::milliseconds(1))!=future_status::ready)
+          peak=(std::max)(peak, pool->size());
+        BOOST_CHECK_NO_THROW(i.get());
+      }
+      BOOST_CHECK(peak==2);
+    }
+    pool->destroy();
+}
@@ -0,0 +1,49 @@
+#include "test_functions.hpp"
+
+BOOST_AFIO_AUTO_TEST_CASE(async_io_admission_control, "Tests that admission control limits the ops in flight", 60)
+{
+    using namespace BOOST_AFIO_V2_NAMESPACE;
+    auto dispatcher=make_dispatcher().get();
+
+    // With would_block, ops beyond the limit are refused
+    {
+        atomic<bool> go(false);
+        atomic<size_t> lowwatermarks(0);
+        dispatcher->admission_control(4, 0, admission_policy::would_block);
+        dispatcher->admission_low_watermark(0, [&lowwatermarks]{ ++lowwatermarks; });
+        std::vector<future<>> admitted;
+        for(size_t n=0; n<4; n++)
+            admitted.push_back(dispatcher->call(future<>(), [&go]{ while(!go) this_thread::yield(); }));
+        future<> refused=dispatcher->call(future<>(), []{});
+        BOOST_REQUIRE(refused.is_ready());
+        BOOST_CHECK(refused.get_error().value()==EWOULDBLOCK);
+        go=true;
+        when_all_p(admitted).wait();
+        // Completing the admitted ops drains below the low watermark exactly once
+        while(!lowwatermarks)
+            this_thread::yield();
+        BOOST_CHECK(lowwatermarks==1);
+        dispatcher->admission_low_watermark(0, std::function<void()>());
+    }
+
+    // With block, scheduling waits until there is room
+    {
+        static const size_t limit=8;
+        atomic<size_t> inflight(0), maxinflight(0);
+        dispatcher->admission_control(limit, 0, admission_policy::block);
+        std::vector<future<>> ops;
+        for(size_t n=0; n<1000; n++)
+        {
+            ops.push_back(dispatcher->call(future<>(), [&inflight, &maxinflight]{
+                size_t now=++inflight, was=maxinflight;
+                while(now>was && !maxinflight.compare_exchange_weak(was, now));
+                this_thread::sleep_for(chrono::microseconds(10));
+                --inflight;
+            }));
+            BOOST_CHECK(dispatcher->wait_queue_depth()<=limit);
+        }
+        when_all_p(ops).wait();
+        BOOST_CHECK(maxinflight<=limit);
+    }
+    dispatcher->admission_control(0);
+}
@@ -0,0 +1,43 @@
+#include "test_functions.hpp"
+
+BOOST_AFIO_AUTO_TEST_CASE(async_io_cancellation, "Tests that ops cancelled or past their deadline before starting never execute", 60)
+{
+    using namespace BOOST_AFIO_V2_NAMESPACE;
+    auto dispatcher=make_dispatcher().get();
+    atomic<size_t> executed(0);
+
+    // Cancelling an op waiting on its precondition cascades to its dependents
+    {
+        atomic<bool> go(false);
+        future<> gate=dispatcher->call(future<>(), [&go]{ while(!go) this_thread::yield(); });
+        future<> a=dispatcher->call(gate, [&executed]{ ++executed; });
+        future<> b=dispatcher->call(a, [&executed]{ ++executed; });
+        BOOST_CHECK(dispatcher->cancel(a));
+        BOOST_CHECK(!dispatcher->cancel(a));
+        go=true;
+        std::vector<future<>> all={ gate, a, b };
+        when_all_p(std::nothrow, all).wait();
+        BOOST_CHECK(!gate.has_exception());
+        BOOST_CHECK(a.get_error().value()==ECANCELED);
+        BOOST_CHECK(b.get_error().value()==ECANCELED);
+        BOOST_CHECK(executed==0);
+        BOOST_CHECK(!dispatcher->cancel(gate));
+    }
+
+    // An op whose deadline passes while it waits is dropped when dequeued
+    {
+        atomic<bool> go(false);
+        future<> gate=dispatcher->call(future<>(), [&go]{ while(!go) this_thread::yield(); });
+        future<> c=dispatcher->call(gate, [&executed]{ ++executed; });
+        future<> d=dispatcher->call(gate, [&executed]{ ++executed; });
+        BOOST_CHECK(dispatcher->deadline(c, chrono::steady_clock::now()+chrono::milliseconds(1)));
+        BOOST_CHECK(dispatcher->deadline(d, chrono::steady_clock::now()+chrono::hours(1)));
+        this_thread::sleep_for(chrono::milliseconds(10));
+        go=true;
+        std::vector<future<>> all={ c, d };
+        when_all_p(std::nothrow, all).wait();
+        BOOST_CHECK(c.get_error().value()==ETIMEDOUT);
+        BOOST_CHECK(!d.has_exception());
+        BOOST_CHECK(executed==1);
+    }
+}
@@ -0,0 +1,74 @@
+#include "test_functions.hpp"
+
+#if BOOST_AFIO_HAVE_COROUTINES
+namespace coroutines_test
+{
+    using namespace BOOST_AFIO_V2_NAMESPACE;
+    static atomic<size_t> outstanding(0), sum(0), errors(0);
+    struct task
+    {
+        struct promise_type
+        {
+            task get_return_object() { return task(); }
+            std::suspend_never initial_suspend() noexcept { ++outstanding; return {}; }
+            std::suspend_never final_suspend() noexcept { --outstanding; return {}; }
+            void return_void() { }
+            void unhandled_exception() { ++errors; }
+        };
+    };
+    task adder(dispatcher_ptr dispatcher, size_t n)
+    {
+        // A chain of ops, each awaited in turn
+        auto a=dispatcher->call(future<>(), [n]{ return n; });
+        size_t x=co_await a;
+        size_t y=co_await dispatcher->call(a, [x]{ return x; });
+        co_await dispatcher->barrier({ future<>(a) }).front();
+        sum+=x+y;
+    }
+    task failer(dispatcher_ptr dispatcher)
+    {
+        try
+        {
+            // A callable returning void reports its exception through a future<void> it doesn't keep, so return something
+            co_await dispatcher->call(future<>(), []() -> int { throw std::runtime_error("Deliberate"); });
+        }
+        catch(const std::runtime_error &)
+        {
+            ++errors;
+        }
+    }
+    task ready(future<> op, size_t count)
+    {
+        // Awaiting a completed op doesn't suspend, and so must not recurse either
+        for(size_t n=0; n<count; n++)
+        {
+            co_await op;
+            ++sum;
+        }
+    }
+}
+#endif
+
+BOOST_AFIO_AUTO_TEST_CASE(async_io_coroutines, "Tests that coroutines can co_await futures", 60)
+{
+#if BOOST_AFIO_HAVE_COROUTINES
+    using namespace coroutines_test;
+    auto dispatcher=make_dispatcher().get();
+    for(size_t n=1; n<=10000; n++)
+        adder(dispatcher, n);
+    failer(dispatcher);
+    while(outstanding)
+        this_thread::yield();
+    BOOST_CHECK(sum==10000*10001);
+    BOOST_CHECK(errors==1);
+
+    sum=0;
+    auto op=dispatcher->call(future<>(), []{ });
+    op.get();
+    ready(op, 100000);
+    BOOST_CHECK(!outstanding);
+    BOOST_CHECK(sum==100000);
+#else
+    BOOST_TEST_MESSAGE("Skipping coroutine tests as C++ 20 coroutines are not available");
+#endif
+}
@@ -0,0 +1,45 @@
+#include "test_functions.hpp"
+
+BOOST_AFIO_AUTO_TEST_CASE(async_io_error_code, "Tests that routine failures to open complete with an error code rather than an exception", 60)
+{
+    // Only the POSIX dispatcher completes open failures with an error code
+#ifndef WIN32
+    using namespace BOOST_AFIO_V2_NAMESPACE;
+    auto dispatcher=make_dispatcher().get();
+    {
+      auto mkdir(dispatcher->dir(path_req("testdir", file_flags::create)));
+      auto mkfile(dispatcher->file(path_req::relative(mkdir, "foo", file_flags::create | file_flags::write)));
+      BOOST_REQUIRE_NO_THROW(mkfile.get());
+      // Exclusively creating what already exists fails, and the error is retrievable without throwing
+      auto lockfile(dispatcher->file(path_req::relative(mkdir, "foo", file_flags::create_only_if_not_exist | file_flags::write)));
+      error_code ec;
+      BOOST_CHECK_NO_THROW(ec=lockfile.get_error());
+      BOOST_CHECK(ec.value()==EEXIST);
+      BOOST_CHECK(lockfile.has_error());
+      BOOST_CHECK(lockfile.has_exception());
+      BOOST_CHECK(!lockfile.has_exception(true));
+      BOOST_CHECK(!lockfile.get_handle(true));
+      // Anyone asking for an exception still gets one
+      BOOST_CHECK(!!lockfile.get_exception());
+      BOOST_CHECK_THROW(lockfile.get(), system_error);
+      // Barriers pass the error along as is
+      auto barriered(dispatcher->barrier({ lockfile, mkfile }));
+      BOOST_CHECK(barriered.front().get_error().value()==EEXIST);
+      BOOST_CHECK_NO_THROW(barriered.back().get());
+      // Ops depending on the failed one fail too
+      auto sync(dispatcher->sync(lockfile));
+      BOOST_CHECK_THROW(sync.get(), system_error);
+      auto nodir(dispatcher->dir(path_req::relative(mkdir, "foo", file_flags::create_only_if_not_exist)));
+      BOOST_CHECK(nodir.get_error().value()==EEXIST);
+      auto nofile(dispatcher->file(path_req::relative(mkdir, "bar", file_flags::read)));
+      BOOST_CHECK(nofile.get_error().value()==ENOENT);
+      auto closefile(dispatcher->close(mkfile));
+      auto delfile(dispatcher->rmfile(closefile));
+      auto deldir(dispatcher->rmdir(dispatcher->depends(delfile, mkdir)));
+      BOOST_CHECK_NO_THROW(delfile.get());
+      BOOST_CHECK_NO_THROW(deldir.wait());  // virus checkers sometimes make this spuriously fail
+    }
+#endif
+    // Add a single output to validate the test
+    BOOST_CHECK(true);
+}
@@ -0,0 +1,76 @@
+#include "test_functions.hpp"
+
+namespace {
+  // Posts work to a std_thread_pool as usual, counting how much went through the thread source
+  struct counting_thread_source : BOOST_AFIO_V2_NAMESPACE::thread_source
+  {
+    std::shared_ptr<BOOST_AFIO_V2_NAMESPACE::std_thread_pool> pool;
+    BOOST_AFIO_V2_NAMESPACE::atomic<size_t> enqueued;
+    explicit counting_thread_source(std::shared_ptr<BOOST_AFIO_V2_NAMESPACE::std_thread_pool> _pool) : thread_source(_pool->io_service()), pool(std::move(_pool)), enqueued(0) { }
+  protected:
+    using thread_source::int_enqueue;
+    void int_enqueue(BOOST_AFIO_V2_NAMESPACE::detail::work_item &&item) override
+    {
+      ++enqueued;
+      thread_source::int_enqueue(std::move(item));
+    }
+  };
+}
+
+BOOST_AFIO_AUTO_TEST_CASE(async_io_inline_continuations, "Tests that continuations run inline by the completing thread all execute and in order", 60)
+{
+    using namespace BOOST_AFIO_V2_NAMESPACE;
+    static const size_t chainlength=
+#if defined(BOOST_AFIO_RUNNING_IN_CI) || defined(BOOST_AFIO_COMPILING_FOR_GCOV)
+        1000
+#else
+        10000
+#endif
+        ;
+    static const size_t depth=8;
+    auto source=std::make_shared<counting_thread_source>(std::make_shared<std_thread_pool>(4));
+    auto dispatcher=make_dispatcher("file:///", file_flags::none, file_flags::none, source).get();
+    BOOST_CHECK(dispatcher->inline_continuation_depth()==BOOST_AFIO_INLINE_CONTINUATION_DEPTH);
+    dispatcher->inline_continuation_depth(depth);
+    BOOST_CHECK(dispatcher->inline_continuation_depth()==depth);
+
+    // Hold the head back until the whole chain is scheduled so every hop goes through op completion.
+    // A chain far longer than the permitted depth must neither overflow the stack nor lose hops.
+    atomic<bool> go(false);
+    thread::id headthread;
+    std::vector<size_t> order;
+    std::vector<thread::id> threads;
+    order.reserve(chainlength);
+    threads.reserve(chainlength);
+    future<> last=dispatcher->call(future<>(), [&go, &headthread]{ while(!go) this_thread::yield(); headthread=this_thread::get_id(); });
+    for(size_t n=0; n<chainlength; n++)
+        last=dispatcher->call(last, [&order, &threads, n]{ order.push_back(n); threads.push_back(this_thread::get_id()); });
+    size_t enqueued=source->enqueued;
+    go=true;
+    when_all_p(last).wait();
+    enqueued=source->enqueued-enqueued;
+    BOOST_REQUIRE(order.size()==chainlength);
+    for(size_t n=0; n<chainlength; n++)
+        BOOST_CHECK(order[n]==n);
+    // The first hops ran inline on the thread which completed the head
+    for(size_t n=0; n<depth; n++)
+        BOOST_CHECK(threads[n]==headthread);
+    // Every depth+1 hops the permitted depth is reached, and the next hop goes through the thread source instead
+    BOOST_CHECK(enqueued>=chainlength/(depth+1));
+    BOOST_CHECK(enqueued<=chainlength/depth);
+
+    // Fan out from one precondition so only the first dependent may run inline
+    go=false;
+    atomic<size_t> count(0);
+    std::vector<future<>> fanout;
+    fanout.reserve(100);
+    future<> head=dispatcher->call(future<>(), [&go]{ while(!go) this_thread::yield(); });
+    for(size_t n=0; n<100; n++)
+        fanout.push_back(dispatcher->call(head, [&count]{ ++count; }));
+    enqueued=source->enqueued;
+    go=true;
+    when_all_p(fanout).wait();
+    enqueued=source->enqueued-enqueued;
+    BOOST_CHECK(count==100);
+    BOOST_CHECK(enqueued>=99);
+}
@@ -0,0 +1,44 @@
+#include "test_functions.hpp"
+
+BOOST_AFIO_AUTO_TEST_CASE(async_io_inline_sync, "Tests that the synchronous functions run ops ready to run on the calling thread", 60)
+{
+    using namespace BOOST_AFIO_V2_NAMESPACE;
+    using BOOST_AFIO_V2_NAMESPACE::file;
+    using BOOST_AFIO_V2_NAMESPACE::rmdir;
+    auto dispatcher=make_dispatcher().get();
+    current_dispatcher_guard h(dispatcher);
+    std::mutex lock;
+    std::vector<std::pair<detail::OpType, thread::id>> ran;
+    dispatcher->post_op_filter({ std::make_pair(detail::OpType::Unknown, std::function<dispatcher::filter_t>(
+      [&](detail::OpType optype, future<> &) {
+        std::lock_guard<std::mutex> g(lock);
+        ran.push_back(std::make_pair(optype, this_thread::get_id()));
+      })) });
+    char buffer[64]="Hello world", readback[64]={0};
+    {
+      auto diropened = dir("testdir", file_flags::create | file_flags::write);
+      auto fileopened = file(diropened, "testfile", file_flags::create | file_flags::read_write);
+      truncate(fileopened, sizeof(buffer));
+      // Filters and completions still see every op, and the ops ran here
+      {
+        std::lock_guard<std::mutex> g(lock);
+        BOOST_CHECK(ran.size()==3);
+        for(auto &i : ran)
+          BOOST_CHECK(i.second==this_thread::get_id());
+      }
+      // Where the kernel does reads and writes, they complete elsewhere but still work
+      write(fileopened, buffer, 0);
+      read(fileopened, readback, 0);
+      BOOST_CHECK(!memcmp(buffer, readback, sizeof(buffer)));
+      // Errors are reported as usual
+      error_code ec;
+      auto nofile = file(ec, diropened, "nonexistent", file_flags::read);
+      BOOST_CHECK(!nofile);
+      BOOST_CHECK(!!ec);
+      // The async functions still run ops on the thread pool
+      auto ranon = dispatcher->call(future<>(), []{ return this_thread::get_id(); });
+      BOOST_CHECK(ranon.get()!=this_thread::get_id());
+      rmfile(fileopened);
+      rmdir(diropened);
+    }
+}
@@ -0,0 +1,56 @@
+#include "test_functions.hpp"
+
+BOOST_AFIO_AUTO_TEST_CASE(async_io_kaio, "Tests that the compat dispatcher reads and writes os_direct files correctly", 60)
+{
+    using namespace BOOST_AFIO_V2_NAMESPACE;
+#if defined(WIN32) && !defined(USE_POSIX_ON_WIN32)
+    BOOST_CHECK(make_dispatcher("file:///?compat").has_error());
+#else
+    static const size_t blocks=2048, blocksize=4096, gathered=1536;
+    std::vector<char, detail::aligned_allocator<char, 4096>> buffer(blocks*blocksize), readback(blocks*blocksize);
+    ranctx ctx; raninit(&ctx, 1);
+    u4 *buf=(u4 *) buffer.data();
+    for(size_t n=0; n<buffer.size()/sizeof(*buf); n++)
+      buf[n]=ranval(&ctx);
+    // Never io_uring, so os_direct reads and writes go through Linux native AIO where there is one
+    auto dispatcher=make_dispatcher("file:///?compat", file_flags::os_direct).get();
+    {
+      auto mkdir(dispatcher->dir(path_req("testdir", file_flags::create)));
+      auto mkfile(dispatcher->file(path_req::relative(mkdir, "foo", file_flags::create | file_flags::read_write)));
+      auto resizefile(dispatcher->truncate(mkfile, buffer.size()));
+      // Most of the file as one op of more buffers than one submission takes, the rest an op per block
+      std::vector<asio::const_buffer> gather;
+      for(size_t n=0; n<gathered; n++)
+        gather.push_back(asio::const_buffer(buffer.data()+n*blocksize, blocksize));
+      std::vector<io_req<const char>> writes;
+      for(size_t n=gathered; n<blocks; n++)
+        writes.push_back(io_req<const char>(resizefile, buffer.data()+n*blocksize, blocksize, n*blocksize));
+      auto written(dispatcher->write(writes));
+      written.push_back(dispatcher->write(detail::io_req_impl<true>(resizefile, gather, 0)));
+      auto syncfile(dispatcher->sync(dispatcher->barrier(written).front()));
+      std::vector<asio::mutable_buffer> scatter;
+      for(size_t n=0; n<gathered; n++)
+        scatter.push_back(asio::mutable_buffer(readback.data()+n*blocksize, blocksize));
+      std::vector<io_req<char>> reads;
+      for(size_t n=gathered; n<blocks; n++)
+        reads.push_back(io_req<char>(syncfile, readback.data()+n*blocksize, blocksize, n*blocksize));
+      auto read(dispatcher->read(reads));
+      read.push_back(dispatcher->read(detail::io_req_impl<false>(syncfile, scatter, 0)));
+      BOOST_REQUIRE_NO_THROW(when_all_p(written).get());
+      BOOST_REQUIRE_NO_THROW(when_all_p(read).get());
+      BOOST_CHECK(!memcmp(buffer.data(), readback.data(), buffer.size()));
+      BOOST_CHECK(mkfile->write_count()==buffer.size());
+      BOOST_CHECK(mkfile->read_count()==buffer.size());
+      BOOST_CHECK(mkfile->write_count_since_fsync()==0);
+#if BOOST_AFIO_HAVE_KAIO
+      // Every read and write was completed by the KAIO reaper rather than done as a blocking syscall by the pool
+      BOOST_CHECK(dispatcher->kernel_queue_ops()==2*(blocks-gathered+1));
+#endif
+      auto closefile(dispatcher->close(dispatcher->barrier(read).front()));
+      auto delfile(dispatcher->rmfile(closefile));
+      auto deldir(dispatcher->rmdir(dispatcher->depends(delfile, mkdir)));
+      BOOST_CHECK_NO_THROW(delfile.get());
+      BOOST_CHECK_NO_THROW(deldir.wait());  // virus checkers sometimes make this spuriously fail
+    }
+#endif
+}
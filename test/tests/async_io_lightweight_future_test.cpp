@@ -0,0 +1,41 @@
+#include "test_functions.hpp"
+
+BOOST_AFIO_AUTO_TEST_CASE(async_io_lightweight_future, "Tests that the lock free shared state of op futures wakes every waiter", 60)
+{
+    using namespace BOOST_AFIO_V2_NAMESPACE;
+    auto dispatcher=make_dispatcher().get();
+    for(size_t iter=0; iter<1000; iter++)
+    {
+        // Several threads wait upon an op which completes either before or after they start sleeping
+        atomic<bool> go(false);
+        auto op=dispatcher->call(future<>(), [&go]{ while(!go) this_thread::yield(); });
+        atomic<size_t> woken(0);
+        std::vector<thread> waiters;
+        for(size_t n=0; n<4; n++)
+            waiters.push_back(thread([&op, &woken]{ future<> f(op); f.wait(); ++woken; }));
+        if(iter&1)
+            this_thread::sleep_for(chrono::microseconds(100));
+        if(!iter)
+            BOOST_CHECK(future_status::timeout==op.wait_for(chrono::milliseconds(10)));
+        go=true;
+        for(auto &i: waiters)
+            i.join();
+        BOOST_CHECK(woken==4);
+        BOOST_CHECK(future_status::ready==op.wait_for(chrono::seconds(0)));
+    }
+    // Exceptions come out of every copy
+    auto failed=dispatcher->completion(future<>(), std::make_pair(async_op_flags::none, std::function<dispatcher::completion_t>([](size_t, future<>) -> std::pair<bool, handle_ptr> {
+        throw std::runtime_error("Deliberate");
+    })));
+    future<> copy(failed);
+    BOOST_CHECK_THROW(failed.get(), std::runtime_error);
+    BOOST_CHECK(!!copy.get_exception());
+    BOOST_CHECK(!copy.get_handle(true));
+    // Futures made from a handle are ready immediately
+    auto mkdir(dispatcher->dir(path_req("testdir", file_flags::create)));
+    future<> fromhandle(mkdir.get_handle());
+    BOOST_CHECK(future_status::ready==fromhandle.wait_for(chrono::seconds(0)));
+    BOOST_CHECK(fromhandle.get_handle()==mkdir.get_handle());
+    auto deldir(dispatcher->rmdir(mkdir));
+    deldir.get();
+}
@@ -0,0 +1,52 @@
+#include "test_functions.hpp"
+
+BOOST_AFIO_AUTO_TEST_CASE(async_io_op_tracing, "Tests that the op tracer records the lifecycle of ops as Chrome trace JSON", 60)
+{
+    using namespace BOOST_AFIO_V2_NAMESPACE;
+#if BOOST_AFIO_OP_TRACING
+    enable_op_tracing();
+    auto dispatcher=make_dispatcher().get();
+    auto mkdir(dispatcher->dir(path_req("testdir", file_flags::create)));
+    auto mkfile(dispatcher->file(dispatcher->depends(mkdir, path_req("testdir/foo", file_flags::create|file_flags::read_write))));
+    char buffer[64]={ 78 };
+    auto written(dispatcher->write(make_io_req(mkfile, buffer, sizeof(buffer), 0)));
+    auto synced(dispatcher->sync(written));
+    auto closed(dispatcher->close(synced));
+    auto rmfile(dispatcher->rmfile(dispatcher->depends(closed, path_req("testdir/foo"))));
+    auto rmdir(dispatcher->rmdir(dispatcher->depends(rmfile, path_req("testdir"))));
+    when_all_p(rmdir).wait();
+    enable_op_tracing(false);
+
+    std::stringstream s;
+    write_op_trace(s);
+    std::string trace(s.str());
+    BOOST_CHECK(trace.compare(0, 15, "{\"traceEvents\":")==0);
+    BOOST_CHECK(trace.find("\"name\":\"queued\"")!=std::string::npos);
+    BOOST_CHECK(trace.find("\"ph\":\"b\",\"cat\":\"afio\",\"name\":\"write\"")!=std::string::npos);
+    BOOST_CHECK(trace.find("\"ph\":\"e\",\"cat\":\"afio\",\"name\":\"sync\"")!=std::string::npos);
+    BOOST_CHECK(trace.find("\"ph\":\"B\",\"cat\":\"afio\",\"name\":\"write\"")!=std::string::npos);
+    BOOST_CHECK(trace.find("\"ph\":\"E\",\"cat\":\"afio\",\"name\":\"write\"")!=std::string::npos);
+    BOOST_CHECK(trace.find("\"name\":\"thread_name\"")!=std::string::npos);
+
+    // Threads which have exited hand their ring on to new threads rather than each keeping one forever
+    auto threads=[](const std::string &trace) {
+        size_t count=0;
+        for(size_t pos=0; (pos=trace.find("\"name\":\"thread_name\"", pos))!=std::string::npos; pos++)
+            count++;
+        return count;
+    };
+    size_t before=threads(trace);
+    enable_op_tracing();
+    for(size_t n=0; n<64; n++)
+    {
+        thread t([&dispatcher]{ dispatcher->call(future<>(), []{}).get(); });
+        t.join();
+    }
+    enable_op_tracing(false);
+    s.str(std::string());
+    write_op_trace(s);
+    BOOST_CHECK(threads(s.str())<before+16);  // allowing for pool workers spawned meanwhile
+#else
+    BOOST_TEST_MESSAGE("Op tracing not compiled in, define BOOST_AFIO_OP_TRACING=1 to test it");
+#endif
+}
@@ -0,0 +1,54 @@
+#include "test_functions.hpp"
+
+BOOST_AFIO_AUTO_TEST_CASE(async_io_priority_lanes, "Tests that latency critical ops overtake background ops waiting for a thread", 60)
+{
+    using namespace BOOST_AFIO_V2_NAMESPACE;
+    auto pool=std::make_shared<std_thread_pool>(1);
+    auto dispatcher=make_dispatcher("file:///", file_flags::none, file_flags::none, pool).get();
+    BOOST_CHECK(dispatcher->op_priority(detail::OpType::enumerate)==async_op_flags::none);
+    dispatcher->op_priority(detail::OpType::enumerate, async_op_flags::latency_critical);
+    BOOST_CHECK(dispatcher->op_priority(detail::OpType::enumerate)==async_op_flags::latency_critical);
+    dispatcher->op_priority(detail::OpType::enumerate, async_op_flags::none);
+
+    // Occupy the sole worker while the background and latency critical ops queue up behind it
+    atomic<bool> go(false);
+    future<> blocker=dispatcher->call(future<>(), [&go]{ while(!go) this_thread::yield(); });
+    std::vector<int> order;  // only ever touched by the sole worker
+    auto record=[&order](int lane) -> std::function<dispatcher::completion_t> {
+        return [&order, lane](size_t, future<> op) -> std::pair<bool, handle_ptr> {
+            order.push_back(lane);
+            return std::make_pair(true, op.get_handle());
+        };
+    };
+    std::vector<std::pair<async_op_flags, std::function<dispatcher::completion_t>>> background(100, std::make_pair(async_op_flags::background, record(2)));
+    std::vector<std::pair<async_op_flags, std::function<dispatcher::completion_t>>> critical(10, std::make_pair(async_op_flags::latency_critical, record(0)));
+    auto backgroundops=dispatcher->completion(std::vector<future<>>(), background);
+    auto criticalops=dispatcher->completion(std::vector<future<>>(), critical);
+    go=true;
+    when_all_p(backgroundops).wait();
+    when_all_p(criticalops).wait();
+    when_all_p(blocker).wait();
+    BOOST_REQUIRE(order.size()==110);
+    for(size_t n=0; n<10; n++)
+        BOOST_CHECK(order[n]==0);
+    for(size_t n=10; n<110; n++)
+        BOOST_CHECK(order[n]==2);
+
+    // A continuation may only run inline on the thread completing its precondition if nothing more urgent is waiting
+    dispatcher->inline_continuation_depth(8);
+    order.clear();
+    go=false;
+    atomic<bool> running(false);
+    blocker=dispatcher->call(future<>(), [&go, &running]{ running=true; while(!go) this_thread::yield(); });
+    while(!running)
+        this_thread::yield();
+    auto continuation=dispatcher->completion(blocker, std::make_pair(async_op_flags::background, record(2)));
+    criticalops=dispatcher->completion(std::vector<future<>>(), critical);
+    go=true;
+    when_all_p(criticalops).wait();
+    when_all_p(continuation).wait();
+    BOOST_REQUIRE(order.size()==11);
+    for(size_t n=0; n<10; n++)
+        BOOST_CHECK(order[n]==0);
+    BOOST_CHECK(order[10]==2);
+}
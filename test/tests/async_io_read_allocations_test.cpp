@@ -0,0 +1,35 @@
+#include "test_functions.hpp"
+
+BOOST_AFIO_AUTO_TEST_CASE(async_io_read_allocations, "Tests that scheduling a read copies its buffer list just the once", 60)
+{
+    using namespace BOOST_AFIO_V2_NAMESPACE;
+    auto dispatcher=make_dispatcher().get();
+    {
+      auto mkdir(dispatcher->dir(path_req("testdir", file_flags::create)));
+      auto mkfile(dispatcher->file(path_req::relative(mkdir, "foo", file_flags::create | file_flags::read_write)));
+      auto mkfilesize(dispatcher->truncate(mkfile, 4096));
+      // Buffer lists so long that copying one is the biggest allocation made while scheduling
+      static char buffer[64][64];
+      std::vector<asio::mutable_buffer> buffers;
+      for(auto &b: buffer)
+        buffers.push_back(asio::mutable_buffer(b, sizeof(b)));
+      std::vector<detail::io_req_impl<false>> reqs;
+      for(size_t n=0; n<16; n++)
+        reqs.push_back(detail::io_req_impl<false>(mkfilesize, buffers, 0));
+      // Warm up the op record free lists of this thread
+      BOOST_REQUIRE_NO_THROW(when_all_p(dispatcher->read(reqs)).get());
+      allocation_threshold()=buffers.size()*sizeof(asio::mutable_buffer);
+      size_t allocations=thread_allocations();
+      auto reads(dispatcher->read(reqs));
+      allocations=thread_allocations()-allocations;
+      allocation_threshold()=0;
+      // Each op keeps its own copy, which is the only one ever made
+      BOOST_CHECK(allocations==reqs.size());
+      BOOST_CHECK_NO_THROW(when_all_p(reads).get());
+      auto closefile(dispatcher->close(mkfilesize));
+      auto delfile(dispatcher->rmfile(closefile));
+      auto deldir(dispatcher->rmdir(dispatcher->depends(delfile, mkdir)));
+      BOOST_CHECK_NO_THROW(delfile.get());
+      BOOST_CHECK_NO_THROW(deldir.wait());  // virus checkers sometimes make this spuriously fail
+    }
+}
@@ -0,0 +1,49 @@
+#include "test_functions.hpp"
+
+BOOST_AFIO_AUTO_TEST_CASE(async_io_stall_detector, "Tests that the stall detector reports ops in flight for too long, once each", 60)
+{
+    using namespace BOOST_AFIO_V2_NAMESPACE;
+    auto dispatcher=make_dispatcher().get();
+    std::mutex lock;
+    std::vector<stalled_op> reported;
+    dispatcher->stall_detector(chrono::milliseconds(50), [&](const stalled_op &op) {
+        std::lock_guard<std::mutex> g(lock);
+        reported.push_back(op);
+    }, chrono::milliseconds(10));
+    atomic<bool> release(false);
+    auto blocked=dispatcher->call(future<>(), [&release]{
+        while(!release)
+            this_thread::sleep_for(chrono::milliseconds(1));
+    });
+    // This waits on the blocked op, so only the blocked op should be reported
+    auto waiting=dispatcher->call(blocked, []{});
+    // Ops completing promptly are never reported
+    for(size_t n=0; n<100; n++)
+        dispatcher->call(future<>(), []{}).get();
+    for(size_t n=0; n<1000; n++)
+    {
+        {
+            std::lock_guard<std::mutex> g(lock);
+            if(!reported.empty())
+                break;
+        }
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    // Let a few more scans happen to check nothing is reported twice
+    this_thread::sleep_for(chrono::milliseconds(100));
+    dispatcher->stall_detector(chrono::milliseconds(50), std::function<dispatcher::stall_handler_t>());
+    {
+        std::lock_guard<std::mutex> g(lock);
+        BOOST_REQUIRE(reported.size()==1);
+        BOOST_CHECK(reported.front().id==blocked.id());
+        BOOST_CHECK(reported.front().optype==detail::OpType::UserCompletion);
+        BOOST_CHECK(reported.front().age>=chrono::milliseconds(50));
+        BOOST_CHECK(reported.front().running>chrono::steady_clock::duration(0));
+        BOOST_CHECK(reported.front().running<=reported.front().age);
+        BOOST_CHECK(reported.front().depth==0);
+        BOOST_CHECK(reported.front().dependents==1);
+        BOOST_CHECK(reported.front().handle_path.empty());
+    }
+    release=true;
+    BOOST_CHECK_NO_THROW(waiting.get());
+}
@@ -0,0 +1,73 @@
+#include "test_functions.hpp"
+
+BOOST_AFIO_AUTO_TEST_CASE(async_io_stats, "Tests that the dispatcher records per op type latency histograms", 60)
+{
+    using namespace BOOST_AFIO_V2_NAMESPACE;
+
+    // Buckets are contiguous and accurate to within 1/sub_buckets
+    for(size_t n=0; n<latency_histogram::buckets; n++)
+    {
+        BOOST_CHECK(latency_histogram::bucket(latency_histogram::bucket_value(n))==n);
+        BOOST_CHECK(latency_histogram::bucket(latency_histogram::bucket_highest_value(n))==n);
+    }
+    {
+        latency_histogram h;
+        BOOST_CHECK(h.percentile(50).count()==0);
+        for(int n=1; n<=1000; n++)
+            h.record(chrono::microseconds(n));
+        BOOST_CHECK(h.count()==1000);
+        BOOST_CHECK(h.mean()==chrono::nanoseconds(500500));
+        auto p50=h.percentile(50), p99=h.percentile(99);
+        BOOST_CHECK(p50>=chrono::microseconds(500) && p50<=chrono::microseconds(500)*(latency_histogram::sub_buckets+1)/latency_histogram::sub_buckets);
+        BOOST_CHECK(p99>=chrono::microseconds(990) && p99<=chrono::microseconds(990)*(latency_histogram::sub_buckets+1)/latency_histogram::sub_buckets);
+        BOOST_CHECK(h.lowest()<=chrono::microseconds(1));
+        BOOST_CHECK(h.highest()>=chrono::microseconds(1000));
+    }
+    {
+        // Latencies beyond the last bucket's lower bound are reported as the longest representable, never as negative
+        latency_histogram h;
+        h.record(chrono::nanoseconds((chrono::nanoseconds::rep) latency_histogram::bucket_value(latency_histogram::buckets-1)+1));
+        h.record(chrono::hours(24*365));
+        BOOST_CHECK(h.count(latency_histogram::buckets-1)==2);
+        BOOST_CHECK(h.percentile(50)==(chrono::nanoseconds::max)());
+        BOOST_CHECK(h.highest()==(chrono::nanoseconds::max)());
+        BOOST_CHECK(h.lowest()==chrono::nanoseconds((chrono::nanoseconds::rep) latency_histogram::bucket_value(latency_histogram::buckets-1)));
+    }
+
+    auto dispatcher=make_dispatcher().get();
+    BOOST_CHECK(dispatcher->stats().all().total.count()==0);
+    auto sleeper=std::make_pair(async_op_flags::none, std::function<dispatcher::completion_t>([](size_t, future<> op) {
+        this_thread::sleep_for(chrono::microseconds(100));
+        return std::make_pair(true, op.get_handle());
+    }));
+    auto noop=std::make_pair(async_op_flags::none, std::function<dispatcher::completion_t>([](size_t, future<> op) {
+        return std::make_pair(true, op.get_handle());
+    }));
+    std::vector<future<>> ops;
+    for(size_t n=0; n<100; n++)
+        ops.push_back(dispatcher->completion(future<>(), sleeper));
+    // Latencies are recorded before an op completes
+    when_all_p(ops).wait();
+    auto before=dispatcher->stats();
+    const op_latencies &calls=before[detail::OpType::UserCompletion];
+    BOOST_CHECK(calls.total.count()==100);
+    BOOST_CHECK(calls.queued.count()==100);
+    BOOST_CHECK(calls.executing.count()==100);
+    BOOST_CHECK(calls.executing.percentile(50)>=chrono::microseconds(100));
+    BOOST_CHECK(calls.total.percentile(99)>=calls.executing.percentile(50));
+    BOOST_CHECK(before.all().total.count()==100);
+
+    // Diffing yields only what completed in between
+    ops.clear();
+    for(size_t n=0; n<10; n++)
+        ops.push_back(dispatcher->completion(future<>(), noop));
+    when_all_p(ops).wait();
+    auto diff=dispatcher->stats()-before;
+    BOOST_CHECK(diff[detail::OpType::UserCompletion].total.count()==10);
+    BOOST_CHECK(dispatcher->stats()[detail::OpType::UserCompletion].total.count()==110);
+
+    dispatcher->reset_stats();
+    BOOST_CHECK(dispatcher->stats().all().total.count()==0);
+    dispatcher->completion(future<>(), noop).get();
+    BOOST_CHECK(dispatcher->stats().all().total.count()==1);
+}
@@ -0,0 +1,47 @@
+#include "test_functions.hpp"
+
+BOOST_AFIO_AUTO_TEST_CASE(async_io_strand, "Tests that writes to a handle opened with file_flags::strand run in the order scheduled", 60)
+{
+    using namespace BOOST_AFIO_V2_NAMESPACE;
+    static const size_t blocks=1024, blocksize=512;
+    std::vector<char> buffer(blocks*blocksize), readback(blocks*blocksize);
+    for(size_t n=0; n<blocks; n++)
+      memset(buffer.data()+n*blocksize, (int)(n & 0xff), blocksize);
+    auto pool=std::make_shared<std_thread_pool>(4);
+    auto dispatcher=make_dispatcher("file:///", file_flags::none, file_flags::none, pool).get();
+    std::mutex lock;
+    std::vector<off_t> order;
+    dispatcher->post_readwrite_filter({ std::make_pair(detail::OpType::write, std::function<dispatcher::filter_readwrite_t>(
+      [&](detail::OpType, handle *, const detail::io_req_impl<true> &, off_t offset, size_t, size_t, const error_code &, size_t) {
+        std::lock_guard<std::mutex> g(lock);
+        order.push_back(offset);
+      })) });
+    {
+      auto mkdir(dispatcher->dir(path_req("testdir", file_flags::create)));
+      auto mkfile(dispatcher->file(path_req::relative(mkdir, "foo", file_flags::create | file_flags::read_write | file_flags::strand)));
+      BOOST_REQUIRE_NO_THROW(mkfile.get());
+      // Every write has the open as its precondition, so only the strand orders them
+      std::vector<io_req<const char>> writes;
+      for(size_t n=0; n<blocks/2; n++)
+        writes.push_back(io_req<const char>(mkfile, buffer.data()+n*blocksize, blocksize, n*blocksize));
+      std::vector<future<>> written(dispatcher->write(writes));
+      for(size_t n=blocks/2; n<blocks; n++)
+        written.push_back(dispatcher->write(io_req<const char>(mkfile, buffer.data()+n*blocksize, blocksize, n*blocksize)));
+      BOOST_REQUIRE_NO_THROW(when_all_p(written).get());
+      auto read(dispatcher->read(io_req<char>(dispatcher->sync(written.back()), readback.data(), readback.size(), 0)));
+      BOOST_REQUIRE_NO_THROW(read.get());
+      BOOST_CHECK(!memcmp(buffer.data(), readback.data(), buffer.size()));
+      {
+        std::lock_guard<std::mutex> g(lock);
+        BOOST_CHECK(order.size()==blocks);
+        BOOST_CHECK(std::is_sorted(order.begin(), order.end()));
+      }
+      auto closefile(dispatcher->close(read));
+      auto delfile(dispatcher->rmfile(closefile));
+      auto deldir(dispatcher->rmdir(dispatcher->depends(delfile, mkdir)));
+      BOOST_CHECK_NO_THROW(delfile.get());
+      BOOST_CHECK_NO_THROW(deldir.wait());  // virus checkers sometimes make this spuriously fail
+    }
+    dispatcher.reset();
+    pool->destroy();
+}
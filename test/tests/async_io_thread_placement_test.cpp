@@ -0,0 +1,42 @@
+#include "test_functions.hpp"
+
+BOOST_AFIO_AUTO_TEST_CASE(async_io_thread_placement, "Tests that thread pools with their workers pinned to cores or NUMA nodes execute everything enqueued to them", 30)
+{
+    using namespace BOOST_AFIO_V2_NAMESPACE;
+    auto topology=detail::numa_nodes();
+    BOOST_REQUIRE(!topology.empty());
+    for(auto &i: topology)
+        BOOST_CHECK(!i.empty());
+    std::cout << "This machine has " << topology.size() << " NUMA nodes" << std::endl;
+
+    for(auto placement : { thread_placement::none, thread_placement::core, thread_placement::numa_node })
+    {
+        auto pool=std::make_shared<std_thread_pool>(2, placement);
+        BOOST_CHECK(pool->numa_nodes()==(thread_placement::numa_node==placement ? topology.size() : 1));
+        // Work enqueued from outside the pool, and more enqueued from within it which stays on its node
+        atomic<size_t> count(0);
+        std::vector<shared_future<int>> results;
+        for(size_t n=0; n<1000; n++)
+        {
+            results.push_back(pool->enqueue([&count, pool]{
+                ++count;
+                pool->enqueue([&count]{ ++count; return 1; });
+                return 78;
+            }));
+        }
+        for(auto &i: results)
+            BOOST_CHECK(i.get()==78);
+        while(count<2000)
+            this_thread::yield();
+        BOOST_CHECK(count==2000);
+        // And ops scheduled by a dispatcher using it
+        auto dispatcher=make_dispatcher("file:///", file_flags::none, file_flags::none, pool).get();
+        std::vector<future<>> ops;
+        for(size_t n=0; n<100; n++)
+            ops.push_back(dispatcher->call(future<>(), [&count]{ ++count; }));
+        when_all_p(ops).wait();
+        BOOST_CHECK(count==2100);
+        dispatcher.reset();
+        pool->destroy();
+    }
+}
@@ -0,0 +1,62 @@
+#include "test_functions.hpp"
+
+BOOST_AFIO_AUTO_TEST_CASE(async_io_typed_completion, "Tests that completion() taking any callable works like the std::function overloads", 60)
+{
+    using namespace BOOST_AFIO_V2_NAMESPACE;
+    auto dispatcher=make_dispatcher().get();
+    atomic<size_t> ran(0);
+    size_t increment=1;
+    std::vector<future<>> ops;
+    for(size_t n=0; n<1000; n++)
+        ops.push_back(dispatcher->call(future<>(), []{}));
+    // A single chained continuation
+    auto mkdir(dispatcher->dir(path_req("testdir", file_flags::create)));
+    auto chained=dispatcher->completion(mkdir, [&ran, increment](size_t, future<> op) -> std::pair<bool, handle_ptr> {
+        ran+=increment;
+        return std::make_pair(true, op.get_handle());
+    });
+    BOOST_CHECK(chained.get_handle()==mkdir.get_handle());
+    // A batch, each invoking its own copy of the callable
+    auto batch=dispatcher->completion(ops, [&ran, increment](size_t, future<> op) -> std::pair<bool, handle_ptr> {
+        ran+=increment;
+        return std::make_pair(true, op.get_handle(true));
+    }, async_op_flags::immediate);
+    BOOST_CHECK(batch.size()==ops.size());
+    when_all_p(batch).get();
+    BOOST_CHECK(ran==ops.size()+1);
+    // Exceptions thrown by the callable are delivered as usual
+    auto failed=dispatcher->completion(chained, [](size_t, future<>) -> std::pair<bool, handle_ptr> {
+        throw std::runtime_error("Deliberate");
+    });
+    BOOST_CHECK_THROW(failed.get(), std::runtime_error);
+    // A small callable is invoked from within its op, so an op completing runs an immediate
+    // continuation of itself on the same thread without copying the callable onto the heap
+    {
+      struct padding_t { size_t values[8]; } padding={{0}};
+      atomic<bool> go(false);
+      size_t aend=0, bstart=(size_t) -1;
+      thread::id athread, bthread;
+      auto a=dispatcher->completion(future<>(), [&go, &aend, &athread](size_t, future<> op) -> std::pair<bool, handle_ptr> {
+        while(!go)
+          this_thread::yield();
+        auto ret=std::make_pair(true, op.get_handle(true));
+        athread=this_thread::get_id();
+        // Only count allocations big enough to be the continuation's callable
+        allocation_threshold()=sizeof(padding_t);
+        aend=thread_allocations();
+        return ret;
+      });
+      auto b=dispatcher->completion(a, [&bstart, &bthread, padding](size_t, future<> op) -> std::pair<bool, handle_ptr> {
+        bstart=thread_allocations()+padding.values[0];
+        allocation_threshold()=0;
+        bthread=this_thread::get_id();
+        return std::make_pair(true, op.get_handle(true));
+      }, async_op_flags::immediate);
+      go=true;
+      BOOST_CHECK_NO_THROW(b.get());
+      BOOST_CHECK(athread==bthread);
+      BOOST_CHECK(aend==bstart);
+    }
+    auto deldir(dispatcher->rmdir(path_req("testdir")));
+    BOOST_CHECK_NO_THROW(deldir.wait());  // virus checkers sometimes make this spuriously fail
+}
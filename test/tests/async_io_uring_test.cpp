@@ -0,0 +1,56 @@
+#include "test_functions.hpp"
+
+BOOST_AFIO_AUTO_TEST_CASE(async_io_uring, "Tests that many reads and writes in flight on a small pool complete correctly", 60)
+{
+    using namespace BOOST_AFIO_V2_NAMESPACE;
+    static const size_t blocks=1024, blocksize=4096;
+    std::vector<char> buffer(blocks*blocksize), readback(blocks*blocksize);
+    ranctx ctx; raninit(&ctx, 1);
+    u4 *buf=(u4 *) buffer.data();
+    for(size_t n=0; n<buffer.size()/sizeof(*buf); n++)
+      buf[n]=ranval(&ctx);
+    // With two threads, the compat dispatcher could only have two blocks in flight at once
+    auto pool=std::make_shared<std_thread_pool>(2);
+    // Not file:///, which quietly falls back onto the compat dispatcher where the kernel won't set up a ring
+    auto uring=make_dispatcher("file:///?io_uring", file_flags::none, file_flags::none, pool);
+    if(uring.has_error())
+    {
+      BOOST_TEST_MESSAGE("io_uring is not available here, so not testing it");
+      pool->destroy();
+      return;
+    }
+    auto dispatcher=uring.get();
+    {
+      auto mkdir(dispatcher->dir(path_req("testdir", file_flags::create)));
+      auto mkfile(dispatcher->file(path_req::relative(mkdir, "foo", file_flags::create | file_flags::read_write)));
+      auto resizefile(dispatcher->truncate(mkfile, buffer.size()));
+      std::vector<io_req<const char>> writes;
+      for(size_t n=0; n<blocks; n++)
+        writes.push_back(io_req<const char>(resizefile, buffer.data()+n*blocksize, blocksize, n*blocksize));
+      auto written(dispatcher->write(writes));
+      auto syncfile(dispatcher->sync(dispatcher->barrier(written).front()));
+      std::vector<io_req<char>> reads;
+      for(size_t n=0; n<blocks; n++)
+        reads.push_back(io_req<char>(syncfile, readback.data()+n*blocksize, blocksize, n*blocksize));
+      auto read(dispatcher->read(reads));
+      BOOST_REQUIRE_NO_THROW(when_all_p(read).get());
+      BOOST_CHECK(!memcmp(buffer.data(), readback.data(), buffer.size()));
+      BOOST_CHECK(mkfile->write_count()==buffer.size());
+      BOOST_CHECK(mkfile->read_count()==buffer.size());
+      BOOST_CHECK(mkfile->write_count_since_fsync()==0);
+      // Every write, the sync and every read were completed by the ring rather than by the pool
+      BOOST_CHECK(dispatcher->kernel_queue_ops()==2*blocks+1);
+      auto closefile(dispatcher->close(dispatcher->barrier(read).front()));
+      auto delfile(dispatcher->rmfile(closefile));
+      // Unlinking by path rather than by handle goes through the ring where the kernel can
+      auto mkfile2(dispatcher->file(path_req::relative(mkdir, "bar", file_flags::create | file_flags::write)));
+      BOOST_REQUIRE_NO_THROW(dispatcher->close(mkfile2).get());
+      BOOST_CHECK_NO_THROW(dispatcher->rmfile(path_req::relative(mkdir, "bar")).get());
+      BOOST_CHECK_THROW(dispatcher->rmfile(path_req::relative(mkdir, "bar")).get(), std::exception);
+      auto deldir(dispatcher->rmdir(dispatcher->depends(delfile, mkdir)));
+      BOOST_CHECK_NO_THROW(delfile.get());
+      BOOST_CHECK_NO_THROW(deldir.wait());  // virus checkers sometimes make this spuriously fail
+    }
+    dispatcher.reset();
+    pool->destroy();
+}
@@ -0,0 +1,49 @@
+#include "test_functions.hpp"
+
+BOOST_AFIO_AUTO_TEST_CASE(async_io_when_all_fanout, "Tests that when_all_p() and when_any() over very many ops need no thread to wait", 120)
+{
+    using namespace BOOST_AFIO_V2_NAMESPACE;
+    static const size_t inputs=100000, slices=64;
+    auto pool=std::make_shared<std_thread_pool>(2);
+    auto dispatcher=make_dispatcher("file:///", file_flags::none, file_flags::none, pool).get();
+    // Hold every input until all the waits are set up, so both pool threads would be needed to wait if waits blocked
+    atomic<bool> go(false);
+    auto gate=dispatcher->call(future<>(), [&go]{ while(!go) this_thread::yield(); });
+    atomic<size_t> ran(0);
+    std::vector<future<>> ops;
+    ops.reserve(inputs);
+    for(size_t n=0; n<inputs; n++)
+        ops.push_back(dispatcher->call(gate, [&ran]{ ++ran; }));
+    auto all=when_all_p(ops);
+    auto any=when_any(ops);
+    std::vector<stl_future<std::vector<handle_ptr>>> parts;
+    for(size_t n=0; n<slices; n++)
+        parts.push_back(when_all_p(ops.begin()+n*(inputs/slices), ops.begin()+(n+1)*(inputs/slices)));
+    BOOST_CHECK(future_status::timeout==all.wait_for(chrono::milliseconds(10)));
+    go=true;
+    BOOST_CHECK(all.get().size()==inputs);
+    any.get();
+    for(auto &i: parts)
+        BOOST_CHECK(i.get().size()==inputs/slices);
+    BOOST_CHECK(ran==inputs);
+
+    // Any input failing fails when_all_p(), but not the non propagating form
+    ops.resize(16);
+    ops.push_back(dispatcher->completion(gate, std::make_pair(async_op_flags::none, std::function<dispatcher::completion_t>([](size_t, future<>) -> std::pair<bool, handle_ptr> {
+        throw std::runtime_error("Deliberate");
+    }))));
+    BOOST_CHECK_THROW(when_all_p(ops).get(), std::runtime_error);
+    auto results=when_all_p(std::nothrow, ops).get();
+    BOOST_CHECK(results.size()==17);
+    BOOST_CHECK(!results.back());
+
+    // With no op belonging to a dispatcher and no current dispatcher, the error arrives through the returned future
+    {
+        current_dispatcher_guard g((dispatcher_ptr()));
+        std::vector<future<>> orphans(4);
+        BOOST_CHECK_THROW(when_all_p(std::nothrow, orphans).get(), std::invalid_argument);
+        BOOST_CHECK_THROW(when_any(std::nothrow, orphans).get(), std::invalid_argument);
+    }
+    dispatcher.reset();
+    pool->destroy();
+}
@@ -0,0 +1,71 @@
+#include "test_functions.hpp"
+
+BOOST_AFIO_AUTO_TEST_CASE(async_io_work_stealing_works, "Tests that the work stealing thread pool executes everything enqueued to it", 60)
+{
+    using namespace BOOST_AFIO_V2_NAMESPACE;
+    namespace asio = BOOST_AFIO_V2_NAMESPACE::asio;
+    static const size_t chains=
+#if defined(BOOST_AFIO_RUNNING_IN_CI) || defined(BOOST_AFIO_COMPILING_FOR_GCOV)
+        100
+#else
+        1000
+#endif
+        , chainlength=16;
+    auto pool=std::make_shared<work_stealing_thread_pool>(4);
+    BOOST_CHECK(pool->size()==4);
+
+    // Plain enqueue from outside the pool, with nested enqueues from inside it
+    {
+        atomic<size_t> count(0);
+        std::vector<shared_future<int>> results;
+        results.reserve(1000);
+        for(size_t n=0; n<1000; n++)
+        {
+            results.push_back(pool->enqueue([&count, pool]{
+                ++count;
+                pool->enqueue([&count]{ ++count; return 1; });
+                return 78;
+            }));
+        }
+        for(auto &i: results)
+            BOOST_CHECK(i.get()==78);
+        while(count<2000)
+            this_thread::yield();
+        BOOST_CHECK(count==2000);
+    }
+
+    // Bulk enqueue of a batch of tasks
+    {
+        atomic<size_t> count(0);
+        std::vector<enqueued_task<void()>> tasks;
+        for(size_t n=0; n<1000; n++)
+            tasks.push_back(enqueued_task<void()>([&count]{ ++count; }));
+        pool->enqueue(tasks.begin(), tasks.end());
+        for(auto &i: tasks)
+            i.get_future().get();
+        BOOST_CHECK(count==1000);
+    }
+
+    // Chains of ops scheduled through a dispatcher using the pool
+    auto dispatcher=make_dispatcher("file:///", file_flags::none, file_flags::none, pool).get();
+    BOOST_CHECK(dispatcher->threadsource()==pool);
+    std::vector<atomic<size_t>> hops(chains);
+    std::vector<future<>> lasts;
+    lasts.reserve(chains);
+    for(size_t n=0; n<chains; n++)
+    {
+        hops[n]=0;
+        future<> last;
+        for(size_t i=0; i<chainlength; i++)
+        {
+            atomic<size_t> *h=&hops[n];
+            last=dispatcher->call(last, [h]{ ++*h; });
+        }
+        lasts.push_back(last);
+    }
+    when_all_p(lasts).wait();
+    for(auto &i: hops)
+        BOOST_CHECK(i==chainlength);
+    dispatcher.reset();
+    pool->destroy();
+}